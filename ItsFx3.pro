@@ -28,16 +28,33 @@ SOURCES += main.cpp \
     util/AttMap.cpp \
     rawsignalform.cpp \
     datahandlers/streamdumper.cpp \
+    datahandlers/asyncfilewriter.cpp \
+    datahandlers/uringfilewriter.cpp \
+    datahandlers/streamuringdumper.cpp \
+    datahandlers/streamflightrecorder.cpp \
+    datahandlers/capturecompressor.cpp \
     datastreams/streamrouter.cpp \
+    datastreams/datablock.cpp \
+    datastreams/blockring.cpp \
+    datastreams/streamworker.cpp \
+    datastreams/streamdecoder.cpp \
+    datastreams/capturefile.cpp \
+    datastreams/blockcodec.cpp \
+    datastreams/capturemap.cpp \
     util/Chan2bitParser.cpp \
+    util/IQ16Parser.cpp \
+    util/SamplePack.cpp \
+    util/ThreadConfig.cpp \
     hwfx3/HexParser.cpp \
     hwfx3/fx3deverr.cpp \
     hwfx3/FX3Dev.cpp \
+    hwfx3/fx3usbtuner.cpp \
     hwfx3/fx3fwparser.cpp \
     dialogconfig.cpp \
     hwfx3/fx3devcyapi.cpp \
     gcacorr/dsp_utils.cpp \
     gcacorr/fftwrapper.cpp \
+    gcacorr/fftplans.cpp \
     gcacorr/gpsvis.cpp \
     gcacorr/matrixstatistic.cpp \
     gcacorr/rawsignal.cpp \
@@ -76,9 +93,27 @@ HEADERS  += itsmain.h \
     util/AttMap.h \
     rawsignalform.h \
     datahandlers/streamdumper.h \
+    datahandlers/filewriterifce.h \
+    datahandlers/asyncfilewriter.h \
+    datahandlers/uringfilewriter.h \
+    datahandlers/streamuringdumper.h \
+    datahandlers/streamflightrecorder.h \
+    datahandlers/flighttriggerifce.h \
+    datahandlers/capturecompressor.h \
     datastreams/streamdatahandler.h \
     datastreams/streamrouter.h \
+    datastreams/datablock.h \
+    datastreams/blockring.h \
+    datastreams/streamworker.h \
+    datastreams/adcformat.h \
+    datastreams/streamdecoder.h \
+    datastreams/capturefile.h \
+    datastreams/blockcodec.h \
+    datastreams/capturemap.h \
     util/Chan2bitParser.h \
+    util/IQ16Parser.h \
+    util/SamplePack.h \
+    util/ThreadConfig.h \
     util/convoluter.h \
     util/mathTypes.h \
     util/cas_codes.h \
@@ -87,6 +122,7 @@ HEADERS  += itsmain.h \
     hwfx3/fx3deverr.h \
     hwfx3/fx3devdebuginfo.h \
     hwfx3/fx3fwparser.h \
+    hwfx3/fx3usbtuner.h \
     hwfx3/fx3devdrvtype.h \
     dialogconfig.h \
     hwfx3/fx3config.h \
@@ -103,6 +139,7 @@ HEADERS  += itsmain.h \
     gcacorr/cas_codes.h \
     gcacorr/dsp_utils.h \
     gcacorr/fftwrapper.h \
+    gcacorr/fftplans.h \
     gcacorr/fir_filter.h \
     gcacorr/gpsvis.h \
     gcacorr/mathTypes.h \
@@ -194,4 +231,4 @@ else:win32-g++: PRE_TARGETDEPS += $$PWD/libs/libfftw/liblibfftw3f-3.a
 
 unix:!macx: LIBS += -lusb-1.0
 
-unix:!macx: LIBS += -lfftw3f
+unix:!macx: LIBS += -lfftw3f_threads -lfftw3f
@@ -1,5 +1,7 @@
 #include <QVariant>
+#include <algorithm>
 #include "gcacorr/dsp_utils.h"
+#include "util/ThreadConfig.h"
 #include "SpectrumForm.h"
 #include "ui_SpectrumForm.h"
 
@@ -8,6 +10,7 @@ using namespace std;
 SpectrumForm::SpectrumForm( FX3Config* cfg, QWidget *parent ) :
     QWidget(parent),
     router( NULL ),
+    flight_trigger( NULL ),
     ui(new Ui::SpectrumForm),
     cfg( cfg ),
     fft( NULL ),
@@ -44,13 +47,7 @@ SpectrumForm::SpectrumForm( FX3Config* cfg, QWidget *parent ) :
         fft_out_averaged.at(i).resize(fft_len);
     }
 
-    tbuf_fft.resize(avg_matrix_cnt_max);
-    for ( size_t iter = 0; iter < tbuf_fft.size(); iter++ ) {
-        tbuf_fft[ iter ].resize( 4 );
-        for ( size_t ch = 0; ch < tbuf_fft[ iter ].size(); ch++ ) {
-            tbuf_fft[ iter ][ ch ].resize( fft_len );
-        }
-    }
+    tbuf_fft.resize( avg_matrix_cnt_max * 4 * fft->BatchBins() );
 
     running = true;
     calc_thread = std::thread( &SpectrumForm::calc_loop, this );
@@ -162,17 +159,14 @@ void SpectrumForm::MakeFFTs()
 
     } else {
 
-        for ( int iter = 0; iter < avg_matrix_cnt; iter++ ) {
-            for ( size_t channel = 0; channel < 4; channel++ ) {
-                fft->TransformShort(
-                            all_ch_data[ channel ].data() + fft_len * iter,
-                            tbuf_fft[ iter ][ channel ].data(),
-                            false
-                            );
-            }
-        }
+        // all windows of all channels in one batch, block may be shorter than avg_matrix_cnt windows
+        int windows = std::min( avg_matrix_cnt, ( int ) ( all_ch_data[ 0 ].size() / fft_len ) );
+        const short* src[ 4 ] = { all_ch_data[ 0 ].data(), all_ch_data[ 1 ].data(),
+                                  all_ch_data[ 2 ].data(), all_ch_data[ 3 ].data() };
+        fft->TransformShortBatch( src, 4, windows, tbuf_fft.data() );
+        const int bins = fft->BatchBins();
 
-        float scale = 1.0f / ((float) avg_matrix_cnt * 4.0f);
+        float scale = 1.0f / ((float) windows * 4.0f);
         float_cpx_t corr[4];
         for ( int pt = 0; pt < half_fft_len; pt++ ) {
             corr[0] = float_cpx_t( 0.0f, 0.0f );
@@ -180,14 +174,10 @@ void SpectrumForm::MakeFFTs()
             corr[2] = float_cpx_t( 0.0f, 0.0f );
             corr[3] = float_cpx_t( 0.0f, 0.0f );
 
-            for ( int iter = 0; iter < avg_matrix_cnt; iter++ ) {
+            for ( int iter = 0; iter < windows; iter++ ) {
+                const float_cpx_t* win = tbuf_fft.data() + iter * 4 * bins + pt;
                 for ( int ch = 0; ch < 4; ch++ ) {
-                    corr[ch].add(
-                        calc_correlation(
-                            tbuf_fft[ iter ][ 0  ][ pt ],
-                            tbuf_fft[ iter ][ ch ][ pt ]
-                        )
-                    );
+                    corr[ch].add( calc_correlation( win[ 0 ], win[ ch * bins ] ) );
                 }
             }
 
@@ -217,6 +207,7 @@ void SpectrumForm::MakePowers()
         koef = 5.0;
     }
 
+    float trig_power = -1.0e30f;
     for ( int ch = 0; ch < 4; ch++ ) {
         const float_cpx_t* avg_data = fft_out_averaged[ ch ].data();
         vector<float>& pwr = powers[ch];
@@ -231,17 +222,41 @@ void SpectrumForm::MakePowers()
 
         }
 
+        if ( flight_trigger && cfg->flight_spectrum_trigger > 0.0f && ch < cfg->chan_count ) {
+            int last = std::min( right_point_copy, half_fft_len );
+            for ( int i = left_point_copy; i < last; i++ ) {
+                trig_power = std::max( trig_power, pwr[ i ] );
+            }
+        }
+
         lock_guard<mutex> lock(powers_avg_mtx);
         if ( powers_avg[ ch ] ) {
             powers_avg[ ch ]->PushData( pwr.data() );
         }
     }
+    if ( flight_trigger && cfg->flight_spectrum_trigger > 0.0f ) {
+        CheckFlightTrigger( trig_power );
+    }
     //xavg /= (left_point_copy - right_point_copy) * 4.0f;
     //this->powerAvg = xavg;
     //this->powerMax = xmax;
     //this->powerMin = xmin;
 }
 
+void SpectrumForm::CheckFlightTrigger( float max_power ) {
+    int64_t now_ns = StreamHostTimeNs();
+    if ( max_power < cfg->flight_spectrum_trigger - cfg->flight_trigger_rearm ) {
+        flight_armed = true;
+    } else if ( flight_armed && max_power > cfg->flight_spectrum_trigger &&
+                now_ns - flight_last_ns >= ( int64_t ) ( cfg->flight_trigger_holdoff_s * 1.0e9 ) ) {
+        // busy recorder doesn't take trigger, it is tried again with next spectrum
+        if ( flight_trigger->TriggerFlightDump( "spectrum" ) ) {
+            flight_armed = false;
+            flight_last_ns = now_ns;
+        }
+    }
+}
+
 void SpectrumForm::SetWidgetData()
 {
     scalesShiftsChanged(0);
@@ -315,6 +330,7 @@ void SpectrumForm::CurChangeOutside(int value)
 
 void SpectrumForm::calc_loop()
 {
+    pipe_thread_setup( PipeThread_Spectrum );
     this_thread::sleep_for(chrono::milliseconds(2000));
     while (running) {
         event_data.WaitAndFlush();
@@ -439,6 +455,16 @@ void SpectrumForm::hideEvent(QHideEvent* /*event*/ ) {
     ui->checkRun->setChecked(false);
 }
 
+StreamDelivery_t SpectrumForm::GetDelivery()
+{
+    return StreamDelivery_LatestOnly;
+}
+
+StreamSubscription SpectrumForm::GetSubscription()
+{
+    return StreamSubscription( false, true );
+}
+
 void SpectrumForm::HandleAllChansData(std::vector<short *> &new_all_ch_data, size_t pts_cnt)
 {
     if ( (int)pts_cnt < fft_len ) {
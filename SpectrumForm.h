@@ -10,6 +10,7 @@
 #include "datastreams/streamrouter.h"
 #include "datastreams/singleevent.h"
 #include "hwfx3/fx3config.h"
+#include "datahandlers/flighttriggerifce.h"
 #include "gcacorr/fftwrapper.h"
 #include "gcacorr/averagervector.h"
 
@@ -26,6 +27,7 @@ public:
     ~SpectrumForm();
 
     StreamRouter* router;
+    FlightTriggerIfce* flight_trigger;  // triggered when power is above cfg->flight_spectrum_trigger
 
 private:
     Ui::SpectrumForm *ui;
@@ -54,13 +56,17 @@ private:
     void calc_loop();
 
     std::vector< std::vector<float_cpx_t> > fft_out_averaged;
-    std::vector<std::vector<std::vector<float_cpx_t>>> tbuf_fft;
+    FFTBuffer<float_cpx_t> tbuf_fft;     // spectrum of window iter, channel ch at ( iter * 4 + ch ) * BatchBins()
     std::vector< std::vector<float> > powers;
     std::mutex powers_avg_mtx;
     std::vector<Averager<float>*> powers_avg;
     std::vector< std::vector<float> > powers_avg_safe;
     void MakeFFTs();
     void MakePowers();
+    // Power has to fall below trigger by cfg->flight_trigger_rearm and holdoff has to pass before next trigger
+    void CheckFlightTrigger( float max_power );
+    bool    flight_armed = true;
+    int64_t flight_last_ns = 0;
     void SetWidgetData();
 
     std::mutex pts_param_mtx;
@@ -99,6 +105,8 @@ private slots:
     // StreamDataHandler interface
 public:
     void HandleAllChansData(std::vector<short*>& new_all_ch_data, size_t pts_cnt );
+    StreamSubscription GetSubscription();
+    StreamDelivery_t GetDelivery();
 
     // QWidget interface
 protected:
@@ -0,0 +1,319 @@
+#include "asyncfilewriter.h"
+#include "util/ThreadConfig.h"
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <chrono>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+AsyncFileWriter::AsyncFileWriter() :
+    is_open( false ),
+#ifdef WIN32
+    file( NULL ),
+#else
+    fd( -1 ),
+#endif
+    direct( false ),
+    cur( NULL ),
+    closing( false ),
+    write_ms_sum( 0.0 ),
+    in_overrun( false )
+{
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+    Close();
+}
+
+bool AsyncFileWriter::Open( const std::string& fname, const AsyncWriterOptions& options ) {
+    Close();
+    this->fname = fname;
+    opts = options;
+    if ( opts.buffers_count < 2 ) {
+        opts.buffers_count = 2;
+    }
+    opts.buffer_size8 = ( ( opts.buffer_size8 + IO_ALIGN - 1 ) / IO_ALIGN ) * IO_ALIGN;
+    if ( opts.buffer_size8 == 0 ) {
+        opts.buffer_size8 = IO_ALIGN;
+    }
+
+#ifdef WIN32
+    direct = false;
+    file = fopen( fname.c_str(), "wb" );
+    if ( !file ) {
+        fprintf( stderr, "__error__ AsyncFileWriter::Open() can't open '%s'\n", fname.c_str() );
+        return false;
+    }
+#else
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    direct = false;
+#ifdef O_DIRECT
+    if ( opts.direct_io ) {
+        fd = open( fname.c_str(), flags | O_DIRECT, 0644 );
+        if ( fd >= 0 ) {
+            direct = true;
+        } else {
+            fprintf( stderr, "__warning__ AsyncFileWriter::Open() O_DIRECT is not supported for '%s' (%s), using page cache\n",
+                     fname.c_str(), strerror( errno ) );
+        }
+    }
+#endif
+    if ( fd < 0 ) {
+        fd = open( fname.c_str(), flags, 0644 );
+    }
+    if ( fd < 0 ) {
+        fprintf( stderr, "__error__ AsyncFileWriter::Open() can't open '%s': %s\n", fname.c_str(), strerror( errno ) );
+        return false;
+    }
+#ifdef __linux__
+    if ( opts.prealloc_size8 ) {
+        int res = posix_fallocate( fd, 0, ( off_t ) opts.prealloc_size8 );
+        if ( res != 0 ) {
+            fprintf( stderr, "__warning__ AsyncFileWriter::Open() preallocation of %llu bytes failed: %s\n",
+                     ( unsigned long long ) opts.prealloc_size8, strerror( res ) );
+        }
+    }
+#endif
+#endif
+
+    buffers.resize( opts.buffers_count );
+    for ( size_t i = 0; i < buffers.size(); i++ ) {
+        buffers[ i ].data  = writer_alloc_aligned( opts.buffer_size8 );
+        buffers[ i ].fill8 = 0;
+        if ( !buffers[ i ].data ) {
+            fprintf( stderr, "__error__ AsyncFileWriter::Open() no memory for %u buffers of %llu bytes\n",
+                     opts.buffers_count, ( unsigned long long ) opts.buffer_size8 );
+            freeBuffers();
+            return false;
+        }
+        free_bufs.push_back( &buffers[ i ] );
+    }
+
+    stats = AsyncWriterStats();
+    write_ms_sum = 0.0;
+    in_overrun = false;
+    closing = false;
+    cur = NULL;
+    takeFreeBuffer();
+    is_open = true;
+    writer_thread = std::thread( &AsyncFileWriter::WriteLoop, this );
+    return true;
+}
+
+bool AsyncFileWriter::IsOpen() const {
+    return is_open;
+}
+
+const char* AsyncFileWriter::BackendName() const {
+    return "thread";
+}
+
+bool AsyncFileWriter::Write( const void* data, size_t size8 ) {
+    if ( !is_open ) {
+        return false;
+    }
+    {
+        // Data is written whole or dropped whole, so file never has a part of block and
+        // multi-byte or interleaved points stay aligned. Writer thread only adds free buffers.
+        std::lock_guard< std::mutex > lck( mtx );
+        size_t space8 = ( cur ? opts.buffer_size8 - cur->fill8 : 0 ) + free_bufs.size() * opts.buffer_size8;
+        if ( size8 > space8 ) {
+            stats.dropped8 += size8;
+            if ( !in_overrun ) {
+                stats.overruns++;
+                in_overrun = true;
+            }
+            return false;
+        }
+        in_overrun = false;
+    }
+    const uint8_t* src = ( const uint8_t* ) data;
+    while ( size8 ) {
+        if ( !cur ) {
+            takeFreeBuffer();
+        }
+        size_t chunk8 = opts.buffer_size8 - cur->fill8;
+        if ( chunk8 > size8 ) {
+            chunk8 = size8;
+        }
+        memcpy( cur->data + cur->fill8, src, chunk8 );
+        cur->fill8 += chunk8;
+        src   += chunk8;
+        size8 -= chunk8;
+        if ( cur->fill8 == opts.buffer_size8 ) {
+            queueBuffer( cur );
+            cur = NULL;
+        }
+    }
+    std::lock_guard< std::mutex > lck( mtx );
+    return stats.error == 0;
+}
+
+void AsyncFileWriter::Close() {
+    if ( !is_open ) {
+        return;
+    }
+    if ( cur && cur->fill8 ) {
+        queueBuffer( cur );
+    }
+    cur = NULL;
+    mtx.lock();
+    closing = true;
+    mtx.unlock();
+    cv_full.notify_one();
+    if ( writer_thread.joinable() ) {
+        writer_thread.join();
+    }
+
+    AsyncWriterStats st = GetStats();
+#ifdef WIN32
+    fclose( file );
+    file = NULL;
+#else
+    if ( opts.prealloc_size8 && ftruncate( fd, ( off_t ) st.written8 ) != 0 ) {
+        fprintf( stderr, "__warning__ AsyncFileWriter::Close() ftruncate failed: %s\n", strerror( errno ) );
+    }
+    close( fd );
+    fd = -1;
+#endif
+    is_open = false;
+    freeBuffers();
+
+    fprintf( stderr, "AsyncFileWriter: '%s' %.1f MBytes, %llu writes avg %.2f ms max %.2f ms, %llu overruns %.1f MBytes lost%s\n",
+             fname.c_str(), st.written8 / ( 1024.0 * 1024.0 ), ( unsigned long long ) st.writes,
+             st.write_ms_avg, st.write_ms_max, ( unsigned long long ) st.overruns, st.dropped8 / ( 1024.0 * 1024.0 ),
+             st.error ? ", WRITE ERROR" : "" );
+}
+
+AsyncWriterStats AsyncFileWriter::GetStats() const {
+    std::lock_guard< std::mutex > lck( mtx );
+    return stats;
+}
+
+bool AsyncFileWriter::takeFreeBuffer() {
+    std::lock_guard< std::mutex > lck( mtx );
+    if ( free_bufs.empty() ) {
+        return false;
+    }
+    cur = free_bufs.front();
+    free_bufs.pop_front();
+    cur->fill8 = 0;
+    in_overrun = false;
+    return true;
+}
+
+void AsyncFileWriter::queueBuffer( Buffer* buf ) {
+    mtx.lock();
+    full_bufs.push_back( buf );
+    stats.queued = ( uint32_t ) full_bufs.size();
+    if ( stats.queued > stats.queued_max ) {
+        stats.queued_max = stats.queued;
+    }
+    mtx.unlock();
+    cv_full.notify_one();
+}
+
+void AsyncFileWriter::freeBuffers() {
+    for ( size_t i = 0; i < buffers.size(); i++ ) {
+        writer_free_aligned( buffers[ i ].data );
+    }
+    buffers.clear();
+    free_bufs.clear();
+    full_bufs.clear();
+}
+
+void AsyncFileWriter::WriteLoop() {
+    pipe_thread_setup( PipeThread_Writer );
+    std::unique_lock< std::mutex > lck( mtx );
+    for ( ;; ) {
+        while ( full_bufs.empty() && !closing ) {
+            cv_full.wait( lck );
+        }
+        if ( full_bufs.empty() ) {
+            break;
+        }
+        Buffer* buf = full_bufs.front();
+        full_bufs.pop_front();
+        bool skip = ( stats.error != 0 );
+        lck.unlock();
+
+        bool ok = true;
+        double ms = 0.0;
+        if ( !skip ) {
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            ok = writeBuffer( buf );
+            ms = std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - t0 ).count();
+        }
+        int err = ok ? 0 : errno;
+
+        lck.lock();
+        if ( !skip ) {
+            if ( ok ) {
+                stats.written8 += buf->fill8;
+                stats.writes++;
+                write_ms_sum += ms;
+                stats.write_ms_avg = write_ms_sum / stats.writes;
+                if ( ms > stats.write_ms_max ) {
+                    stats.write_ms_max = ms;
+                }
+            } else {
+                stats.error = err ? err : EIO;
+                fprintf( stderr, "__error__ AsyncFileWriter: write to '%s' failed: %s, rest of data is lost\n",
+                         fname.c_str(), strerror( stats.error ) );
+            }
+        }
+        if ( skip || !ok ) {
+            stats.dropped8 += buf->fill8;
+        }
+        buf->fill8 = 0;
+        free_bufs.push_back( buf );
+        stats.queued = ( uint32_t ) full_bufs.size();
+    }
+}
+
+bool AsyncFileWriter::writeBuffer( Buffer* buf ) {
+#ifdef WIN32
+    return fwrite( buf->data, 1, buf->fill8, file ) == buf->fill8;
+#else
+    const uint8_t* p = buf->data;
+    size_t left8 = buf->fill8;
+    if ( direct && left8 % IO_ALIGN ) {
+        // only last buffer (from Close) is partial: aligned part goes direct, tail through page cache
+        size_t aligned8 = left8 - left8 % IO_ALIGN;
+        while ( aligned8 ) {
+            ssize_t res = write( fd, p, aligned8 );
+            if ( res < 0 ) {
+                if ( errno == EINTR ) {
+                    continue;
+                }
+                return false;
+            }
+            p       += res;
+            aligned8 -= res;
+            left8   -= res;
+        }
+#ifdef O_DIRECT
+        fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) & ~O_DIRECT );
+#endif
+        direct = false;
+    }
+    while ( left8 ) {
+        ssize_t res = write( fd, p, left8 );
+        if ( res < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            return false;
+        }
+        p     += res;
+        left8 -= res;
+    }
+    return true;
+#endif
+}
@@ -0,0 +1,77 @@
+#ifndef ASYNCFILEWRITER_H
+#define ASYNCFILEWRITER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+#include "filewriterifce.h"
+
+/*
+ * File writer with own thread. Write() only copies data into big aligned buffer,
+ * full buffers are written to disk by writer thread, so disk stalls don't stop caller.
+ * Write() which does not fit into free buffers is dropped as a whole.
+ */
+class AsyncFileWriter : public FileWriterIfce {
+public:
+    AsyncFileWriter();
+    ~AsyncFileWriter();
+
+    bool Open( const std::string& fname, const AsyncWriterOptions& opts = AsyncWriterOptions() );
+    bool Write( const void* data, size_t size8 );
+    // Also waits for writer thread
+    void Close();
+
+    bool IsOpen() const;
+    AsyncWriterStats GetStats() const;
+    const char* BackendName() const;
+
+private:
+    AsyncFileWriter( const AsyncFileWriter& );
+    AsyncFileWriter& operator=( const AsyncFileWriter& );
+
+    struct Buffer {
+        uint8_t* data;
+        size_t   fill8;
+    };
+
+    void WriteLoop();
+    bool writeBuffer( Buffer* buf );
+    bool takeFreeBuffer();
+    void queueBuffer( Buffer* buf );
+    void freeBuffers();
+
+    std::string fname;
+    AsyncWriterOptions opts;
+    bool is_open;
+
+#ifdef WIN32
+    FILE* file;
+#else
+    int fd;
+#endif
+    bool direct;
+
+    std::vector< Buffer > buffers;
+    Buffer* cur;                        // filled by Write(), owned by caller thread
+    std::deque< Buffer* > free_bufs;
+    std::deque< Buffer* > full_bufs;
+    bool closing;
+    mutable std::mutex mtx;
+    std::condition_variable cv_full;
+    std::thread writer_thread;
+
+    // under mtx
+    AsyncWriterStats stats;
+    double write_ms_sum;
+    bool   in_overrun;
+};
+
+#endif // ASYNCFILEWRITER_H
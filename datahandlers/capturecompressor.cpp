@@ -0,0 +1,183 @@
+#include "capturecompressor.h"
+#include "datastreams/blockcodec.h"
+#include "util/ThreadConfig.h"
+#include <cstdio>
+#include <cstring>
+
+CaptureCompressor::CaptureCompressor() :
+    writer( NULL ),
+    indexer( NULL ),
+    push_seq( 0 ),
+    write_seq( 0 ),
+    offset8( 0 ),
+    stopping( false ),
+    dropped8( 0 ),
+    raw_total8( 0 ),
+    packed_total8( 0 )
+{
+}
+
+CaptureCompressor::~CaptureCompressor() {
+    Finish();
+}
+
+bool CaptureCompressor::Start( FileWriterIfce* writer, CaptureIndexer* indexer, uint32_t threads, uint32_t slots_count ) {
+    Finish();
+    if ( !writer || !indexer ) {
+        return false;
+    }
+    this->writer  = writer;
+    this->indexer = indexer;
+    slots.resize( slots_count ? slots_count : DEF_SLOTS );
+    for ( size_t i = 0; i < slots.size(); i++ ) {
+        slots[ i ].state = Slot_Free;
+    }
+    queue.clear();
+    push_seq  = 0;
+    write_seq = 0;
+    offset8   = indexer->Header().header_size8;
+    stopping  = false;
+    dropped8      = 0;
+    raw_total8    = 0;
+    packed_total8 = 0;
+
+    for ( uint32_t i = 0; i < ( threads ? threads : 1 ); i++ ) {
+        packers.push_back( std::thread( &CaptureCompressor::PackLoop, this ) );
+    }
+    write_thread = std::thread( &CaptureCompressor::WriteLoop, this );
+    return true;
+}
+
+bool CaptureCompressor::Push( const StreamBlockInfo& info, const void* data, size_t size8 ) {
+    std::unique_lock< std::mutex > lck( mtx );
+    if ( !writer || stopping || slots.empty() ) {
+        return false;
+    }
+    Slot& slot = slots[ push_seq % slots.size() ];
+    if ( slot.state != Slot_Free ) {
+        dropped8 += size8;
+        return false;
+    }
+    lck.unlock();
+    // slot is free, only Push() can take it
+    if ( slot.raw.size() < size8 ) {
+        slot.raw.resize( size8 );
+    }
+    if ( size8 ) {
+        memcpy( &slot.raw[ 0 ], data, size8 );
+    }
+    slot.raw8 = size8;
+    slot.info = info;
+    lck.lock();
+    slot.state = Slot_Queued;
+    queue.push_back( push_seq );
+    push_seq++;
+    cv_pack.notify_one();
+    return true;
+}
+
+void CaptureCompressor::Finish() {
+    mtx.lock();
+    stopping = true;
+    cv_pack.notify_all();
+    cv_write.notify_all();
+    mtx.unlock();
+    for ( size_t i = 0; i < packers.size(); i++ ) {
+        packers[ i ].join();
+    }
+    packers.clear();
+    if ( write_thread.joinable() ) {
+        write_thread.join();
+    }
+    if ( writer && raw_total8 ) {
+        fprintf( stderr, "CaptureCompressor: %.1f MBytes packed to %.1f MBytes (%.2fx), %.1f MBytes dropped\n",
+                 raw_total8 / ( 1024.0 * 1024.0 ), packed_total8 / ( 1024.0 * 1024.0 ),
+                 packed_total8 ? ( double ) raw_total8 / packed_total8 : 0.0, dropped8 / ( 1024.0 * 1024.0 ) );
+    }
+    writer  = NULL;
+    indexer = NULL;
+}
+
+uint64_t CaptureCompressor::DroppedBytes() const {
+    return dropped8;
+}
+
+uint64_t CaptureCompressor::RawBytes() const {
+    return raw_total8;
+}
+
+uint64_t CaptureCompressor::PackedBytes() const {
+    return packed_total8;
+}
+
+void CaptureCompressor::PackLoop() {
+    pipe_thread_setup( PipeThread_Writer );
+    std::unique_lock< std::mutex > lck( mtx );
+    for ( ;; ) {
+        while ( queue.empty() && !stopping ) {
+            cv_pack.wait( lck );
+        }
+        if ( queue.empty() ) {
+            break;
+        }
+        uint64_t seq = queue.front();
+        queue.pop_front();
+        Slot& slot = slots[ seq % slots.size() ];
+        lck.unlock();
+
+        size_t bound8 = sizeof( CaptureBlockHeader ) + block_compress_bound( slot.raw8 );
+        if ( slot.packed.size() < bound8 ) {
+            slot.packed.resize( bound8 );
+        }
+        size_t size8 = block_compress( slot.raw8 ? &slot.raw[ 0 ] : NULL, slot.raw8,
+                                       &slot.packed[ sizeof( CaptureBlockHeader ) ] );
+        CaptureBlockHeader bh;
+        bh.magic        = CAPTURE_BLOCK_MAGIC;
+        bh.packed_size8 = ( uint32_t ) size8;
+        bh.raw_size8    = ( uint32_t ) slot.raw8;
+        bh.reserved     = 0;
+        memcpy( &slot.packed[ 0 ], &bh, sizeof( bh ) );
+        slot.packed8 = sizeof( bh ) + size8;
+
+        lck.lock();
+        slot.state = Slot_Packed;
+        cv_write.notify_one();
+    }
+}
+
+void CaptureCompressor::WriteLoop() {
+    pipe_thread_setup( PipeThread_Writer );
+    std::unique_lock< std::mutex > lck( mtx );
+    for ( ;; ) {
+        Slot& slot = slots[ write_seq % slots.size() ];
+        while ( slot.state != Slot_Packed && !( stopping && write_seq == push_seq ) ) {
+            cv_write.wait( lck );
+        }
+        if ( write_seq == push_seq ) {
+            break;
+        }
+        lck.unlock();
+
+        // writer keeps or drops the block as a whole, so the file has only complete blocks
+        // and scan of blocks goes through; dropped block is a gap
+        uint64_t was_dropped8 = writer->GetStats().dropped8;
+        writer->Write( &slot.packed[ 0 ], slot.packed8 );
+        bool written = writer->GetStats().dropped8 == was_dropped8;
+        if ( written ) {
+            CaptureBlockEntry e;
+            e.file_point   = indexer->Points();
+            e.offset8      = offset8;
+            e.packed_size8 = ( uint32_t ) ( slot.packed8 - sizeof( CaptureBlockHeader ) );
+            e.raw_size8    = ( uint32_t ) slot.raw8;
+            indexer->AddPackedBlock( e );
+            raw_total8    += slot.raw8;
+            packed_total8 += slot.packed8;
+            offset8       += slot.packed8;
+        }
+        indexer->AddBlock( slot.info, written ? slot.raw8 : 0 );
+
+        lck.lock();
+        slot.state = Slot_Free;
+        write_seq++;
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef CAPTURECOMPRESSOR_H
+#define CAPTURECOMPRESSOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "datastreams/capturefile.h"
+#include "datahandlers/filewriterifce.h"
+
+/*
+ * Writer stage of compressed capture. Push() copies block to a free slot, pool of threads
+ * packs slots (blockcodec.h), one thread writes them in order of Push() with
+ * CaptureBlockHeader and fills capture index. If all slots are busy, block is dropped
+ * and becomes a gap of capture, the worker never waits for packing.
+ */
+class CaptureCompressor {
+public:
+    static const uint32_t DEF_THREADS = 2;
+    static const uint32_t DEF_SLOTS   = 8;
+
+    CaptureCompressor();
+    ~CaptureCompressor();
+
+    // writer has capture header already, indexer is started
+    bool Start( FileWriterIfce* writer, CaptureIndexer* indexer,
+                uint32_t threads = DEF_THREADS, uint32_t slots_count = DEF_SLOTS );
+    // Returns false if block was dropped
+    bool Push( const StreamBlockInfo& info, const void* data, size_t size8 );
+    // Writes all pushed blocks and stops threads, then writer can be closed and indexer finished
+    void Finish();
+
+    uint64_t DroppedBytes() const;      // dropped by Push()
+    uint64_t RawBytes() const;          // written blocks before and after packing
+    uint64_t PackedBytes() const;
+
+private:
+    CaptureCompressor( const CaptureCompressor& );
+    CaptureCompressor& operator=( const CaptureCompressor& );
+
+    enum SlotState_t {
+        Slot_Free,
+        Slot_Queued,
+        Slot_Packed
+    };
+    struct Slot {
+        SlotState_t state;
+        StreamBlockInfo info;
+        std::vector< uint8_t > raw;
+        size_t raw8;
+        std::vector< uint8_t > packed;  // CaptureBlockHeader and packed data
+        size_t packed8;
+    };
+
+    void PackLoop();
+    void WriteLoop();
+
+    FileWriterIfce* writer;
+    CaptureIndexer* indexer;
+    std::vector< Slot > slots;
+    std::deque< uint64_t > queue;       // pushed and not packed
+    uint64_t push_seq;
+    uint64_t write_seq;
+    uint64_t offset8;                   // position of next block in file
+
+    std::mutex mtx;
+    std::condition_variable cv_pack;
+    std::condition_variable cv_write;
+    std::vector< std::thread > packers;
+    std::thread write_thread;
+    bool stopping;
+
+    std::atomic< uint64_t > dropped8;
+    std::atomic< uint64_t > raw_total8;
+    std::atomic< uint64_t > packed_total8;
+};
+
+#endif // CAPTURECOMPRESSOR_H
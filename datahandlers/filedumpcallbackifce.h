@@ -2,10 +2,13 @@
 #define FILEDUMPCALLBACKIFCE_H
 
 #include <string>
+#include <cstdint>
 
 class FileDumpCallbackIfce {
 public:
     virtual void onFileDumpComplete() = 0;
+    // Disk can't keep up, lost_bytes were not written (called from handler thread)
+    virtual void onFileDumpOverrun( uint64_t lost_bytes ) {}
 };
 
 #endif // FILEDUMPCALLBACKIFCE_H
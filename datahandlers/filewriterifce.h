@@ -0,0 +1,87 @@
+#ifndef FILEWRITERIFCE_H
+#define FILEWRITERIFCE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <cstdlib>
+#ifdef WIN32
+#include <malloc.h>
+#endif
+
+struct AsyncWriterOptions {
+    size_t   buffer_size8;      // one buffer, multiple of IO_ALIGN
+    uint32_t buffers_count;     // 2 - double buffering, more gives more time to slow disk
+    bool     direct_io;         // O_DIRECT (Linux), page cache is bypassed
+    uint64_t prealloc_size8;    // fallocate this size at open (Linux), 0 - don't preallocate
+
+    AsyncWriterOptions() :
+        buffer_size8( 32 * 1024 * 1024 ),
+        buffers_count( 2 ),
+        direct_io( false ),
+        prealloc_size8( 0 )
+    {}
+};
+
+struct AsyncWriterStats {
+    uint64_t written8;
+    uint64_t dropped8;          // data lost because all buffers were waiting for disk
+    uint64_t overruns;          // number of times it happened
+    uint64_t writes;            // buffers written
+    double   write_ms_avg;      // time of one buffer write
+    double   write_ms_max;
+    uint32_t queued;            // buffers waiting for disk now
+    uint32_t queued_max;
+    int      error;             // errno of failed write, 0 if ok
+
+    AsyncWriterStats() :
+        written8( 0 ), dropped8( 0 ), overruns( 0 ), writes( 0 ),
+        write_ms_avg( 0.0 ), write_ms_max( 0.0 ), queued( 0 ), queued_max( 0 ), error( 0 )
+    {}
+};
+
+/*
+ * Buffered file writer used by recorders. Write() only copies data to writer's buffers,
+ * if disk is too slow and all buffers are busy, new data is dropped and counted (overrun).
+ * Data of one Write() is kept or dropped as a whole.
+ * Write() and Close() must not be called concurrently.
+ */
+class FileWriterIfce {
+public:
+    static const size_t IO_ALIGN = 4096;
+
+    virtual ~FileWriterIfce() {}
+
+    virtual bool Open( const std::string& fname, const AsyncWriterOptions& opts = AsyncWriterOptions() ) = 0;
+    // Returns false if data was dropped or file has write error
+    virtual bool Write( const void* data, size_t size8 ) = 0;
+    // Writes buffered data and closes file
+    virtual void Close() = 0;
+
+    virtual bool IsOpen() const = 0;
+    virtual AsyncWriterStats GetStats() const = 0;
+    virtual const char* BackendName() const = 0;
+};
+
+// Buffers aligned to FileWriterIfce::IO_ALIGN, as O_DIRECT needs
+inline uint8_t* writer_alloc_aligned( size_t size8 ) {
+#ifdef WIN32
+    return ( uint8_t* ) _aligned_malloc( size8, FileWriterIfce::IO_ALIGN );
+#else
+    void* p = NULL;
+    if ( posix_memalign( &p, FileWriterIfce::IO_ALIGN, size8 ) != 0 ) {
+        return NULL;
+    }
+    return ( uint8_t* ) p;
+#endif
+}
+
+inline void writer_free_aligned( uint8_t* p ) {
+#ifdef WIN32
+    _aligned_free( p );
+#else
+    free( p );
+#endif
+}
+
+#endif // FILEWRITERIFCE_H
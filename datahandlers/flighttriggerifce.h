@@ -0,0 +1,12 @@
+#ifndef FLIGHTTRIGGERIFCE_H
+#define FLIGHTTRIGGERIFCE_H
+
+class FlightTriggerIfce {
+public:
+    virtual ~FlightTriggerIfce() {}
+    // May be called from any thread. Returns false if event is ignored
+    // (recorder is not armed yet or previous event is still being saved).
+    virtual bool TriggerFlightDump( const char* reason ) = 0;
+};
+
+#endif // FLIGHTTRIGGERIFCE_H
@@ -1,5 +1,11 @@
 #include "streamdumper.h"
+#include "util/SamplePack.h"
 #include <ctime>
+#include <chrono>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
 
 long long GetUTCTicks() {
     time_t t = time(0);
@@ -12,9 +18,40 @@ long long GetUTCTicks() {
 
 
 StreamDumper::StreamDumper() :
-    dump_file( NULL )
+    files( NULL ),
+    compress_threads( CaptureCompressor::DEF_THREADS ),
+    save_time_stamp( false ),
+    seg_started( false ),
+    rotation_delayed( false ),
+    closer_stop( false ),
+    user_chan_mask( 0x3 ),
+    chan_mask( 0 ),
+    last_chan( 0 ),
+    capture_open( false ),
+    overrun_cback( NULL ),
+    reported_dropped8( 0 ),
+    last_dropped_samples( 0 ),
+    have_block_info( false )
 {
-    
+    for ( int ch = 0; ch < DUMP_MAX_CHANS; ch++ ) {
+        inter_src[ ch ] = NULL;
+    }
+    seg.number = 0;
+    seg.first_sample = 0;
+    seg.start_unix_ns = 0;
+    seg.size8 = 0;
+}
+
+StreamDumper::~StreamDumper() {
+    mtx_seg.lock();
+    closer_stop = true;
+    mtx_seg.unlock();
+    cv_close.notify_all();
+    if ( closer.joinable() ) {
+        closer.join();
+    }
+    // writers are closed by their destructors
+    delete files;
 }
 
 void StreamDumper::SetDumpFileName(const char* fname) {
@@ -23,26 +60,397 @@ void StreamDumper::SetDumpFileName(const char* fname) {
     fmtx.unlock();
 }
 
+void StreamDumper::SetChanMask(uint32_t chan_mask) {
+    fmtx.lock();
+    user_chan_mask = chan_mask & ( ( 1u << DUMP_MAX_CHANS ) - 1 );
+    fmtx.unlock();
+}
+
+void StreamDumper::SetCaptureConfig(const FX3Config& cfg) {
+    fmtx.lock();
+    capture_hdr.SetConfig( cfg );
+    fmtx.unlock();
+}
+
+void StreamDumper::SetWriterOptions(const AsyncWriterOptions& opts) {
+    fmtx.lock();
+    writer_opts = opts;
+    fmtx.unlock();
+}
+
+void StreamDumper::SetCompressThreads(uint32_t threads) {
+    fmtx.lock();
+    compress_threads = threads ? threads : 1;
+    fmtx.unlock();
+}
+
+void StreamDumper::SetSegmentOptions(const DumpSegmentOptions& opts) {
+    fmtx.lock();
+    seg_opts = opts;
+    fmtx.unlock();
+}
+
+void StreamDumper::SetOverrunCallBack(FileDumpCallbackIfce* callback) {
+    fmtx.lock();
+    overrun_cback = callback;
+    fmtx.unlock();
+}
+
+static void add_writer_stats( AsyncWriterStats& sum, const AsyncWriterStats& st ) {
+    sum.written8 += st.written8;
+    sum.dropped8 += st.dropped8;
+    sum.overruns += st.overruns;
+    sum.writes   += st.writes;
+    sum.queued   += st.queued;
+    if ( st.write_ms_max > sum.write_ms_max ) {
+        sum.write_ms_max = st.write_ms_max;
+    }
+    if ( st.write_ms_avg > sum.write_ms_avg ) {
+        sum.write_ms_avg = st.write_ms_avg;
+    }
+    if ( st.queued_max > sum.queued_max ) {
+        sum.queued_max = st.queued_max;
+    }
+    if ( st.error ) {
+        sum.error = st.error;
+    }
+}
+
+void StreamDumper::AddFilesStats(AsyncWriterStats& sum, SegmentFiles* files) {
+    for ( int ch = 0; ch < DUMP_MAX_CHANS; ch++ ) {
+        add_writer_stats( sum, files->writers[ ch ].GetStats() );
+    }
+    sum.dropped8 += files->compressor.DroppedBytes();
+}
+
+// Files which are being closed are counted until they are added to closed_stats
+AsyncWriterStats StreamDumper::GetWriterStats() const {
+    AsyncWriterStats sum;
+    fmtx.lock();
+    if ( files ) {
+        AddFilesStats( sum, files );
+    }
+    mtx_seg.lock();
+    add_writer_stats( sum, closed_stats );
+    for ( size_t i = 0; i < close_jobs.size(); i++ ) {
+        AddFilesStats( sum, close_jobs[ i ].files );
+    }
+    mtx_seg.unlock();
+    fmtx.unlock();
+    return sum;
+}
+
+std::string StreamDumper::ChanFileName(const std::string& fname, int channel) {
+    char suffix[ 16 ];
+    sprintf( suffix, "_ch%d", channel );
+    size_t dot = fname.find_last_of( '.' );
+    size_t sep = fname.find_last_of( "/\\" );
+    if ( dot == std::string::npos || ( sep != std::string::npos && dot < sep ) ) {
+        return fname + suffix;
+    }
+    return fname.substr( 0, dot ) + suffix + fname.substr( dot );
+}
+
+std::string StreamDumper::SegmentFileName(const std::string& fname, uint32_t segment) {
+    char suffix[ 16 ];
+    sprintf( suffix, "_%06u", segment );
+    size_t dot = fname.find_last_of( '.' );
+    size_t sep = fname.find_last_of( "/\\" );
+    if ( dot == std::string::npos || ( sep != std::string::npos && dot < sep ) ) {
+        return fname + suffix;
+    }
+    return fname.substr( 0, dot ) + suffix + fname.substr( dot );
+}
+
+// Under fmtx
+bool StreamDumper::OpenWriters(bool save_time_stamp) {
+    capture_open = false;
+    switch ( type ) {
+        case StreamDump_AllData:
+        case StreamDump_Capture:
+        case StreamDump_CaptureCompressed:
+            chan_mask = 0;
+            break;
+        case StreamDump_ChanMaskFiles:
+        case StreamDump_ChanMaskInterleaved:
+            chan_mask = user_chan_mask;
+            break;
+        default:
+            chan_mask = 1 << ( type - StreamDump_4ch_0ch_Byte );
+            break;
+    }
+    last_chan = 0;
+    for ( int ch = 0; ch < DUMP_MAX_CHANS; ch++ ) {
+        inter_src[ ch ] = NULL;
+        if ( chan_mask & ( 1 << ch ) ) {
+            last_chan = ch;
+        }
+    }
+    if ( !IsRawType() && !chan_mask ) {
+        fprintf( stderr, "__error__ StreamDumper: no channels to dump\n" );
+        return false;
+    }
+
+    // StartDump has waited for closer, files of previous dump are closed
+    this->save_time_stamp = save_time_stamp;
+    mtx_seg.lock();
+    closed_stats = AsyncWriterStats();
+    segments.clear();
+    mtx_seg.unlock();
+    seg_started = false;
+    rotation_delayed = false;
+    seg.number = 1;
+    return OpenSegment();
+}
+
+// Under fmtx, opens files of seg.number in new file set
+bool StreamDumper::OpenSegment() {
+    bool ok = true;
+    bool segmented = seg_opts.Enabled();
+    long long now_ticks = GetUTCTicks();
+    files = new SegmentFiles();
+    AsyncFileWriter* writers = files->writers;
+    CaptureIndexer* indexer = &files->indexer;
+    seg.files.clear();
+    seg.size8 = 0;
+    for ( int ch = 0; ch < DUMP_MAX_CHANS; ch++ ) {
+        bool file_per_chan = ( type == StreamDump_ChanMaskFiles );
+        if ( file_per_chan ? !( chan_mask & ( 1 << ch ) ) : ch != 0 ) {
+            continue;
+        }
+        std::string name = segmented ? SegmentFileName( fname, seg.number ) : fname;
+        if ( file_per_chan ) {
+            name = ChanFileName( name, ch );
+        }
+        if ( writers[ ch ].Open( name, writer_opts ) ) {
+            seg.files.push_back( name );
+            if ( type == StreamDump_Capture || type == StreamDump_CaptureCompressed ) {
+                // header is rewritten with index when segment is finished
+                CaptureHeader hdr = capture_hdr;
+                hdr.compression = ( type == StreamDump_CaptureCompressed ) ? CaptureCompression_Block : CaptureCompression_None;
+                std::vector< uint8_t > hbuf;
+                indexer->Start( hdr );
+                indexer->MakeHeaderBuf( hbuf );
+                Write( ch, &hbuf[ 0 ], hbuf.size() );
+                if ( hdr.compression ) {
+                    files->compressor.Start( &writers[ ch ], indexer, compress_threads );
+                }
+                capture_open = true;
+            } else if ( save_time_stamp ) {
+                Write( ch, &now_ticks, sizeof( long long ) );
+            }
+        } else {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool StreamDumper::IsRawType() const {
+    return type == StreamDump_AllData || type == StreamDump_Capture || type == StreamDump_CaptureCompressed;
+}
+
+bool StreamDumper::IsOpen() const {
+    for ( int ch = 0; ch < DUMP_MAX_CHANS; ch++ ) {
+        if ( IsOpen( ch ) ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool StreamDumper::IsOpen(int ch) const {
+    return files && files->writers[ ch ].IsOpen();
+}
+
+// Under fmtx
+bool StreamDumper::Write(int ch, const void* data, size_t size8) {
+    seg.size8 += size8;
+    return files->writers[ ch ].Write( data, size8 );
+}
+
+// Under fmtx, info is the first block of segment
+void StreamDumper::StartSegment(const StreamBlockInfo& info) {
+    int64_t wall_ns = std::chrono::duration_cast< std::chrono::nanoseconds >(
+                std::chrono::system_clock::now().time_since_epoch() ).count();
+    seg.first_sample  = info.first_sample;
+    seg.start_unix_ns = wall_ns - ( StreamHostTimeNs() - info.host_time_ns );
+    seg_started = true;
+}
+
+// Under fmtx. Next segment is opened in new files, so the worker doesn't wait for
+// flushing and closing of files, closer thread does it.
+void StreamDumper::RotateSegment(const StreamBlockInfo& info) {
+    mtx_seg.lock();
+    size_t backlog = close_jobs.size();
+    mtx_seg.unlock();
+    if ( backlog >= MAX_CLOSE_BACKLOG ) {
+        // segment gets longer, memory of closing writers doesn't grow
+        if ( !rotation_delayed ) {
+            fprintf( stderr, "__warning__ StreamDumper: disk is behind, segment %u of '%s' is longer\n", seg.number, fname.c_str() );
+            rotation_delayed = true;
+        }
+        return;
+    }
+    rotation_delayed = false;
+    CloseJob job = MakeCloseJob();
+    seg.number++;
+    if ( !OpenSegment() ) {
+        fprintf( stderr, "__error__ StreamDumper: segment %u of '%s' is not opened\n", seg.number, fname.c_str() );
+    }
+    StartSegment( info );
+    QueueClose( job );
+}
+
+// Under fmtx, takes current files from the dump
+StreamDumper::CloseJob StreamDumper::MakeCloseJob() {
+    // segment without blocks is still listed, its first sample is unknown
+    if ( !seg_started ) {
+        seg.first_sample  = 0;
+        seg.start_unix_ns = 0;
+    }
+    CloseJob job;
+    job.files         = files;
+    job.seg           = seg;
+    job.capture       = capture_open;
+    job.segmented     = seg_opts.Enabled();
+    job.fname         = fname;
+    job.keep_segments = seg_opts.keep_segments;
+    files = NULL;
+    capture_open = false;
+    seg.files.clear();
+    return job;
+}
+
+void StreamDumper::QueueClose(const CloseJob& job) {
+    std::lock_guard< std::mutex > lck( mtx_seg );
+    if ( !closer.joinable() ) {
+        closer = std::thread( &StreamDumper::CloseLoop, this );
+    }
+    close_jobs.push_back( job );
+    cv_close.notify_all();
+}
+
+// Under mtx_ctrl. Waits without fmtx, so data callbacks and stats don't wait for disk.
+void StreamDumper::CloseFiles() {
+    fmtx.lock();
+    if ( files ) {
+        QueueClose( MakeCloseJob() );
+    }
+    fmtx.unlock();
+    std::unique_lock< std::mutex > lck( mtx_seg );
+    while ( !close_jobs.empty() ) {
+        cv_close.wait( lck );
+    }
+}
+
+void StreamDumper::CloseLoop() {
+    std::unique_lock< std::mutex > lck( mtx_seg );
+    while ( true ) {
+        while ( !closer_stop && close_jobs.empty() ) {
+            cv_close.wait( lck );
+        }
+        if ( close_jobs.empty() ) {
+            break;
+        }
+        // job stays in queue, so its stats are seen while it is closed
+        CloseJob job = close_jobs.front();
+        lck.unlock();
+        CloseSegment( job );
+        lck.lock();
+        AddFilesStats( closed_stats, job.files );
+        close_jobs.pop_front();
+        cv_close.notify_all();
+        lck.unlock();
+        delete job.files;
+        lck.lock();
+    }
+}
+
+// Closer thread
+void StreamDumper::CloseSegment(const CloseJob& job) {
+    // packed blocks are written before file is closed
+    job.files->compressor.Finish();
+    for ( int ch = 0; ch < DUMP_MAX_CHANS; ch++ ) {
+        job.files->writers[ ch ].Close();
+    }
+    if ( job.capture && !job.seg.files.empty() ) {
+        job.files->indexer.Finish( job.seg.files[ 0 ] );
+    }
+    if ( !job.segmented || job.seg.files.empty() ) {
+        return;
+    }
+
+    mtx_seg.lock();
+    segments.push_back( job.seg );
+    while ( job.keep_segments && segments.size() > job.keep_segments ) {
+        const SegmentInfo& oldest = segments.front();
+        for ( size_t i = 0; i < oldest.files.size(); i++ ) {
+            if ( remove( oldest.files[ i ].c_str() ) != 0 ) {
+                fprintf( stderr, "__warning__ StreamDumper: can't delete old segment '%s'\n", oldest.files[ i ].c_str() );
+            }
+        }
+        segments.pop_front();
+    }
+    std::deque< SegmentInfo > list = segments;
+    mtx_seg.unlock();
+    WriteManifest( job.fname, list );
+}
+
+// Closer thread. Manifest is replaced as a whole, so reader never sees a half written or missing one.
+void StreamDumper::WriteManifest(const std::string& fname, const std::deque< SegmentInfo >& segments) {
+    std::string mname = fname + ".manifest";
+    std::string tmp_name = mname + ".tmp";
+    FILE* f = fopen( tmp_name.c_str(), "w" );
+    if ( !f ) {
+        fprintf( stderr, "__error__ StreamDumper: can't write '%s'\n", mname.c_str() );
+        return;
+    }
+    fprintf( f, "# segment first_sample start_unix_ns size8 files\n" );
+    for ( size_t i = 0; i < segments.size(); i++ ) {
+        const SegmentInfo& s = segments[ i ];
+        fprintf( f, "%u %llu %lld %llu", s.number, ( unsigned long long ) s.first_sample,
+                 ( long long ) s.start_unix_ns, ( unsigned long long ) s.size8 );
+        for ( size_t k = 0; k < s.files.size(); k++ ) {
+            fprintf( f, " %s", s.files[ k ].c_str() );
+        }
+        fprintf( f, "\n" );
+    }
+    fclose( f );
+#ifdef WIN32
+    bool renamed = MoveFileExA( tmp_name.c_str(), mname.c_str(), MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+    bool renamed = rename( tmp_name.c_str(), mname.c_str() ) == 0;
+#endif
+    if ( !renamed ) {
+        fprintf( stderr, "__error__ StreamDumper: can't rename '%s'\n", tmp_name.c_str() );
+    }
+}
+
 void StreamDumper::StartDump(StreamDumpType_t dump_type, bool save_time_stamp) {
     fprintf( stderr, "Start dumping %s timestamp to file '%s'\n",
              save_time_stamp ? "with" : "without", fname.c_str() );
 
+    std::lock_guard< std::mutex > ctrl( mtx_ctrl );
+    CloseFiles();
     fmtx.lock();
     type = dump_type;
     oneshot_dumping = false;
-    dump_file = fopen( fname.c_str(), "wb" );
-    if ( save_time_stamp ) {
-        long long now_ticks = GetUTCTicks();
-        fwrite( &now_ticks, sizeof( long long ), 1, dump_file );
-    }
+    have_block_info = false;
+    reported_dropped8 = 0;
+    OpenWriters( save_time_stamp );
     fmtx.unlock();
 }
 
 void StreamDumper::StartDump(StreamDumpType_t dump_type, int64_t samples_count, FileDumpCallbackIfce *callback) {
+    std::lock_guard< std::mutex > ctrl( mtx_ctrl );
+    CloseFiles();
     fmtx.lock();
     type = dump_type;
     oneshot_dumping = true;
-    dump_file = fopen( fname.c_str(), "wb" );
+    have_block_info = false;
+    reported_dropped8 = 0;
+    OpenWriters( false );
     samples_togo = samples_count;
     cback = callback;
     fmtx.unlock();
@@ -50,71 +458,130 @@ void StreamDumper::StartDump(StreamDumpType_t dump_type, int64_t samples_count,
 
 
 void StreamDumper::StopDump() {
+    std::lock_guard< std::mutex > ctrl( mtx_ctrl );
+    CloseFiles();
     fmtx.lock();
-    if ( dump_file ) {
-        fclose( dump_file );
-        dump_file = NULL;
-    }
+    FileDumpCallbackIfce* cb = cback;
+    cback = nullptr;
     fmtx.unlock();
 
-    if ( cback ) {
-        cback->onFileDumpComplete();
-        cback = nullptr;
+    if ( cb ) {
+        cb->onFileDumpComplete();
     }
 }
 
 
+// Dump is not sample accurate if stream had a gap, so tell about it
+void StreamDumper::HandleBlockInfo(const StreamBlockInfo& info) {
+    fmtx.lock();
+    if ( IsOpen() && have_block_info && info.dropped_samples > last_dropped_samples ) {
+        fprintf( stderr, "__warning__ StreamDumper: %llu samples lost before sample %llu, dump '%s' has a gap\n",
+                 ( unsigned long long ) ( info.dropped_samples - last_dropped_samples ),
+                 ( unsigned long long ) info.first_sample, fname.c_str() );
+    }
+    if ( IsOpen() ) {
+        if ( !seg_started ) {
+            StartSegment( info );
+        } else if ( seg_opts.Enabled() ) {
+            double rate = capture_hdr.sample_rate_hz;
+            bool by_size = seg_opts.max_size8 && seg.size8 >= seg_opts.max_size8;
+            bool by_time = seg_opts.max_seconds > 0.0 && rate > 0.0 &&
+                    info.first_sample - seg.first_sample >= ( uint64_t ) ( seg_opts.max_seconds * rate );
+            if ( by_size || by_time ) {
+                RotateSegment( info );
+            }
+        }
+    }
+    last_dropped_samples = info.dropped_samples;
+    last_info = info;
+    have_block_info = true;
+    fmtx.unlock();
+}
+
 void StreamDumper::HandleADCStreamData(void* data, size_t size8) {
     int64_t samples = 0;
+    bool ok = true;
     fmtx.lock();
-    if ( dump_file ) {
-        if ( type == StreamDump_AllData ) {
-            size_t wrote = fwrite( data, 1, size8, dump_file );
-            if ( wrote != size8 ) {
-                fprintf( stderr, "__error__ StreamDumper::HandleStreamData() wrote %u of %u!\n", wrote, size8 );
-            }
+    if ( IsOpen( 0 ) ) {
+        if ( type == StreamDump_CaptureCompressed ) {
+            // compressor writes and indexes the block
+            ok = files->compressor.Push( last_info, data, size8 );
+            seg.size8 += size8;
+            samples = size8 / sizeof(int8_t);
+        } else if ( type == StreamDump_AllData ) {
+            ok = Write( 0, data, size8 );
+            samples = size8 / sizeof(int8_t);
+        } else if ( type == StreamDump_Capture ) {
+            // writer drops a block which does not fit as a whole, index gets an empty block then
+            ok = Write( 0, data, size8 );
+            files->indexer.AddBlock( last_info, ok ? size8 : 0 );
             samples = size8 / sizeof(int8_t);
-
         }
     }
     fmtx.unlock();
+    if ( !ok ) {
+        CheckOverrun();
+    }
     if ( samples ) {
         CheckStop( samples );
     }
 }
 
-void StreamDumper::HandleStreamDataOneChan(short *one_ch_data, size_t pts_cnt, int channel) {
-    int samples = 0;
+void StreamDumper::HandleStreamDataOneChanInt8(int8_t *one_ch_data, size_t pts_cnt, int channel) {
+    int64_t samples = 0;
+    bool ok = true;
     fmtx.lock();
-    if ( dump_file ) {
-        if ( ( type == StreamDump_4ch_0ch_Byte && channel == 0 ) ||
-             ( type == StreamDump_4ch_1ch_Byte && channel == 1 ) ||
-             ( type == StreamDump_4ch_2ch_Byte && channel == 2 ) ||
-             ( type == StreamDump_4ch_3ch_Byte && channel == 3 )
-             )
-        {
-            int8_t* dst = new int8_t[ pts_cnt ];
-
-            for ( uint32_t i = 0; i < pts_cnt; i++ ) {
-                dst[ i ] = ( int8_t ) one_ch_data[ i ];
+    if ( type != StreamDump_AllData && channel < DUMP_MAX_CHANS && ( chan_mask & ( 1 << channel ) ) ) {
+        if ( type == StreamDump_ChanMaskInterleaved ) {
+            // Worker gives all channels of a block one by one, planes are valid until the block is done
+            inter_src[ channel ] = one_ch_data;
+            if ( channel == last_chan && IsOpen( 0 ) ) {
+                const int8_t* src[ DUMP_MAX_CHANS ];
+                uint32_t chans = 0;
+                for ( int ch = 0; ch < DUMP_MAX_CHANS; ch++ ) {
+                    if ( chan_mask & ( 1 << ch ) ) {
+                        src[ chans++ ] = inter_src[ ch ];
+                    }
+                }
+                if ( inter_buf.size() < chans * pts_cnt ) {
+                    inter_buf.resize( chans * pts_cnt );
+                }
+                interleave_int8( src, chans, pts_cnt, &inter_buf[ 0 ] );
+                ok = Write( 0, &inter_buf[ 0 ], chans * pts_cnt * sizeof( int8_t ) );
+                samples = pts_cnt;
             }
-
-            size_t wrote = fwrite( dst, sizeof( int8_t ), pts_cnt, dump_file );
-            if ( wrote != pts_cnt ) {
-                fprintf( stderr, "__error__ StreamDumper::HandleStreamData() wrote %u of %u!\n", wrote, pts_cnt );
+        } else {
+            int ch = ( type == StreamDump_ChanMaskFiles ) ? channel : 0;
+            if ( IsOpen( ch ) ) {
+                ok = Write( ch, one_ch_data, pts_cnt * sizeof( int8_t ) );
+                samples = ( channel == last_chan ) ? pts_cnt : 0;
             }
-
-            delete [] dst;
-
-            samples = pts_cnt;
         }
     }
     fmtx.unlock();
+    if ( !ok ) {
+        CheckOverrun();
+    }
     if ( samples ) {
         CheckStop( samples );
     }
 }
 
+StreamSubscription StreamDumper::GetSubscription() {
+    StreamSubscription sub;
+    fmtx.lock();
+    if ( IsOpen() ) {
+        if ( IsRawType() ) {
+            sub.raw = true;
+        } else {
+            sub.chan_mask = chan_mask;
+            sub.formats   = SDF_Int8;
+        }
+    }
+    fmtx.unlock();
+    return sub;
+}
+
 void StreamDumper::CheckStop( int64_t samples ) {
     if ( oneshot_dumping ) {
         samples_togo -= samples;
@@ -124,3 +591,20 @@ void StreamDumper::CheckStop( int64_t samples ) {
     }
 }
 
+// Disk write failed or writer had no free buffer, data is lost
+void StreamDumper::CheckOverrun() {
+    AsyncWriterStats st = GetWriterStats();
+    fmtx.lock();
+    uint64_t lost8 = st.dropped8 - reported_dropped8;
+    reported_dropped8 = st.dropped8;
+    FileDumpCallbackIfce* cb = overrun_cback ? overrun_cback : cback;
+    fmtx.unlock();
+    if ( !lost8 ) {
+        return;
+    }
+    fprintf( stderr, "__error__ StreamDumper: disk is too slow, %llu bytes of '%s' lost (%llu overruns, %u buffers queued)\n",
+             ( unsigned long long ) lost8, fname.c_str(), ( unsigned long long ) st.overruns, st.queued );
+    if ( cb ) {
+        cb->onFileDumpOverrun( lost8 );
+    }
+}
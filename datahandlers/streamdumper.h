@@ -9,8 +9,15 @@
 
 #include <datastreams/streamdatahandler.h>
 #include <datahandlers/filedumpcallbackifce.h>
+#include <datahandlers/asyncfilewriter.h>
+#include <datastreams/capturefile.h>
+#include <datahandlers/capturecompressor.h>
 #include <string>
 #include <mutex>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <condition_variable>
 #include "stdio.h"
 #include <cstdint>
 
@@ -20,6 +27,10 @@ enum StreamDumpType_t {
     StreamDump_4ch_1ch_Byte,
     StreamDump_4ch_2ch_Byte,
     StreamDump_4ch_3ch_Byte,
+    StreamDump_ChanMaskFiles,       // channels of SetChanMask() as bytes, file per channel
+    StreamDump_ChanMaskInterleaved, // channels of SetChanMask() as bytes, one file ch0, ch1, ..., ch0, ch1, ...
+    StreamDump_Capture,             // all ADC data in capture file with header and index (capturefile.h)
+    StreamDump_CaptureCompressed,   // the same, blocks are packed without loss (CaptureCompressor)
     StreamDump_TypeCount
 };
 static const char* StreamDumpTypeNames[ StreamDump_TypeCount ] = {
@@ -27,33 +38,147 @@ static const char* StreamDumpTypeNames[ StreamDump_TypeCount ] = {
     "0-th chan as byte",
     "1-st chan as byte",
     "2-nd chan as byte",
-    "3-rd chan as byte"
+    "3-rd chan as byte",
+    "Chan mask as bytes, file per chan",
+    "Chan mask as bytes, interleaved",
+    "All ADC data, capture with index",
+    "All ADC data, compressed capture"
 };
 
+// Rotation of dump files, segment N of "rec.bin" is "rec_00000N.bin"
+struct DumpSegmentOptions {
+    uint64_t max_size8;         // new segment when data of segment reaches this size, 0 - no limit
+    double   max_seconds;       // new segment after this time of stream, 0 - no limit
+    uint32_t keep_segments;     // files of older segments are deleted, 0 - keep all
+
+    DumpSegmentOptions() : max_size8( 0 ), max_seconds( 0.0 ), keep_segments( 0 ) {}
+    bool Enabled() const { return max_size8 || max_seconds > 0.0; }
+};
 
 class StreamDumper : public StreamDataHandler
 {
 public:
+    static const int DUMP_MAX_CHANS = 4;
+
     StreamDumper();
+    ~StreamDumper();
     void SetDumpFileName( const char* fname );
+    // Channels of StreamDump_ChanMask* types, used by next StartDump
+    void SetChanMask( uint32_t chan_mask );
+    // Stream parameters for header of StreamDump_Capture
+    void SetCaptureConfig( const FX3Config& cfg );
+    // Used by next StartDump
+    void SetWriterOptions( const AsyncWriterOptions& opts );
+    // Packing threads of StreamDump_CaptureCompressed, used by next StartDump
+    void SetCompressThreads( uint32_t threads );
+    // Used by next StartDump. Segments are switched between blocks, so sample numbers continue
+    // in the next segment, fname.manifest lists segments with their first sample and start time.
+    // Rotation by time uses sample rate of SetCaptureConfig.
+    void SetSegmentOptions( const DumpSegmentOptions& opts );
+    // Receives onFileDumpOverrun in both dump modes
+    void SetOverrunCallBack( FileDumpCallbackIfce* callback );
     void StartDump( StreamDumpType_t dump_type, bool save_time_stamp = false );
     void StartDump( StreamDumpType_t dump_type, int64_t samples_count, FileDumpCallbackIfce* callback );
     void StopDump();
     
     // StreamDataHandler interface
+    virtual void HandleBlockInfo(const StreamBlockInfo& info);
     virtual void HandleADCStreamData(void* data, size_t size8);
-    void HandleStreamDataOneChan(short *one_ch_data, size_t pts_cnt, int channel);
+    void HandleStreamDataOneChanInt8(int8_t *one_ch_data, size_t pts_cnt, int channel);
+    StreamSubscription GetSubscription();
+
+    // Sum of all files of the dump
+    AsyncWriterStats GetWriterStats() const;
+
+    // "rec.bin", 1 -> "rec_ch1.bin"
+    static std::string ChanFileName( const std::string& fname, int channel );
+    // "rec.bin", 12 -> "rec_000012.bin"
+    static std::string SegmentFileName( const std::string& fname, uint32_t segment );
 
 private:
     void CheckStop( int64_t samples );
+    void CheckOverrun();
+    bool OpenWriters( bool save_time_stamp );
+    bool OpenSegment();
+    bool IsOpen() const;
+    bool IsOpen( int ch ) const;
+    bool IsRawType() const;     // dump gets HandleADCStreamData
+    bool Write( int ch, const void* data, size_t size8 );
+
+    struct SegmentInfo {
+        uint32_t number;
+        uint64_t first_sample;
+        int64_t  start_unix_ns;
+        uint64_t size8;
+        std::vector< std::string > files;
+    };
+    // Files of one segment. writers[ 0 ] is the only file except StreamDump_ChanMaskFiles,
+    // there it is file of channel
+    struct SegmentFiles {
+        AsyncFileWriter writers[ DUMP_MAX_CHANS ];
+        CaptureIndexer indexer;
+        CaptureCompressor compressor;
+    };
+    // Closer gets files and copies of everything it needs, so it doesn't touch fmtx data
+    struct CloseJob {
+        SegmentFiles* files;
+        SegmentInfo seg;
+        bool capture;
+        bool segmented;
+        std::string fname;
+        uint32_t keep_segments;
+    };
+    // Segments which are not closed yet, rotation is delayed if closer is this much behind
+    static const size_t MAX_CLOSE_BACKLOG = 2;
+
+    void StartSegment( const StreamBlockInfo& info );
+    void RotateSegment( const StreamBlockInfo& info );
+    CloseJob MakeCloseJob();
+    void QueueClose( const CloseJob& job );
+    // Closes files of the dump and waits until closer has finished all segments
+    void CloseFiles();
+    void CloseLoop();
+    void CloseSegment( const CloseJob& job );
+    static void AddFilesStats( AsyncWriterStats& sum, SegmentFiles* files );
+    static void WriteManifest( const std::string& fname, const std::deque< SegmentInfo >& segments );
 
     std::string fname;
-    FILE* dump_file;
-    std::mutex fmtx;
+    SegmentFiles* files;        // current segment, NULL if dump is stopped
+    uint32_t compress_threads;
+    bool save_time_stamp;
+
+    DumpSegmentOptions seg_opts;
+    SegmentInfo seg;            // current segment
+    bool seg_started;           // seg has first block info
+    bool rotation_delayed;      // closer has MAX_CLOSE_BACKLOG segments, current one is not switched
+
+    // Closer thread closes files of finished segments one by one, in their order
+    std::thread closer;
+    mutable std::mutex mtx_seg;
+    std::condition_variable cv_close;
+    std::deque< CloseJob > close_jobs;      // front one is being closed, under mtx_seg
+    bool closer_stop;
+    AsyncWriterStats closed_stats;          // files closed since StartDump, under mtx_seg
+    std::deque< SegmentInfo > segments;     // closed segments, under mtx_seg
+    uint32_t user_chan_mask;
+    uint32_t chan_mask;     // channels of current dump
+    int last_chan;          // its last channel, block is complete after it
+    const int8_t* inter_src[ DUMP_MAX_CHANS ];
+    std::vector< int8_t > inter_buf;
+    CaptureHeader capture_hdr;
+    StreamBlockInfo last_info;
+    bool capture_open;
+    AsyncWriterOptions writer_opts;
+    FileDumpCallbackIfce* overrun_cback;
+    uint64_t reported_dropped8;
+    mutable std::mutex fmtx;
+    std::mutex mtx_ctrl;        // StartDump and StopDump, they wait for closer without fmtx
     StreamDumpType_t type;
     FileDumpCallbackIfce* cback = nullptr;
     int64_t samples_togo;
     bool oneshot_dumping;
+    uint64_t last_dropped_samples;
+    bool have_block_info;
 };
 
 #endif // STREAMERDUMPER_H
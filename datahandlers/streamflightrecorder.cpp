@@ -0,0 +1,301 @@
+#include "streamflightrecorder.h"
+#include "util/ThreadConfig.h"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <algorithm>
+#include <chrono>
+
+StreamFlightRecorder::StreamFlightRecorder() :
+    ring( NULL ),
+    ring_size8( 0 ),
+    pre_size8( 0 ),
+    post_size8( 0 ),
+    prefix( "flight" ),
+    cback( NULL ),
+    state( FlightRec_Off ),
+    head8( 0 ),
+    rd8( 0 ),
+    dump_end8( 0 ),
+    skipped8( 0 ),
+    writing8( 0 ),
+    stopping( false )
+{
+}
+
+StreamFlightRecorder::~StreamFlightRecorder() {
+    mtx.lock();
+    stopping = true;
+    mtx.unlock();
+    cv.notify_all();
+    if ( dump_thread.joinable() ) {
+        dump_thread.join();
+    }
+    delete [] ring;
+}
+
+bool StreamFlightRecorder::Configure( const FX3Config& cfg, double pre_seconds, double post_seconds, uint64_t max_ram8 ) {
+    std::lock_guard< std::mutex > lck( mtx );
+    if ( state != FlightRec_Off && state != FlightRec_Armed ) {
+        fprintf( stderr, "__warning__ StreamFlightRecorder::Configure() event is being saved, not changed\n" );
+        return false;
+    }
+    capture_hdr.SetConfig( cfg );
+    double bytes_per_sec = cfg.adc_sample_rate_hz * capture_hdr.bytes_per_point;
+    uint64_t slack8 = 2 * ( uint64_t ) cfg.router_block_size8;   // block being copied while trigger comes
+    pre_size8  = ( uint64_t ) ( pre_seconds * bytes_per_sec );
+    post_size8 = ( uint64_t ) ( post_seconds * bytes_per_sec );
+    if ( pre_size8 + post_size8 + slack8 > max_ram8 ) {
+        if ( post_size8 + slack8 >= max_ram8 ) {
+            fprintf( stderr, "__error__ StreamFlightRecorder::Configure() %.1f MBytes is not enough for %.1f s after trigger\n",
+                     max_ram8 / ( 1024.0 * 1024.0 ), post_seconds );
+            return false;
+        }
+        pre_size8 = max_ram8 - post_size8 - slack8;
+        fprintf( stderr, "__warning__ StreamFlightRecorder::Configure() RAM limit, only %.1f s before trigger are kept\n",
+                 pre_size8 / bytes_per_sec );
+    }
+    delete [] ring;
+    ring_size8 = pre_size8 + post_size8 + slack8;
+    ring = new ( std::nothrow ) uint8_t[ ring_size8 ];
+    if ( !ring ) {
+        fprintf( stderr, "__error__ StreamFlightRecorder::Configure() no memory for %.1f MBytes\n", ring_size8 / ( 1024.0 * 1024.0 ) );
+        ring_size8 = 0;
+        state = FlightRec_Off;
+        return false;
+    }
+    // pages are touched now, not in the stream
+    memset( ring, 0, ring_size8 );
+    metas.clear();
+    head8 = 0;
+    skipped8 = 0;
+    state = FlightRec_Armed;
+    fprintf( stderr, "StreamFlightRecorder: %.1f MBytes ring, %.1f s before and %.1f s after trigger\n",
+             ring_size8 / ( 1024.0 * 1024.0 ), pre_size8 / bytes_per_sec, post_size8 / bytes_per_sec );
+    return true;
+}
+
+void StreamFlightRecorder::SetFilePrefix( const char* prefix ) {
+    std::lock_guard< std::mutex > lck( mtx );
+    this->prefix = prefix;
+}
+
+void StreamFlightRecorder::SetCallBack( FileDumpCallbackIfce* callback ) {
+    std::lock_guard< std::mutex > lck( mtx );
+    cback = callback;
+}
+
+FlightRecorderState_t StreamFlightRecorder::GetState() const {
+    std::lock_guard< std::mutex > lck( mtx );
+    return state;
+}
+
+std::string StreamFlightRecorder::LastFileName() const {
+    std::lock_guard< std::mutex > lck( mtx );
+    return last_fname;
+}
+
+double StreamFlightRecorder::PreSeconds() const {
+    std::lock_guard< std::mutex > lck( mtx );
+    double bytes_per_sec = capture_hdr.sample_rate_hz * capture_hdr.bytes_per_point;
+    return bytes_per_sec > 0.0 ? pre_size8 / bytes_per_sec : 0.0;
+}
+
+
+bool StreamFlightRecorder::TriggerFlightDump( const char* reason ) {
+    std::unique_lock< std::mutex > lck( mtx );
+    if ( state != FlightRec_Armed || metas.empty() ) {
+        return false;
+    }
+
+    // Oldest data which is not being overwritten, and start of pre-trigger window
+    uint64_t limit8 = head8 + writing8 > ring_size8 ? head8 + writing8 - ring_size8 : 0;
+    uint64_t want8  = head8 > pre_size8 ? head8 - pre_size8 : 0;
+    size_t first = metas.size();
+    for ( size_t i = 0; i < metas.size(); i++ ) {
+        if ( metas[ i ].pos8 >= limit8 && metas[ i ].pos8 + metas[ i ].size8 > want8 ) {
+            first = i;
+            break;
+        }
+    }
+    if ( first == metas.size() ) {
+        return false;
+    }
+    rd8       = metas[ first ].pos8;
+    dump_end8 = head8 + post_size8;
+    state     = FlightRec_Triggered;
+
+    char tbuf[ 32 ];
+    char mbuf[ 8 ];
+    int64_t now_ms = std::chrono::duration_cast< std::chrono::milliseconds >(
+                std::chrono::system_clock::now().time_since_epoch() ).count();
+    time_t now = ( time_t ) ( now_ms / 1000 );
+    strftime( tbuf, sizeof( tbuf ), "_%Y%m%d_%H%M%S", localtime( &now ) );
+    sprintf( mbuf, "_%03d", ( int ) ( now_ms % 1000 ) );
+    last_fname = prefix + tbuf + mbuf + CAPTURE_FILE_EXT;
+    pending_fname = last_fname;
+    double bytes_per_sec = capture_hdr.sample_rate_hz * capture_hdr.bytes_per_point;
+    fprintf( stderr, "StreamFlightRecorder: %s trigger, saving %.1f s before and %.1f s after it to '%s'\n",
+             reason ? reason : "", ( head8 - rd8 ) / bytes_per_sec, post_size8 / bytes_per_sec, last_fname.c_str() );
+    if ( !dump_thread.joinable() ) {
+        dump_thread = std::thread( &StreamFlightRecorder::DumpLoop, this );
+    }
+    lck.unlock();
+    cv.notify_all();
+    return true;
+}
+
+void StreamFlightRecorder::HandleBlockInfo( const StreamBlockInfo& info ) {
+    last_info = info;
+}
+
+void StreamFlightRecorder::HandleADCStreamData( void* data, size_t size8 ) {
+    std::unique_lock< std::mutex > lck( mtx );
+    if ( state == FlightRec_Off ) {
+        return;
+    }
+    if ( state == FlightRec_Flushing || size8 > ring_size8 ||
+         ( state == FlightRec_Triggered && head8 + size8 > rd8 + ring_size8 ) ) {
+        // gap is seen in capture by sample numbers
+        skipped8 += size8;
+        return;
+    }
+    uint64_t pos8 = head8;
+    writing8 = size8;
+    lck.unlock();
+
+    // Writer reads only data before head8, this part of ring is not read now
+    size_t off8   = ( size_t ) ( pos8 % ring_size8 );
+    size_t first8 = std::min( size8, ( size_t ) ( ring_size8 - off8 ) );
+    memcpy( ring + off8, data, first8 );
+    if ( first8 < size8 ) {
+        memcpy( ring, ( uint8_t* ) data + first8, size8 - first8 );
+    }
+
+    lck.lock();
+    BlockMeta m;
+    m.pos8  = pos8;
+    m.size8 = size8;
+    m.info  = last_info;
+    metas.push_back( m );
+    head8 = pos8 + size8;
+    writing8 = 0;
+    while ( !metas.empty() && head8 > ring_size8 && metas.front().pos8 < head8 - ring_size8 ) {
+        metas.pop_front();
+    }
+    if ( state == FlightRec_Triggered && head8 >= dump_end8 ) {
+        state = FlightRec_Flushing;
+    }
+    lck.unlock();
+    cv.notify_all();
+}
+
+StreamSubscription StreamFlightRecorder::GetSubscription() {
+    StreamSubscription sub;
+    std::lock_guard< std::mutex > lck( mtx );
+    sub.raw = ( state != FlightRec_Off );
+    return sub;
+}
+
+void StreamFlightRecorder::copyFromRing( uint64_t pos8, size_t size8, FILE* f ) {
+    size_t off8   = ( size_t ) ( pos8 % ring_size8 );
+    size_t first8 = std::min( size8, ( size_t ) ( ring_size8 - off8 ) );
+    fwrite( ring + off8, 1, first8, f );
+    if ( first8 < size8 ) {
+        fwrite( ring, 1, size8 - first8, f );
+    }
+}
+
+void StreamFlightRecorder::DumpLoop() {
+    pipe_thread_setup( PipeThread_Writer );
+    std::unique_lock< std::mutex > lck( mtx );
+    while ( true ) {
+        while ( !stopping && pending_fname.empty() ) {
+            cv.wait( lck );
+        }
+        // event triggered before stop is still saved
+        if ( pending_fname.empty() ) {
+            break;
+        }
+        std::string fname = pending_fname;
+        pending_fname.clear();
+        lck.unlock();
+        SaveEvent( fname );
+        lck.lock();
+    }
+}
+
+void StreamFlightRecorder::SaveEvent( const std::string& fname ) {
+    int64_t start_ns = StreamHostTimeNs();
+    uint64_t written8 = 0;
+    FILE* f = fopen( fname.c_str(), "wb" );
+    if ( !f ) {
+        fprintf( stderr, "__error__ StreamFlightRecorder: can't open '%s'\n", fname.c_str() );
+    }
+    CaptureIndexer indexer;
+    std::vector< uint8_t > hbuf;
+    mtx.lock();
+    indexer.Start( capture_hdr );
+    mtx.unlock();
+    indexer.MakeHeaderBuf( hbuf );
+    if ( f ) {
+        fwrite( &hbuf[ 0 ], 1, hbuf.size(), f );
+    }
+
+    // stream may stop before post-trigger window is complete
+    double bytes_per_sec = capture_hdr.sample_rate_hz * capture_hdr.bytes_per_point;
+    int64_t max_idle_ns = ( int64_t ) ( ( post_size8 / bytes_per_sec + MAX_IDLE_SECONDS ) * 1.0e9 );
+    while ( f ) {
+        BlockMeta m;
+        {
+            std::unique_lock< std::mutex > lck( mtx );
+            bool have_block = false;
+            int64_t idle_from_ns = StreamHostTimeNs();
+            while ( true ) {
+                std::deque< BlockMeta >::iterator it = metas.begin();
+                while ( it != metas.end() && it->pos8 < rd8 ) {
+                    it++;
+                }
+                if ( it != metas.end() && it->pos8 < dump_end8 ) {
+                    m = *it;
+                    have_block = true;
+                    break;
+                }
+                if ( state == FlightRec_Flushing || stopping ) {
+                    break;
+                }
+                if ( StreamHostTimeNs() - idle_from_ns > max_idle_ns ) {
+                    fprintf( stderr, "__warning__ StreamFlightRecorder: stream stopped, '%s' has less data after trigger\n", fname.c_str() );
+                    break;
+                }
+                cv.wait_for( lck, std::chrono::milliseconds( 100 ) );
+            }
+            // on stop data which is already kept is still written
+            if ( !have_block ) {
+                break;
+            }
+        }
+        copyFromRing( m.pos8, m.size8, f );
+        indexer.AddBlock( m.info, m.size8 );
+        written8 += m.size8;
+        mtx.lock();
+        rd8 = m.pos8 + m.size8;
+        mtx.unlock();
+    }
+
+    if ( f ) {
+        fclose( f );
+        indexer.Finish( fname );
+        fprintf( stderr, "StreamFlightRecorder: '%s' %.1f MBytes saved in %.1f s\n", fname.c_str(),
+                 written8 / ( 1024.0 * 1024.0 ), ( StreamHostTimeNs() - start_ns ) / 1.0e9 );
+    }
+
+    mtx.lock();
+    state = FlightRec_Armed;
+    FileDumpCallbackIfce* cb = cback;
+    mtx.unlock();
+    if ( cb && f ) {
+        cb->onFileDumpComplete();
+    }
+}
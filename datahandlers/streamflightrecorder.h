@@ -0,0 +1,95 @@
+#ifndef STREAMFLIGHTRECORDER_H
+#define STREAMFLIGHTRECORDER_H
+
+#include <cstdint>
+#include <string>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "datastreams/streamdatahandler.h"
+#include "datastreams/capturefile.h"
+#include "datahandlers/filedumpcallbackifce.h"
+#include "datahandlers/flighttriggerifce.h"
+#include "hwfx3/fx3config.h"
+
+enum FlightRecorderState_t {
+    FlightRec_Off,          // not configured
+    FlightRec_Armed,        // keeps last pre-trigger seconds
+    FlightRec_Triggered,    // saving pre-trigger data and waiting for post-trigger data
+    FlightRec_Flushing      // post-trigger window is complete, new data is not kept until file is written
+};
+
+/*
+ * Flight recorder: keeps the last seconds of raw ADC data in a preallocated ring.
+ * On trigger its own thread (started once, gets events under mtx) writes pre-trigger window and post-trigger window to a capture file
+ * (capturefile.h), prefix_YYYYMMDD_HHMMSS_mmm.itscap. Ring holds both windows, so post-trigger data
+ * never overwrites pre-trigger data which is not written yet.
+ */
+class StreamFlightRecorder : public StreamDataHandler, public FlightTriggerIfce
+{
+public:
+    static const int MAX_IDLE_SECONDS = 2;   // event is saved as is if stream stops
+
+    StreamFlightRecorder();
+    ~StreamFlightRecorder();
+
+    // Allocates the ring, pre window is shortened if both windows don't fit in max_ram8
+    bool Configure( const FX3Config& cfg, double pre_seconds, double post_seconds, uint64_t max_ram8 );
+    void SetFilePrefix( const char* prefix );
+    // onFileDumpComplete is called after every saved event (from recorder thread)
+    void SetCallBack( FileDumpCallbackIfce* callback );
+
+    // FlightTriggerIfce interface
+    bool TriggerFlightDump( const char* reason );
+
+    FlightRecorderState_t GetState() const;
+    std::string LastFileName() const;
+    double PreSeconds() const;
+
+    // StreamDataHandler interface
+    virtual void HandleBlockInfo( const StreamBlockInfo& info );
+    virtual void HandleADCStreamData( void* data, size_t size8 );
+    StreamSubscription GetSubscription();
+
+private:
+    StreamFlightRecorder( const StreamFlightRecorder& );
+    StreamFlightRecorder& operator=( const StreamFlightRecorder& );
+
+    struct BlockMeta {
+        uint64_t pos8;      // position in stream of kept data (ring offset is pos8 % ring_size8)
+        size_t   size8;
+        StreamBlockInfo info;
+    };
+
+    void DumpLoop();
+    void SaveEvent( const std::string& fname );
+    void copyFromRing( uint64_t pos8, size_t size8, FILE* f );
+
+    uint8_t* ring;
+    uint64_t ring_size8;
+    uint64_t pre_size8;
+    uint64_t post_size8;
+    CaptureHeader capture_hdr;
+    std::string prefix;
+    FileDumpCallbackIfce* cback;
+
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+    FlightRecorderState_t state;
+    std::deque< BlockMeta > metas;
+    uint64_t head8;         // end of kept data
+    uint64_t rd8;           // writer position while event is saved
+    uint64_t dump_end8;
+    uint64_t skipped8;      // data not kept while Flushing or because writer was too slow
+    size_t   writing8;      // block being copied to ring at head8
+    StreamBlockInfo last_info;
+    std::string last_fname;
+    bool stopping;
+    std::string pending_fname;  // event given by trigger to dump thread
+    std::thread dump_thread;    // started by first trigger, under mtx
+};
+
+#endif // STREAMFLIGHTRECORDER_H
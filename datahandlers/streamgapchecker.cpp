@@ -53,6 +53,10 @@ void StreamGapChecker::HandleStreamDataOneChan(short *one_ch_data, size_t pts_cn
     first_run = false;
 }
 
+StreamSubscription StreamGapChecker::GetSubscription() {
+    return StreamSubscription( false, false, SDF_ALL_CHANS, SDF_Int16 );
+}
+
 void StreamGapChecker::FlushStatistic() {
     gapval = 0.0;
     maxgap = 0.0001;
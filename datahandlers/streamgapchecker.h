@@ -19,6 +19,7 @@ public:
 public:
     void HandleADCStreamData(void *data, size_t size8);
     void HandleStreamDataOneChan(short *one_ch_data, size_t pts_cnt, int channel);
+    StreamSubscription GetSubscription();
 
     void FlushStatistic();
 
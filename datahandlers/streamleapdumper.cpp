@@ -1,18 +1,38 @@
 #include "streamleapdumper.h"
+#include "datastreams/adcformat.h"
+#include "leap/leapconverter.h"
+#include "util/SamplePack.h"
 #include <cstdio>
+#include <cstring>
+#include <ctime>
 
 StreamLEAPDumper::StreamLEAPDumper() :
+    file( NULL ),
+    cback( NULL ),
+    adc_type( ADC_1ch_16bit ),
+    sample_rate_hz( 0.0 ),
+    inter_freq_hz( 0.0 ),
+    from_raw_2bit( false ),
+    bytes_per_point( sizeof( short ) ),
     state( DS_NoDumping ),
-    file( NULL )
+    carry_pts( 0 )
 {
-    
+
+}
+
+void StreamLEAPDumper::SetConfig(const FX3Config& cfg) {
+    mtx.lock();
+    adc_type       = cfg.adc_type;
+    sample_rate_hz = cfg.adc_sample_rate_hz;
+    inter_freq_hz  = cfg.inter_freq_hz;
+    mtx.unlock();
 }
 
 void StreamLEAPDumper::HandleADCStreamData(void* data, size_t size8) {
     mtx.lock();
     if ( state != DS_NoDumping ) {
-        if ( pars.all_chans_raw_sig ) {
-            processData( ( uint8_t* ) data, size8 );
+        if ( pars.all_chans_raw_sig || from_raw_2bit ) {
+            processData( ( const uint8_t* ) data, size8 / bytes_per_point );
         }
     }
     mtx.unlock();
@@ -21,11 +41,25 @@ void StreamLEAPDumper::HandleADCStreamData(void* data, size_t size8) {
 void StreamLEAPDumper::HandleStreamDataOneChan(short* one_ch_data, size_t pts_cnt, int channel) {
     mtx.lock();
     if ( state != DS_NoDumping ) {
-        if ( !pars.all_chans_raw_sig && pars.chan_num == channel ) {
-            processData( ( uint8_t* ) one_ch_data, pts_cnt * sizeof( short ) );
+        if ( !pars.all_chans_raw_sig && !from_raw_2bit && pars.chan_num == channel ) {
+            processData( ( const uint8_t* ) one_ch_data, pts_cnt );
+        }
+    }
+    mtx.unlock();
+}
+
+StreamSubscription StreamLEAPDumper::GetSubscription() {
+    StreamSubscription sub;
+    mtx.lock();
+    if ( state != DS_NoDumping ) {
+        if ( pars.all_chans_raw_sig || from_raw_2bit ) {
+            sub.raw = true;
+        } else {
+            sub.chan_mask = 1 << pars.chan_num;
         }
     }
     mtx.unlock();
+    return sub;
 }
 
 
@@ -36,12 +70,20 @@ int StreamLEAPDumper::DumpAsync(const char* file_name, ChunkDumpParams params, C
     }
 
     mtx.lock();
+    AdcFormatInfo fmt = adc_format_info( adc_type );
     fname         = file_name;
     cback         = callback;
     pars          = params;
     have_count    = 0;
     cur_chunk_len = 0;
     cur_gap       = 0;
+    carry_pts     = 0;
+    from_raw_2bit = !pars.all_chans_raw_sig && fmt.packed_2bit && pars.chan_num < ( int ) fmt.chans;
+    if ( pars.all_chans_raw_sig ) {
+        bytes_per_point = fmt.bytes_per_point;
+    } else {
+        bytes_per_point = from_raw_2bit ? fmt.bytes_per_point : sizeof( short );
+    }
     state         = DS_Start;
 
     writeDateTime();
@@ -50,47 +92,46 @@ int StreamLEAPDumper::DumpAsync(const char* file_name, ChunkDumpParams params, C
     return 0;
 }
 
-void StreamLEAPDumper::processData(uint8_t *p, int size) {
+void StreamLEAPDumper::processData(const uint8_t* p, size_t pts) {
 
-    while ( size > 0 && have_count < pars.count ) {
-        //fprintf( stderr, "[%d] %d\n", state, size );
+    while ( pts > 0 && have_count < pars.count ) {
         if ( state == DS_ChunkProcess ) {
             // "FILLING CHUNK"
-            int to_end = pars.len - cur_chunk_len;
+            int64_t to_end = pars.len - cur_chunk_len;
 
-            if ( size >= to_end ) {
-                fwrite( p, 1, to_end, file );
-                p    += to_end;
-                size -= to_end;
+            if ( ( int64_t ) pts >= to_end ) {
+                writeChunk( p, to_end );
+                p   += to_end * bytes_per_point;
+                pts -= to_end;
 
                 cur_chunk_len = 0;
                 have_count++;
 
                 state = DS_GapProcess;
                 cur_gap = 0;
-            } else {  // if ( size < pars.len - cur_chunk_len)
-                fwrite( p, 1, size, file );
-                p += size;
+            } else {  // if ( pts < pars.len - cur_chunk_len)
+                writeChunk( p, pts );
+                p += pts * bytes_per_point;
 
-                cur_chunk_len += size;
-                size = 0;
+                cur_chunk_len += pts;
+                pts = 0;
             }
 
         } else if ( state == DS_GapProcess ) {
             // "SKIPPING GAP"
-            int to_end = pars.gap - cur_gap;
+            int64_t to_end = pars.gap - cur_gap;
 
-            if ( size >= to_end ) {
-                p    += to_end;
-                size -= to_end;
+            if ( ( int64_t ) pts >= to_end ) {
+                p   += to_end * bytes_per_point;
+                pts -= to_end;
                 cur_gap = 0;
 
                 state = DS_ChunkProcess;
                 cur_chunk_len = 0;
-            } else {  // if ( size < pars.gap - cur_gap)
-                p += size;
-                cur_gap += size;
-                size = 0;
+            } else {  // if ( pts < pars.gap - cur_gap)
+                p += pts * bytes_per_point;
+                cur_gap += pts;
+                pts = 0;
             }
 
         } else {
@@ -100,7 +141,7 @@ void StreamLEAPDumper::processData(uint8_t *p, int size) {
     }
 
     if ( have_count >= pars.count ) {
-        fclose( file );
+        finishFile();
         state = DS_NoDumping;
         if ( cback ) {
             cback->onFileDumpComplete( fname, pars );
@@ -109,6 +150,58 @@ void StreamLEAPDumper::processData(uint8_t *p, int size) {
 
 }
 
+void StreamLEAPDumper::writeChunk(const uint8_t* p, size_t pts) {
+    if ( pars.all_chans_raw_sig ) {
+        fwrite( p, bytes_per_point, pts, file );
+        return;
+    }
+
+    // complete group of previous call first
+    if ( carry_pts ) {
+        size_t n = 8 - carry_pts < pts ? 8 - carry_pts : pts;
+        memcpy( carry + carry_pts * bytes_per_point, p, n * bytes_per_point );
+        carry_pts += n;
+        p   += n * bytes_per_point;
+        pts -= n;
+        if ( carry_pts < 8 ) {
+            return;
+        }
+        packPoints( carry, 8 );
+        carry_pts = 0;
+    }
+
+    size_t whole = pts & ~( size_t ) 7;
+    if ( whole ) {
+        packPoints( p, whole );
+    }
+    carry_pts = pts - whole;
+    memcpy( carry, p + whole * bytes_per_point, carry_pts * bytes_per_point );
+}
+
+// pts is a multiple of 8
+void StreamLEAPDumper::packPoints(const uint8_t* p, size_t pts) {
+    if ( packed.size() < pts / 4 ) {
+        packed.resize( pts / 4 );
+    }
+    if ( from_raw_2bit ) {
+        pack_leap_2bit( p, pts, pars.chan_num, &packed[ 0 ] );
+    } else {
+        pack_leap_int16( ( const int16_t* ) p, pts, &packed[ 0 ] );
+    }
+    fwrite( &packed[ 0 ], 1, pts / 4, file );
+}
+
+void StreamLEAPDumper::finishFile() {
+    if ( carry_pts ) {
+        // last group is filled by zero codes
+        memset( carry + carry_pts * bytes_per_point, 0, ( 8 - carry_pts ) * bytes_per_point );
+        packPoints( carry, 8 );
+        carry_pts = 0;
+    }
+    fclose( file );
+    file = NULL;
+}
+
 long long StreamLEAPDumper::GetUTCTicks() {
     time_t t = time(0);
     long long ticks = t;
@@ -117,27 +210,20 @@ long long StreamLEAPDumper::GetUTCTicks() {
     return ticks;
 }
 
+// Header is complete before data, chunk sizes are known from params
 void StreamLEAPDumper::writeDateTime() {
     long long now_ticks = GetUTCTicks();
-    fwrite( &now_ticks, sizeof( long long ), 1, file );
+    if ( pars.all_chans_raw_sig ) {
+        fwrite( &now_ticks, sizeof( long long ), 1, file );
+    } else {
+        int pts_per_ms = ( int ) ( sample_rate_hz / 1000.0 );
+        LEAPConverter header( ( int32_t ) sample_rate_hz, inter_freq_hz );
+        header.SetTimestamp( now_ticks );
+        header.SetChunks( pars.count,
+                          pts_per_ms ? pars.len / pts_per_ms : 0,
+                          pts_per_ms ? pars.gap / pts_per_ms : 0 );
+        header.writeHeader( file );
+    }
 
     state = DS_ChunkProcess;
 }
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
@@ -5,14 +5,17 @@
 #include <datastreams/streamdatahandler.h>
 #include <string>
 #include <mutex>
+#include <vector>
 #include "stdio.h"
+#include "hwfx3/fx3config.h"
 
 
 // Example:
 // XX.....XX.....XX.....XX
 // count = 4 chunks
-// len   = 2 bytes
-// gap   = 5 bytes
+// len   = 2 points
+// gap   = 5 points
+// Point is one sample of chan_num, or one point of all channels for all_chans_raw_sig
 struct ChunkDumpParams {
     int count;
     int len;
@@ -34,33 +37,55 @@ public:
     virtual void onFileDumpComplete( std::string fname, ChunkDumpParams params ) = 0;
 };
 
+/*
+ * Writes LEAP file (header and sign/magnitude bit planes of chan_num) while data is streamed,
+ * 2-bit ADC data is packed straight from raw bytes. all_chans_raw_sig writes raw chunks
+ * after time stamp instead.
+ */
 class StreamLEAPDumper  : public StreamDataHandler
 {
 public:
     StreamLEAPDumper();
+    // ADC type, sample rate and intermediate frequency of stream, used by next DumpAsync
+    void SetConfig( const FX3Config& cfg );
     int DumpAsync( const char* file_name, ChunkDumpParams params, ChunkDumpCallbackIfce* callback );
     
     // StreamDataHandler interface
     virtual void HandleADCStreamData(void* data, size_t size8);
     virtual void HandleStreamDataOneChan(short* one_ch_data, size_t pts_cnt, int channel);
+    virtual StreamSubscription GetSubscription();
     
 
 private:    
     long long GetUTCTicks();
     void writeDateTime();
-    void processData( uint8_t* p, int size );
+    void processData( const uint8_t* p, size_t pts );
+    void writeChunk( const uint8_t* p, size_t pts );
+    void packPoints( const uint8_t* p, size_t pts );
+    void finishFile();
 
 private:
     std::string fname;
     FILE* file;
     ChunkDumpCallbackIfce* cback;
     std::mutex mtx;
-    
+
+    ADCType adc_type;
+    double sample_rate_hz;
+    double inter_freq_hz;
+    bool from_raw_2bit;         // bit planes are packed from raw 2-bit data, else from int16 channel
+    size_t bytes_per_point;     // of data given to processData
+
     ChunkDumpParams pars;
     int have_count;
-    int cur_chunk_len;
-    int cur_gap;
+    int64_t cur_chunk_len;
+    int64_t cur_gap;
     DumpState_e state;
+
+    // points of unfinished group of 8, chunks are packed as one continuous stream
+    uint8_t carry[ 8 * sizeof( int16_t ) ];
+    size_t carry_pts;
+    std::vector< uint8_t > packed;
 };
 
 #endif // STREAMLEAPDUMPER_H
@@ -0,0 +1,136 @@
+#include "streamuringdumper.h"
+#include "uringfilewriter.h"
+#include "asyncfilewriter.h"
+#include <cstdio>
+
+StreamUringDumper::StreamUringDumper() :
+    writer( NULL ),
+    overrun_cback( NULL ),
+    reported_dropped8( 0 ),
+    start_ns( 0 ),
+    stop_ns( 0 )
+{
+    // Large writes, enough of them in flight to keep the disk queue busy
+    writer_opts.buffer_size8  = 8 * 1024 * 1024;
+    writer_opts.buffers_count = 8;
+
+    if ( UringFileWriter::IsSupported() ) {
+        writer = new UringFileWriter();
+    } else {
+        fprintf( stderr, "__warning__ StreamUringDumper: io_uring is not available, using threaded writer\n" );
+        writer = new AsyncFileWriter();
+    }
+}
+
+StreamUringDumper::~StreamUringDumper() {
+    StopDump();
+    delete writer;
+}
+
+void StreamUringDumper::SetDumpFileName( const char* fname ) {
+    fmtx.lock();
+    this->fname = fname;
+    fmtx.unlock();
+}
+
+void StreamUringDumper::SetWriterOptions( const AsyncWriterOptions& opts ) {
+    fmtx.lock();
+    writer_opts = opts;
+    fmtx.unlock();
+}
+
+void StreamUringDumper::SetOverrunCallBack( FileDumpCallbackIfce* callback ) {
+    fmtx.lock();
+    overrun_cback = callback;
+    fmtx.unlock();
+}
+
+bool StreamUringDumper::StartDump() {
+    fmtx.lock();
+    fprintf( stderr, "Start dumping to file '%s' (%s, %u x %.1f MBytes)\n", fname.c_str(), writer->BackendName(),
+             writer_opts.buffers_count, writer_opts.buffer_size8 / ( 1024.0 * 1024.0 ) );
+    reported_dropped8 = 0;
+    bool ok = writer->Open( fname, writer_opts );
+    if ( !ok && dynamic_cast< UringFileWriter* >( writer ) ) {
+        // e.g. buffers can't be registered with low RLIMIT_MEMLOCK, threaded writer is kept if it works
+        FileWriterIfce* fallback = new AsyncFileWriter();
+        ok = fallback->Open( fname, writer_opts );
+        if ( ok ) {
+            fprintf( stderr, "__warning__ StreamUringDumper: io_uring writer failed, using threaded writer\n" );
+            delete writer;
+            writer = fallback;
+        } else {
+            delete fallback;
+        }
+    }
+    start_ns = StreamHostTimeNs();
+    stop_ns  = 0;
+    fmtx.unlock();
+    return ok;
+}
+
+void StreamUringDumper::StopDump() {
+    fmtx.lock();
+    if ( writer->IsOpen() ) {
+        writer->Close();
+        stop_ns = StreamHostTimeNs();
+        fmtx.unlock();
+        StreamUringDumperStats st = GetStats();
+        fprintf( stderr, "StreamUringDumper: %.1f MBytes in %.1f s, %.1f MBytes/sec (%s, max %u writes in flight)\n",
+                 st.writer.written8 / ( 1024.0 * 1024.0 ), ( stop_ns - start_ns ) / 1.0e9,
+                 st.mbytes_per_sec, st.backend, st.queued_max );
+        return;
+    }
+    fmtx.unlock();
+}
+
+StreamUringDumperStats StreamUringDumper::GetStats() const {
+    StreamUringDumperStats st;
+    fmtx.lock();
+    st.backend = writer->BackendName();
+    st.writer  = writer->GetStats();
+    int64_t end_ns = stop_ns ? stop_ns : StreamHostTimeNs();
+    double secs = start_ns ? ( end_ns - start_ns ) / 1.0e9 : 0.0;
+    fmtx.unlock();
+    st.mbytes_per_sec = secs > 0.0 ? st.writer.written8 / ( 1024.0 * 1024.0 ) / secs : 0.0;
+    st.queued     = st.writer.queued;
+    st.queued_max = st.writer.queued_max;
+    return st;
+}
+
+void StreamUringDumper::HandleADCStreamData( void* data, size_t size8 ) {
+    bool ok = true;
+    fmtx.lock();
+    if ( writer->IsOpen() ) {
+        ok = writer->Write( data, size8 );
+    }
+    fmtx.unlock();
+    if ( !ok ) {
+        CheckOverrun();
+    }
+}
+
+StreamSubscription StreamUringDumper::GetSubscription() {
+    StreamSubscription sub;
+    fmtx.lock();
+    sub.raw = writer->IsOpen();
+    fmtx.unlock();
+    return sub;
+}
+
+void StreamUringDumper::CheckOverrun() {
+    AsyncWriterStats st = writer->GetStats();
+    fmtx.lock();
+    uint64_t lost8 = st.dropped8 - reported_dropped8;
+    reported_dropped8 = st.dropped8;
+    FileDumpCallbackIfce* cb = overrun_cback;
+    fmtx.unlock();
+    if ( !lost8 ) {
+        return;
+    }
+    fprintf( stderr, "__error__ StreamUringDumper: disk is too slow, %llu bytes of '%s' lost (%llu overruns, %u writes in flight)\n",
+             ( unsigned long long ) lost8, fname.c_str(), ( unsigned long long ) st.overruns, st.queued );
+    if ( cb ) {
+        cb->onFileDumpOverrun( lost8 );
+    }
+}
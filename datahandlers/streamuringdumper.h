@@ -0,0 +1,60 @@
+#ifndef STREAMURINGDUMPER_H
+#define STREAMURINGDUMPER_H
+
+#include <cstdint>
+#include <string>
+#include <mutex>
+
+#include "datastreams/streamdatahandler.h"
+#include "datahandlers/filedumpcallbackifce.h"
+#include "datahandlers/filewriterifce.h"
+
+struct StreamUringDumperStats {
+    const char* backend;
+    double   mbytes_per_sec;    // since StartDump
+    uint32_t queued;            // writes in flight now
+    uint32_t queued_max;
+    AsyncWriterStats writer;
+};
+
+/*
+ * Records all ADC data with several large writes in flight (UringFileWriter).
+ * Where io_uring is not available it falls back to the threaded AsyncFileWriter.
+ */
+class StreamUringDumper : public StreamDataHandler
+{
+public:
+    StreamUringDumper();
+    ~StreamUringDumper();
+
+    void SetDumpFileName( const char* fname );
+    // Used by next StartDump
+    void SetWriterOptions( const AsyncWriterOptions& opts );
+    void SetOverrunCallBack( FileDumpCallbackIfce* callback );
+    // Falls back to threaded writer if io_uring one can't be opened, false if file is not opened
+    bool StartDump();
+    void StopDump();
+
+    StreamUringDumperStats GetStats() const;
+
+    // StreamDataHandler interface
+    virtual void HandleADCStreamData( void* data, size_t size8 );
+    StreamSubscription GetSubscription();
+
+private:
+    StreamUringDumper( const StreamUringDumper& );
+    StreamUringDumper& operator=( const StreamUringDumper& );
+
+    void CheckOverrun();
+
+    std::string fname;
+    AsyncWriterOptions writer_opts;
+    FileWriterIfce* writer;
+    FileDumpCallbackIfce* overrun_cback;
+    uint64_t reported_dropped8;
+    int64_t start_ns;
+    int64_t stop_ns;
+    mutable std::mutex fmtx;
+};
+
+#endif // STREAMURINGDUMPER_H
@@ -0,0 +1,458 @@
+#include "uringfilewriter.h"
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <datastreams/datablock.h>
+
+#ifdef HAVE_IO_URING
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#endif
+
+UringFileWriter::UringFileWriter() :
+    is_open( false ),
+    fd( -1 ),
+    direct( false ),
+    cur( -1 ),
+    file_offset8( 0 ),
+    inflight( 0 ),
+    ring_fd( -1 ),
+    sq_ptr( NULL ),
+    cq_ptr( NULL ),
+    sqes_ptr( NULL ),
+    sq_size8( 0 ),
+    cq_size8( 0 ),
+    sqes_size8( 0 ),
+    sq_head( NULL ),
+    sq_tail( NULL ),
+    sq_mask( NULL ),
+    sq_array( NULL ),
+    cq_head( NULL ),
+    cq_tail( NULL ),
+    cq_mask( NULL ),
+    cqes( NULL ),
+    write_ms_sum( 0.0 ),
+    in_overrun( false )
+{
+}
+
+UringFileWriter::~UringFileWriter() {
+    Close();
+}
+
+bool UringFileWriter::IsOpen() const {
+    return is_open;
+}
+
+const char* UringFileWriter::BackendName() const {
+    return "io_uring";
+}
+
+AsyncWriterStats UringFileWriter::GetStats() const {
+    std::lock_guard< std::mutex > lck( mtx_stats );
+    return stats;
+}
+
+void UringFileWriter::freeBuffers() {
+    for ( size_t i = 0; i < buffers.size(); i++ ) {
+        writer_free_aligned( buffers[ i ].data );
+    }
+    buffers.clear();
+    free_idx.clear();
+}
+
+#ifndef HAVE_IO_URING
+
+bool UringFileWriter::IsSupported() {
+    return false;
+}
+
+bool UringFileWriter::Open( const std::string& fname, const AsyncWriterOptions& ) {
+    fprintf( stderr, "__error__ UringFileWriter::Open(%s) io_uring is not supported on this platform\n", fname.c_str() );
+    return false;
+}
+
+bool UringFileWriter::Write( const void*, size_t ) {
+    return false;
+}
+
+void UringFileWriter::Close() {
+}
+
+#else
+
+static int sys_io_uring_setup( uint32_t entries, io_uring_params* p ) {
+    return ( int ) syscall( __NR_io_uring_setup, entries, p );
+}
+
+static int sys_io_uring_enter( int ring_fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags ) {
+    return ( int ) syscall( __NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0 );
+}
+
+static int sys_io_uring_register( int ring_fd, uint32_t opcode, const void* arg, uint32_t nr_args ) {
+    return ( int ) syscall( __NR_io_uring_register, ring_fd, opcode, arg, nr_args );
+}
+
+static bool probe_io_uring() {
+    io_uring_params p;
+    memset( &p, 0, sizeof( p ) );
+    int rfd = sys_io_uring_setup( 1, &p );
+    if ( rfd < 0 ) {
+        return false;
+    }
+    close( rfd );
+    return true;
+}
+
+bool UringFileWriter::IsSupported() {
+    // probed once, static initialization is thread-safe
+    static const bool supported = probe_io_uring();
+    return supported;
+}
+
+bool UringFileWriter::setupRing( uint32_t entries ) {
+    io_uring_params p;
+    memset( &p, 0, sizeof( p ) );
+    ring_fd = sys_io_uring_setup( entries, &p );
+    if ( ring_fd < 0 ) {
+        fprintf( stderr, "__error__ UringFileWriter: io_uring_setup failed: %s\n", strerror( errno ) );
+        return false;
+    }
+    sq_size8 = p.sq_off.array + p.sq_entries * sizeof( uint32_t );
+    cq_size8 = p.cq_off.cqes + p.cq_entries * sizeof( io_uring_cqe );
+    bool single_mmap = ( p.features & IORING_FEAT_SINGLE_MMAP ) != 0;
+    if ( single_mmap ) {
+        sq_size8 = cq_size8 = ( sq_size8 > cq_size8 ) ? sq_size8 : cq_size8;
+    }
+    sq_ptr = mmap( NULL, sq_size8, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING );
+    if ( sq_ptr == MAP_FAILED ) {
+        sq_ptr = NULL;
+        return false;
+    }
+    if ( single_mmap ) {
+        cq_ptr = sq_ptr;
+    } else {
+        cq_ptr = mmap( NULL, cq_size8, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING );
+        if ( cq_ptr == MAP_FAILED ) {
+            cq_ptr = NULL;
+            return false;
+        }
+    }
+    sqes_size8 = p.sq_entries * sizeof( io_uring_sqe );
+    sqes_ptr = mmap( NULL, sqes_size8, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES );
+    if ( sqes_ptr == MAP_FAILED ) {
+        sqes_ptr = NULL;
+        return false;
+    }
+    uint8_t* sq = ( uint8_t* ) sq_ptr;
+    uint8_t* cq = ( uint8_t* ) cq_ptr;
+    sq_head  = ( uint32_t* ) ( sq + p.sq_off.head );
+    sq_tail  = ( uint32_t* ) ( sq + p.sq_off.tail );
+    sq_mask  = ( uint32_t* ) ( sq + p.sq_off.ring_mask );
+    sq_array = ( uint32_t* ) ( sq + p.sq_off.array );
+    cq_head  = ( uint32_t* ) ( cq + p.cq_off.head );
+    cq_tail  = ( uint32_t* ) ( cq + p.cq_off.tail );
+    cq_mask  = ( uint32_t* ) ( cq + p.cq_off.ring_mask );
+    cqes     = cq + p.cq_off.cqes;
+    return true;
+}
+
+void UringFileWriter::closeRing() {
+    if ( sqes_ptr ) {
+        munmap( sqes_ptr, sqes_size8 );
+    }
+    if ( cq_ptr && cq_ptr != sq_ptr ) {
+        munmap( cq_ptr, cq_size8 );
+    }
+    if ( sq_ptr ) {
+        munmap( sq_ptr, sq_size8 );
+    }
+    sq_ptr = cq_ptr = sqes_ptr = NULL;
+    if ( ring_fd >= 0 ) {
+        close( ring_fd );
+        ring_fd = -1;
+    }
+}
+
+bool UringFileWriter::Open( const std::string& fname, const AsyncWriterOptions& options ) {
+    Close();
+    this->fname = fname;
+    opts = options;
+    if ( opts.buffers_count < 2 ) {
+        opts.buffers_count = 2;
+    }
+    opts.buffer_size8 = ( ( opts.buffer_size8 + IO_ALIGN - 1 ) / IO_ALIGN ) * IO_ALIGN;
+    if ( opts.buffer_size8 == 0 ) {
+        opts.buffer_size8 = IO_ALIGN;
+    }
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    direct = false;
+    if ( opts.direct_io ) {
+        fd = open( fname.c_str(), flags | O_DIRECT, 0644 );
+        if ( fd >= 0 ) {
+            direct = true;
+        } else {
+            fprintf( stderr, "__warning__ UringFileWriter::Open() O_DIRECT is not supported for '%s' (%s), using page cache\n",
+                     fname.c_str(), strerror( errno ) );
+        }
+    }
+    if ( fd < 0 ) {
+        fd = open( fname.c_str(), flags, 0644 );
+    }
+    if ( fd < 0 ) {
+        fprintf( stderr, "__error__ UringFileWriter::Open() can't open '%s': %s\n", fname.c_str(), strerror( errno ) );
+        return false;
+    }
+    if ( opts.prealloc_size8 ) {
+        int res = posix_fallocate( fd, 0, ( off_t ) opts.prealloc_size8 );
+        if ( res != 0 ) {
+            fprintf( stderr, "__warning__ UringFileWriter::Open() preallocation of %llu bytes failed: %s\n",
+                     ( unsigned long long ) opts.prealloc_size8, strerror( res ) );
+        }
+    }
+
+    if ( !setupRing( opts.buffers_count ) ) {
+        closeRing();
+        close( fd );
+        fd = -1;
+        return false;
+    }
+
+    buffers.resize( opts.buffers_count );
+    std::vector< iovec > iovs( opts.buffers_count );
+    for ( uint32_t i = 0; i < opts.buffers_count; i++ ) {
+        buffers[ i ].data = writer_alloc_aligned( opts.buffer_size8 );
+        if ( !buffers[ i ].data ) {
+            fprintf( stderr, "__error__ UringFileWriter::Open() no memory for %u buffers of %llu bytes\n",
+                     opts.buffers_count, ( unsigned long long ) opts.buffer_size8 );
+            freeBuffers();
+            closeRing();
+            close( fd );
+            fd = -1;
+            return false;
+        }
+        buffers[ i ].fill8 = 0;
+        iovs[ i ].iov_base = buffers[ i ].data;
+        iovs[ i ].iov_len  = opts.buffer_size8;
+        free_idx.push_back( opts.buffers_count - 1 - i );
+    }
+    // Registered buffers and file save page pinning and fd lookup for every write
+    if ( sys_io_uring_register( ring_fd, IORING_REGISTER_BUFFERS, &iovs[ 0 ], opts.buffers_count ) != 0 ||
+         sys_io_uring_register( ring_fd, IORING_REGISTER_FILES, &fd, 1 ) != 0 ) {
+        fprintf( stderr, "__error__ UringFileWriter::Open() can't register buffers or file: %s (check ulimit -l)\n", strerror( errno ) );
+        freeBuffers();
+        closeRing();
+        close( fd );
+        fd = -1;
+        return false;
+    }
+
+    mtx_stats.lock();
+    stats = AsyncWriterStats();
+    write_ms_sum = 0.0;
+    mtx_stats.unlock();
+    in_overrun   = false;
+    cur          = -1;
+    file_offset8 = 0;
+    inflight     = 0;
+    is_open      = true;
+    return true;
+}
+
+bool UringFileWriter::submitWrite( uint32_t buf_idx ) {
+    Buffer& buf = buffers[ buf_idx ];
+    uint32_t tail = *sq_tail;
+    uint32_t idx  = tail & *sq_mask;
+    io_uring_sqe* sqe = ( ( io_uring_sqe* ) sqes_ptr ) + idx;
+    memset( sqe, 0, sizeof( *sqe ) );
+    sqe->opcode    = IORING_OP_WRITE_FIXED;
+    sqe->flags     = IOSQE_FIXED_FILE;
+    sqe->fd        = 0;     // index of registered file
+    sqe->off       = buf.offset8 + buf.done8;
+    sqe->addr      = ( uint64_t ) ( uintptr_t ) ( buf.data + buf.done8 );
+    sqe->len       = ( uint32_t ) ( buf.fill8 - buf.done8 );
+    sqe->buf_index = ( uint16_t ) buf_idx;
+    sqe->user_data = buf_idx;
+    sq_array[ idx ] = idx;
+    __atomic_store_n( sq_tail, tail + 1, __ATOMIC_RELEASE );
+
+    int res;
+    do {
+        res = sys_io_uring_enter( ring_fd, 1, 0, 0 );
+    } while ( res < 0 && errno == EINTR );
+    if ( res < 0 ) {
+        fprintf( stderr, "__error__ UringFileWriter: io_uring_enter failed: %s\n", strerror( errno ) );
+        return false;
+    }
+    return true;
+}
+
+void UringFileWriter::reap( uint32_t min_complete ) {
+    if ( min_complete > inflight ) {
+        min_complete = inflight;
+    }
+    if ( min_complete ) {
+        int res;
+        do {
+            res = sys_io_uring_enter( ring_fd, 0, min_complete, IORING_ENTER_GETEVENTS );
+        } while ( res < 0 && errno == EINTR );
+    }
+    uint32_t head = *cq_head;
+    uint32_t tail = __atomic_load_n( cq_tail, __ATOMIC_ACQUIRE );
+    while ( head != tail ) {
+        const io_uring_cqe* cqe = ( ( const io_uring_cqe* ) cqes ) + ( head & *cq_mask );
+        uint32_t buf_idx = ( uint32_t ) cqe->user_data;
+        int res = cqe->res;
+        head++;
+        __atomic_store_n( cq_head, head, __ATOMIC_RELEASE );
+
+        Buffer& buf = buffers[ buf_idx ];
+        if ( res > 0 ) {
+            buf.done8 += res;
+            if ( buf.done8 < buf.fill8 && submitWrite( buf_idx ) ) {
+                continue;   // short write, rest is in flight again
+            }
+        }
+        double ms = ( StreamHostTimeNs() - buf.submit_ns ) / 1.0e6;
+        mtx_stats.lock();
+        if ( res < 0 || buf.done8 < buf.fill8 ) {
+            if ( !stats.error ) {
+                stats.error = res < 0 ? -res : EIO;
+                fprintf( stderr, "__error__ UringFileWriter: write to '%s' failed: %s\n", fname.c_str(), strerror( stats.error ) );
+            }
+            stats.written8 += buf.done8;
+            stats.dropped8 += buf.fill8 - buf.done8;
+        } else {
+            stats.written8 += buf.fill8;
+            stats.writes++;
+            write_ms_sum += ms;
+            stats.write_ms_avg = write_ms_sum / stats.writes;
+            if ( ms > stats.write_ms_max ) {
+                stats.write_ms_max = ms;
+            }
+        }
+        inflight--;
+        stats.queued = inflight;
+        mtx_stats.unlock();
+        buf.fill8 = 0;
+        free_idx.push_back( buf_idx );
+        tail = __atomic_load_n( cq_tail, __ATOMIC_ACQUIRE );
+    }
+}
+
+bool UringFileWriter::Write( const void* data, size_t size8 ) {
+    if ( !is_open ) {
+        return false;
+    }
+    reap( 0 );
+    // as AsyncFileWriter, data which does not fit is dropped as a whole
+    size_t space8 = ( cur >= 0 ? opts.buffer_size8 - buffers[ cur ].fill8 : 0 ) + free_idx.size() * opts.buffer_size8;
+    if ( size8 > space8 ) {
+        std::lock_guard< std::mutex > lck( mtx_stats );
+        stats.dropped8 += size8;
+        if ( !in_overrun ) {
+            stats.overruns++;
+            in_overrun = true;
+        }
+        return false;
+    }
+    in_overrun = false;
+    const uint8_t* src = ( const uint8_t* ) data;
+    while ( size8 ) {
+        if ( cur < 0 ) {
+            cur = free_idx.back();
+            free_idx.pop_back();
+            buffers[ cur ].fill8 = 0;
+        }
+        Buffer& buf = buffers[ cur ];
+        size_t chunk8 = opts.buffer_size8 - buf.fill8;
+        if ( chunk8 > size8 ) {
+            chunk8 = size8;
+        }
+        memcpy( buf.data + buf.fill8, src, chunk8 );
+        buf.fill8 += chunk8;
+        src   += chunk8;
+        size8 -= chunk8;
+        if ( buf.fill8 == opts.buffer_size8 ) {
+            buf.done8     = 0;
+            buf.offset8   = file_offset8;
+            buf.submit_ns = StreamHostTimeNs();
+            file_offset8 += buf.fill8;
+            inflight++;
+            mtx_stats.lock();
+            stats.queued = inflight;
+            if ( inflight > stats.queued_max ) {
+                stats.queued_max = inflight;
+            }
+            mtx_stats.unlock();
+            if ( !submitWrite( cur ) ) {
+                // kernel did not take it, buffer is lost
+                inflight--;
+                mtx_stats.lock();
+                stats.dropped8 += buf.fill8;
+                stats.error = stats.error ? stats.error : EIO;
+                mtx_stats.unlock();
+                buf.fill8 = 0;
+                free_idx.push_back( cur );
+            }
+            cur = -1;
+        }
+    }
+    std::lock_guard< std::mutex > lck( mtx_stats );
+    return stats.error == 0;
+}
+
+void UringFileWriter::Close() {
+    if ( !is_open ) {
+        return;
+    }
+    while ( inflight ) {
+        reap( inflight );
+    }
+    // Partial last buffer is written directly, O_DIRECT can't write its unaligned tail
+    if ( cur >= 0 && buffers[ cur ].fill8 ) {
+        Buffer& buf = buffers[ cur ];
+        if ( direct ) {
+            fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) & ~O_DIRECT );
+        }
+        size_t done8 = 0;
+        while ( done8 < buf.fill8 ) {
+            ssize_t res = pwrite( fd, buf.data + done8, buf.fill8 - done8, ( off_t ) ( file_offset8 + done8 ) );
+            if ( res < 0 ) {
+                if ( errno == EINTR ) {
+                    continue;
+                }
+                break;
+            }
+            done8 += res;
+        }
+        mtx_stats.lock();
+        stats.written8 += done8;
+        stats.dropped8 += buf.fill8 - done8;
+        mtx_stats.unlock();
+        file_offset8 += done8;
+    }
+    cur = -1;
+
+    if ( opts.prealloc_size8 && ftruncate( fd, ( off_t ) file_offset8 ) != 0 ) {
+        fprintf( stderr, "__warning__ UringFileWriter::Close() ftruncate failed: %s\n", strerror( errno ) );
+    }
+    closeRing();
+    close( fd );
+    fd = -1;
+    freeBuffers();
+    is_open = false;
+
+    AsyncWriterStats st = GetStats();
+    fprintf( stderr, "UringFileWriter: '%s' %.1f MBytes, %llu writes avg %.2f ms max %.2f ms, max %u in flight, %llu overruns %.1f MBytes lost%s\n",
+             fname.c_str(), st.written8 / ( 1024.0 * 1024.0 ), ( unsigned long long ) st.writes,
+             st.write_ms_avg, st.write_ms_max, st.queued_max, ( unsigned long long ) st.overruns,
+             st.dropped8 / ( 1024.0 * 1024.0 ), st.error ? ", WRITE ERROR" : "" );
+}
+
+#endif // HAVE_IO_URING
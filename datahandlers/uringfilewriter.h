@@ -0,0 +1,93 @@
+#ifndef URINGFILEWRITER_H
+#define URINGFILEWRITER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include "filewriterifce.h"
+
+#if defined( __linux__ ) && !defined( NO_IO_URING )
+#define HAVE_IO_URING
+#endif
+
+/*
+ * Linux io_uring file writer (raw syscalls, liburing is not needed).
+ * Buffers are registered in kernel (IORING_REGISTER_BUFFERS) and file is registered as
+ * fixed file, every full buffer is one IORING_OP_WRITE_FIXED, up to buffers_count writes are in flight.
+ * Submissions and completions are done in Write() by caller thread, there is no writer thread.
+ * IsSupported() is false if kernel has no io_uring or it is disabled (then use AsyncFileWriter).
+ */
+class UringFileWriter : public FileWriterIfce {
+public:
+    UringFileWriter();
+    ~UringFileWriter();
+
+    static bool IsSupported();
+
+    bool Open( const std::string& fname, const AsyncWriterOptions& opts = AsyncWriterOptions() );
+    bool Write( const void* data, size_t size8 );
+    // Also waits for all writes in flight
+    void Close();
+
+    bool IsOpen() const;
+    AsyncWriterStats GetStats() const;
+    const char* BackendName() const;
+
+private:
+    UringFileWriter( const UringFileWriter& );
+    UringFileWriter& operator=( const UringFileWriter& );
+
+    struct Buffer {
+        uint8_t* data;
+        size_t   fill8;
+        size_t   done8;         // written part while in flight
+        uint64_t offset8;       // position in file
+        int64_t  submit_ns;
+    };
+
+    bool setupRing( uint32_t entries );
+    void closeRing();
+    bool submitWrite( uint32_t buf_idx );
+    // Handles finished writes, waits for at least min_complete of them
+    void reap( uint32_t min_complete );
+    void freeBuffers();
+
+    std::string fname;
+    AsyncWriterOptions opts;
+    bool is_open;
+    int fd;
+    bool direct;
+
+    std::vector< Buffer > buffers;
+    std::vector< uint32_t > free_idx;
+    int32_t cur;                // buffer filled by Write(), -1 if none
+    uint64_t file_offset8;
+    uint32_t inflight;
+
+    // io_uring rings
+    int ring_fd;
+    void* sq_ptr;
+    void* cq_ptr;
+    void* sqes_ptr;
+    size_t sq_size8;
+    size_t cq_size8;
+    size_t sqes_size8;
+    uint32_t* sq_head;
+    uint32_t* sq_tail;
+    uint32_t* sq_mask;
+    uint32_t* sq_array;
+    uint32_t* cq_head;
+    uint32_t* cq_tail;
+    uint32_t* cq_mask;
+    void* cqes;
+
+    mutable std::mutex mtx_stats;
+    AsyncWriterStats stats;
+    double write_ms_sum;
+    bool in_overrun;
+};
+
+#endif // URINGFILEWRITER_H
@@ -0,0 +1,130 @@
+#ifndef ADCFORMAT_H
+#define ADCFORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "hwfx3/fx3config.h"
+#include "util/Chan2bitParser.h"
+#include "util/IQ16Parser.h"
+#include "util/SamplePack.h"
+
+#define STREAM_MAX_CHANS ( 4 )
+
+/*
+ * ADC stream format traits, one struct per stream layout:
+ *   CHANS             - number of channels in stream
+ *   BYTES_PER_POINT   - bytes of ADC data for one sample of every channel
+ *   ZERO_COPY16       - Decode16 points dst into the source data instead of writing to it
+ *   NARROW_FROM_INT16 - Decode8 and DecodeF convert already decoded int16 planes
+ *   Decode16 / Decode8 / DecodeF - convert pts points to planes, dst[ ch ] == NULL means channel is not needed
+ *
+ * New front-end is a new traits struct plus a line in adc_format_visit(), router and workers are not touched.
+ */
+
+// int8 and float planes are made from int16 planes (ADCs with more than 2 bits)
+struct AdcFormatFromInt16 {
+    static const bool NARROW_FROM_INT16 = true;
+
+    static void Decode8( const void*, int16_t* const src16[], size_t pts, int8_t* const dst[] ) {
+        for ( int ch = 0; ch < STREAM_MAX_CHANS; ch++ ) {
+            if ( dst[ ch ] ) {
+                narrow_int16_to_int8( src16[ ch ], pts, dst[ ch ] );
+            }
+        }
+    }
+
+    static void DecodeF( const void*, int16_t* const src16[], size_t pts, float* const dst[] ) {
+        for ( int ch = 0; ch < STREAM_MAX_CHANS; ch++ ) {
+            if ( dst[ ch ] ) {
+                for ( size_t i = 0; i < pts; i++ ) {
+                    dst[ ch ][ i ] = ( float ) src16[ ch ][ i ];
+                }
+            }
+        }
+    }
+};
+
+// NT1065, SE4150: one byte holds 2-bit samples of four channels
+struct AdcFormat2bit4ch {
+    static const uint32_t CHANS             = 4;
+    static const uint32_t BYTES_PER_POINT   = 1;
+    static const bool     ZERO_COPY16       = false;
+    static const bool     NARROW_FROM_INT16 = false;
+
+    static void Decode16( const void* src, size_t pts, int16_t* dst[] ) {
+        decode_2bit_4ch_int16( ( const uint8_t* ) src, pts, dst );
+    }
+    static void Decode8( const void* src, int16_t* const[], size_t pts, int8_t* const dst[] ) {
+        decode_2bit_4ch_int8( ( const uint8_t* ) src, pts, dst );
+    }
+    static void DecodeF( const void* src, int16_t* const[], size_t pts, float* const dst[] ) {
+        decode_2bit_4ch_float( ( const uint8_t* ) src, pts, dst );
+    }
+};
+
+// One channel of int16 samples, used as is
+struct AdcFormat16bit1ch : public AdcFormatFromInt16 {
+    static const uint32_t CHANS             = 1;
+    static const uint32_t BYTES_PER_POINT   = sizeof( int16_t );
+    static const bool     ZERO_COPY16       = true;
+
+    static void Decode16( const void* src, size_t, int16_t* dst[] ) {
+        dst[ 0 ] = ( int16_t* ) src;
+    }
+};
+
+// AD9361: two channels of int16 I/Q pairs interleaved pair by pair
+struct AdcFormatIQ16x2 : public AdcFormatFromInt16 {
+    static const uint32_t CHANS             = 2;
+    static const uint32_t BYTES_PER_POINT   = 2 * sizeof( int16_t );
+    static const bool     ZERO_COPY16       = false;
+
+    static void Decode16( const void* src, size_t pts, int16_t* dst[] ) {
+        deinterleave_iq16_2ch( ( const int16_t* ) src, pts, dst[ 0 ], dst[ 1 ] );
+    }
+};
+
+// Calls visitor.Visit< Format >() for traits of ADC type, returns false for unknown type
+template < class Visitor >
+bool adc_format_visit( ADCType type, Visitor& visitor ) {
+    switch ( type ) {
+        case ADC_NT1065:
+        case ADC_NT1065_File:
+        case ADC_SE4150:
+            visitor.template Visit< AdcFormat2bit4ch >();
+            return true;
+        case ADC_AD9361:
+            visitor.template Visit< AdcFormatIQ16x2 >();
+            return true;
+        case ADC_1ch_16bit:
+            visitor.template Visit< AdcFormat16bit1ch >();
+            return true;
+        default:
+            return false;
+    }
+}
+
+struct AdcFormatInfo {
+    uint32_t chans;
+    uint32_t bytes_per_point;
+    bool     packed_2bit;       // AdcFormat2bit4ch, raw data can be used without decoding
+
+    AdcFormatInfo() : chans( 0 ), bytes_per_point( 1 ), packed_2bit( false ) {}
+
+    template < class Format >
+    void Visit() {
+        chans           = Format::CHANS;
+        bytes_per_point = Format::BYTES_PER_POINT;
+        packed_2bit     = std::is_same< Format, AdcFormat2bit4ch >::value;
+    }
+};
+
+inline AdcFormatInfo adc_format_info( ADCType type ) {
+    AdcFormatInfo info;
+    adc_format_visit( type, info );
+    return info;
+}
+
+#endif // ADCFORMAT_H
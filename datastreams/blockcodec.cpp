@@ -0,0 +1,242 @@
+#include "blockcodec.h"
+#include <cstring>
+#include <queue>
+#include <vector>
+
+#define HUFF_SYMBOLS    ( 256 )
+#define HUFF_LENS_SIZE8 ( HUFF_SYMBOLS / 2 )
+#define HUFF_TABLE_SIZE ( 1 << BLOCK_CODEC_MAX_BITS )
+
+size_t block_compress_bound( size_t size8 ) {
+    return size8 + 1;
+}
+
+// Code lengths of Huffman tree, frequencies are halved until the longest code fits BLOCK_CODEC_MAX_BITS
+static void huff_lengths( const uint64_t freq_in[ HUFF_SYMBOLS ], uint8_t len[ HUFF_SYMBOLS ] ) {
+    uint64_t freq[ HUFF_SYMBOLS ];
+    memcpy( freq, freq_in, sizeof( freq ) );
+    memset( len, 0, HUFF_SYMBOLS );
+
+    typedef std::pair< uint64_t, int > Node;    // frequency, node
+    for ( ;; ) {
+        std::priority_queue< Node, std::vector< Node >, std::greater< Node > > heap;
+        int parent[ 2 * HUFF_SYMBOLS ];
+        int nodes = HUFF_SYMBOLS;
+        for ( int s = 0; s < HUFF_SYMBOLS; s++ ) {
+            if ( freq[ s ] ) {
+                heap.push( Node( freq[ s ], s ) );
+            }
+        }
+        if ( heap.size() == 1 ) {
+            len[ heap.top().second ] = 1;
+            return;
+        }
+        while ( heap.size() > 1 ) {
+            Node a = heap.top();
+            heap.pop();
+            Node b = heap.top();
+            heap.pop();
+            parent[ a.second ] = nodes;
+            parent[ b.second ] = nodes;
+            heap.push( Node( a.first + b.first, nodes ) );
+            nodes++;
+        }
+        int root = nodes - 1;
+
+        int max_len = 0;
+        for ( int s = 0; s < HUFF_SYMBOLS; s++ ) {
+            if ( !freq[ s ] ) {
+                continue;
+            }
+            int depth = 0;
+            for ( int n = s; n != root; n = parent[ n ] ) {
+                depth++;
+            }
+            len[ s ] = ( uint8_t ) depth;
+            if ( depth > max_len ) {
+                max_len = depth;
+            }
+        }
+        if ( max_len <= BLOCK_CODEC_MAX_BITS ) {
+            return;
+        }
+        for ( int s = 0; s < HUFF_SYMBOLS; s++ ) {
+            if ( freq[ s ] ) {
+                freq[ s ] = ( freq[ s ] >> 1 ) | 1;
+            }
+        }
+    }
+}
+
+// Canonical codes, bit reversed for LSB first stream
+static void huff_codes( const uint8_t len[ HUFF_SYMBOLS ], uint16_t code[ HUFF_SYMBOLS ] ) {
+    int count[ BLOCK_CODEC_MAX_BITS + 1 ] = { 0 };
+    for ( int s = 0; s < HUFF_SYMBOLS; s++ ) {
+        count[ len[ s ] ]++;
+    }
+    count[ 0 ] = 0;
+    int next[ BLOCK_CODEC_MAX_BITS + 1 ];
+    int c = 0;
+    for ( int l = 1; l <= BLOCK_CODEC_MAX_BITS; l++ ) {
+        c = ( c + count[ l - 1 ] ) << 1;
+        next[ l ] = c;
+    }
+    for ( int s = 0; s < HUFF_SYMBOLS; s++ ) {
+        int l = len[ s ];
+        code[ s ] = 0;
+        if ( !l ) {
+            continue;
+        }
+        int v = next[ l ]++;
+        int r = 0;
+        for ( int i = 0; i < l; i++ ) {
+            r |= ( ( v >> i ) & 1 ) << ( l - 1 - i );
+        }
+        code[ s ] = ( uint16_t ) r;
+    }
+}
+
+static size_t store_raw( const uint8_t* src, size_t size8, uint8_t* dst ) {
+    dst[ 0 ] = BlockCodec_Raw;
+    if ( size8 ) {
+        memcpy( dst + 1, src, size8 );
+    }
+    return size8 + 1;
+}
+
+size_t block_compress( const uint8_t* src, size_t size8, uint8_t* dst ) {
+    if ( !size8 ) {
+        return store_raw( src, size8, dst );
+    }
+    // four histograms, so neighbour equal bytes don't wait for the same counter
+    uint64_t hist[ 4 ][ HUFF_SYMBOLS ];
+    memset( hist, 0, sizeof( hist ) );
+    size_t i = 0;
+    for ( ; i + 4 <= size8; i += 4 ) {
+        hist[ 0 ][ src[ i + 0 ] ]++;
+        hist[ 1 ][ src[ i + 1 ] ]++;
+        hist[ 2 ][ src[ i + 2 ] ]++;
+        hist[ 3 ][ src[ i + 3 ] ]++;
+    }
+    for ( ; i < size8; i++ ) {
+        hist[ 0 ][ src[ i ] ]++;
+    }
+    uint64_t freq[ HUFF_SYMBOLS ];
+    for ( int s = 0; s < HUFF_SYMBOLS; s++ ) {
+        freq[ s ] = hist[ 0 ][ s ] + hist[ 1 ][ s ] + hist[ 2 ][ s ] + hist[ 3 ][ s ];
+    }
+
+    uint8_t len[ HUFF_SYMBOLS ];
+    huff_lengths( freq, len );
+    uint64_t bits = 0;
+    for ( int s = 0; s < HUFF_SYMBOLS; s++ ) {
+        bits += freq[ s ] * len[ s ];
+    }
+    size_t packed8 = 1 + HUFF_LENS_SIZE8 + ( size_t ) ( ( bits + 7 ) / 8 );
+    if ( packed8 >= block_compress_bound( size8 ) ) {
+        return store_raw( src, size8, dst );
+    }
+
+    uint16_t code[ HUFF_SYMBOLS ];
+    huff_codes( len, code );
+
+    uint8_t* out = dst;
+    *out++ = BlockCodec_Huff8;
+    for ( int s = 0; s < HUFF_SYMBOLS; s += 2 ) {
+        *out++ = ( uint8_t ) ( len[ s ] | ( len[ s + 1 ] << 4 ) );
+    }
+    uint64_t acc = 0;
+    int nbits = 0;
+    for ( i = 0; i < size8; i++ ) {
+        uint8_t s = src[ i ];
+        acc |= ( uint64_t ) code[ s ] << nbits;
+        nbits += len[ s ];
+        if ( nbits >= 32 ) {
+            out[ 0 ] = ( uint8_t ) ( acc );
+            out[ 1 ] = ( uint8_t ) ( acc >> 8 );
+            out[ 2 ] = ( uint8_t ) ( acc >> 16 );
+            out[ 3 ] = ( uint8_t ) ( acc >> 24 );
+            out   += 4;
+            acc  >>= 32;
+            nbits -= 32;
+        }
+    }
+    while ( nbits > 0 ) {
+        *out++ = ( uint8_t ) acc;
+        acc  >>= 8;
+        nbits -= 8;
+    }
+    return out - dst;
+}
+
+bool block_decompress( const uint8_t* src, size_t packed8, uint8_t* dst, size_t raw8 ) {
+    if ( !packed8 ) {
+        return false;
+    }
+    if ( src[ 0 ] == BlockCodec_Raw ) {
+        if ( packed8 != raw8 + 1 ) {
+            return false;
+        }
+        if ( raw8 ) {
+            memcpy( dst, src + 1, raw8 );
+        }
+        return true;
+    }
+    if ( src[ 0 ] != BlockCodec_Huff8 || packed8 < 1 + HUFF_LENS_SIZE8 ) {
+        return false;
+    }
+
+    uint8_t len[ HUFF_SYMBOLS ];
+    uint32_t kraft = 0;
+    for ( int s = 0; s < HUFF_SYMBOLS; s += 2 ) {
+        len[ s ]     = src[ 1 + s / 2 ] & 0x0F;
+        len[ s + 1 ] = src[ 1 + s / 2 ] >> 4;
+    }
+    for ( int s = 0; s < HUFF_SYMBOLS; s++ ) {
+        if ( len[ s ] > BLOCK_CODEC_MAX_BITS ) {
+            return false;
+        }
+        if ( len[ s ] ) {
+            kraft += HUFF_TABLE_SIZE >> len[ s ];
+        }
+    }
+    if ( kraft > HUFF_TABLE_SIZE ) {
+        return false;
+    }
+    uint16_t code[ HUFF_SYMBOLS ];
+    huff_codes( len, code );
+
+    // entry: symbol | length << 8, every index whose low bits are the code
+    std::vector< uint16_t > table( HUFF_TABLE_SIZE, 0 );
+    for ( int s = 0; s < HUFF_SYMBOLS; s++ ) {
+        int l = len[ s ];
+        if ( !l ) {
+            continue;
+        }
+        for ( int k = code[ s ]; k < HUFF_TABLE_SIZE; k += 1 << l ) {
+            table[ k ] = ( uint16_t ) ( s | ( l << 8 ) );
+        }
+    }
+
+    const uint8_t* in  = src + 1 + HUFF_LENS_SIZE8;
+    const uint8_t* end = src + packed8;
+    uint64_t acc = 0;
+    int nbits = 0;
+    for ( size_t i = 0; i < raw8; i++ ) {
+        if ( nbits < BLOCK_CODEC_MAX_BITS ) {
+            while ( nbits <= 56 && in < end ) {
+                acc |= ( uint64_t ) *in++ << nbits;
+                nbits += 8;
+            }
+        }
+        uint16_t e = table[ acc & ( HUFF_TABLE_SIZE - 1 ) ];
+        int l = e >> 8;
+        if ( !l || l > nbits ) {
+            return false;
+        }
+        dst[ i ] = ( uint8_t ) e;
+        acc  >>= l;
+        nbits -= l;
+    }
+    return true;
+}
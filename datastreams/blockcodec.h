@@ -0,0 +1,32 @@
+#ifndef BLOCKCODEC_H
+#define BLOCKCODEC_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Lossless coder of one data block, blocks are independent so they are packed and unpacked
+ * in parallel. Packed block starts with BlockCodec_t byte:
+ *   BlockCodec_Raw     data as is (used when data does not compress)
+ *   BlockCodec_Huff8   canonical Huffman code of bytes: code lengths of 256 byte values
+ *                      (4 bits each), then bit stream, LSB first
+ * Byte of 2-bit ADC data holds all channels, so quiet or disconnected channels make
+ * byte values uneven and the block shorter.
+ */
+enum BlockCodec_t {
+    BlockCodec_Raw   = 0,
+    BlockCodec_Huff8 = 1
+};
+
+#define BLOCK_CODEC_MAX_BITS ( 12 )
+
+// Size of dst buffer which is enough for block_compress of size8 bytes
+size_t block_compress_bound( size_t size8 );
+
+// Returns packed size
+size_t block_compress( const uint8_t* src, size_t size8, uint8_t* dst );
+
+// raw8 is size of data before packing, false if packed block is broken
+bool block_decompress( const uint8_t* src, size_t packed8, uint8_t* dst, size_t raw8 );
+
+#endif // BLOCKCODEC_H
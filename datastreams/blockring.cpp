@@ -0,0 +1,158 @@
+#include "blockring.h"
+#include <chrono>
+
+BlockRing::BlockRing( uint32_t depth, OverrunPolicy_t policy ) :
+    depth( depth ? depth : 1 ),
+    policy( policy ),
+    slots( NULL ),
+    head( 0 ),
+    tail( 0 ),
+    dropped_blocks( 0 ),
+    dropped_bytes( 0 ),
+    consumer_sleeping( false ),
+    producer_sleeping( false ),
+    wakeup_flag( false ),
+    wakeup_producer_flag( false )
+{
+    slots = new std::atomic<DataBlock*>[ this->depth ];
+    for ( uint32_t i = 0; i < this->depth; i++ ) {
+        slots[ i ].store( NULL, std::memory_order_relaxed );
+    }
+}
+
+BlockRing::~BlockRing() {
+    Flush();
+    delete [] slots;
+}
+
+bool BlockRing::Push( DataBlock* blk ) {
+    uint64_t h = head.load( std::memory_order_relaxed );
+    for ( ;; ) {
+        uint64_t t = tail.load( std::memory_order_acquire );
+        if ( h - t < depth ) {
+            break;
+        }
+        if ( policy == Overrun_DropNewest ) {
+            dropBlock( blk );
+            return false;
+        }
+        DataBlock* oldest = slots[ t % depth ].load( std::memory_order_relaxed );
+        if ( tail.compare_exchange_strong( t, t + 1, std::memory_order_acq_rel ) ) {
+            dropBlock( oldest );
+        }
+    }
+    publish( h, blk );
+    return true;
+}
+
+bool BlockRing::TryPush( DataBlock* blk ) {
+    uint64_t h = head.load( std::memory_order_relaxed );
+    uint64_t t = tail.load( std::memory_order_acquire );
+    if ( h - t >= depth ) {
+        return false;
+    }
+    publish( h, blk );
+    return true;
+}
+
+void BlockRing::publish( uint64_t h, DataBlock* blk ) {
+    slots[ h % depth ].store( blk, std::memory_order_relaxed );
+    head.store( h + 1, std::memory_order_seq_cst );
+
+    if ( consumer_sleeping.load( std::memory_order_seq_cst ) ) {
+        {
+            std::lock_guard<std::mutex> lck( mtx_sleep );
+        }
+        cv_sleep.notify_one();
+    }
+}
+
+DataBlock* BlockRing::Pop() {
+    for ( ;; ) {
+        uint64_t t = tail.load( std::memory_order_acquire );
+        uint64_t h = head.load( std::memory_order_acquire );
+        if ( t == h ) {
+            return NULL;
+        }
+        DataBlock* blk = slots[ t % depth ].load( std::memory_order_relaxed );
+        if ( tail.compare_exchange_strong( t, t + 1, std::memory_order_acq_rel ) ) {
+            if ( producer_sleeping.load( std::memory_order_seq_cst ) ) {
+                {
+                    std::lock_guard<std::mutex> lck( mtx_sleep );
+                }
+                cv_space.notify_one();
+            }
+            return blk;
+        }
+        // producer has dropped this block, try next one
+    }
+}
+
+bool BlockRing::WaitNotEmpty( uint32_t timeout_ms ) {
+    std::unique_lock<std::mutex> lck( mtx_sleep );
+    consumer_sleeping.store( true, std::memory_order_seq_cst );
+    bool have_data = cv_sleep.wait_for( lck, std::chrono::milliseconds( timeout_ms ), [this]() {
+        return wakeup_flag ||
+               head.load( std::memory_order_seq_cst ) != tail.load( std::memory_order_seq_cst );
+    } );
+    consumer_sleeping.store( false, std::memory_order_relaxed );
+    wakeup_flag = false;
+    return have_data;
+}
+
+bool BlockRing::WaitNotFull( uint32_t timeout_ms ) {
+    std::unique_lock<std::mutex> lck( mtx_sleep );
+    producer_sleeping.store( true, std::memory_order_seq_cst );
+    bool have_place = cv_space.wait_for( lck, std::chrono::milliseconds( timeout_ms ), [this]() {
+        return wakeup_producer_flag ||
+               head.load( std::memory_order_seq_cst ) - tail.load( std::memory_order_seq_cst ) < depth;
+    } );
+    producer_sleeping.store( false, std::memory_order_relaxed );
+    wakeup_producer_flag = false;
+    return have_place;
+}
+
+void BlockRing::Wakeup() {
+    {
+        std::lock_guard<std::mutex> lck( mtx_sleep );
+        wakeup_flag = true;
+        wakeup_producer_flag = true;
+    }
+    cv_sleep.notify_all();
+    cv_space.notify_all();
+}
+
+void BlockRing::Flush() {
+    DataBlock* blk;
+    while ( ( blk = Pop() ) != NULL ) {
+        blk->Release();
+    }
+}
+
+uint32_t BlockRing::Depth() const {
+    return depth;
+}
+
+uint32_t BlockRing::Size() const {
+    uint64_t t = tail.load( std::memory_order_acquire );
+    uint64_t h = head.load( std::memory_order_acquire );
+    return ( uint32_t ) ( h - t );
+}
+
+OverrunPolicy_t BlockRing::Policy() const {
+    return policy;
+}
+
+uint64_t BlockRing::DroppedBlocks() const {
+    return dropped_blocks.load( std::memory_order_relaxed );
+}
+
+uint64_t BlockRing::DroppedBytes() const {
+    return dropped_bytes.load( std::memory_order_relaxed );
+}
+
+void BlockRing::dropBlock( DataBlock* blk ) {
+    dropped_bytes.fetch_add( blk->size8, std::memory_order_relaxed );
+    dropped_blocks.fetch_add( 1, std::memory_order_relaxed );
+    blk->Release();
+}
@@ -0,0 +1,86 @@
+#ifndef BLOCKRING_H
+#define BLOCKRING_H
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#include "datablock.h"
+
+enum OverrunPolicy_t {
+    Overrun_DropNewest, // incoming block is discarded when ring is full
+    Overrun_DropOldest  // oldest queued block is discarded to make room for the incoming one
+};
+
+/*
+ * Bounded single-producer / single-consumer queue of DataBlock references.
+ * Push() and Pop() are lock-free, the mutex is touched only to wake up a sleeping consumer.
+ * With Overrun_DropOldest the producer also takes blocks from the tail, so head and tail
+ * are moved with compare-and-swap and every block is either popped or dropped exactly once.
+ */
+class BlockRing {
+public:
+    BlockRing( uint32_t depth, OverrunPolicy_t policy );
+    ~BlockRing();
+
+    // Producer side. Ring takes the caller's reference of blk.
+    // Returns false if blk was dropped (Overrun_DropNewest on full ring).
+    bool Push( DataBlock* blk );
+
+    // Producer side. Never drops: returns false and keeps caller's reference if ring is full.
+    bool TryPush( DataBlock* blk );
+
+    // Producer side. Sleeps until ring has free place, Wakeup() is called or timeout is expired.
+    bool WaitNotFull( uint32_t timeout_ms );
+
+    // Consumer side. Returns NULL when ring is empty, caller owns the returned reference.
+    DataBlock* Pop();
+
+    // Consumer side. Sleeps until ring is not empty, Wakeup() is called or timeout is expired.
+    bool WaitNotEmpty( uint32_t timeout_ms );
+
+    // Wakes up both sleeping consumer and producer
+    void Wakeup();
+
+    // Releases all queued blocks (not counted as drops)
+    void Flush();
+
+    uint32_t Depth() const;
+    uint32_t Size() const;
+    OverrunPolicy_t Policy() const;
+
+    uint64_t DroppedBlocks() const;
+    uint64_t DroppedBytes() const;
+
+private:
+    BlockRing( const BlockRing& );
+    BlockRing& operator=( const BlockRing& );
+
+    void dropBlock( DataBlock* blk );
+    void publish( uint64_t h, DataBlock* blk );
+
+    const uint32_t depth;
+    const OverrunPolicy_t policy;
+    std::atomic<DataBlock*>* slots;
+
+    // head and tail are kept in different cache lines. Padding is used instead of alignas
+    // to keep the class allocatable with plain new.
+    char pad0[ DATA_BLOCK_ALIGN ];
+    std::atomic<uint64_t> head;
+    char pad1[ DATA_BLOCK_ALIGN - sizeof( std::atomic<uint64_t> ) ];
+    std::atomic<uint64_t> tail;
+    char pad2[ DATA_BLOCK_ALIGN - sizeof( std::atomic<uint64_t> ) ];
+    std::atomic<uint64_t> dropped_blocks;
+    std::atomic<uint64_t> dropped_bytes;
+
+    std::atomic<bool> consumer_sleeping;
+    std::atomic<bool> producer_sleeping;
+    bool wakeup_flag;
+    bool wakeup_producer_flag;
+    std::mutex mtx_sleep;
+    std::condition_variable cv_sleep;
+    std::condition_variable cv_space;
+};
+
+#endif // BLOCKRING_H
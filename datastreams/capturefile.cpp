@@ -0,0 +1,450 @@
+#include "capturefile.h"
+#include "adcformat.h"
+#include "blockcodec.h"
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+
+static int capture_fseek( FILE* f, uint64_t offset, int origin ) {
+#ifdef WIN32
+    return _fseeki64( f, ( int64_t ) offset, origin );
+#else
+    return fseeko( f, ( off_t ) offset, origin );
+#endif
+}
+
+static uint64_t capture_ftell( FILE* f ) {
+#ifdef WIN32
+    return ( uint64_t ) _ftelli64( f );
+#else
+    return ( uint64_t ) ftello( f );
+#endif
+}
+
+CaptureHeader::CaptureHeader() {
+    memset( this, 0, sizeof( *this ) );
+    memcpy( magic, CAPTURE_MAGIC, sizeof( magic ) );
+    version         = CAPTURE_VERSION;
+    header_size8    = CAPTURE_HEADER_SIZE8;
+    bytes_per_point = 1;
+}
+
+void CaptureHeader::SetConfig( const FX3Config& cfg ) {
+    adc_type        = ( uint32_t ) cfg.adc_type;
+    chan_count      = ( uint32_t ) cfg.chan_count;
+    signal_type     = ( uint32_t ) cfg.signal_type;
+    sample_rate_hz  = cfg.adc_sample_rate_hz;
+    inter_freq_hz   = cfg.inter_freq_hz;
+    bytes_per_point = adc_format_info( cfg.adc_type ).bytes_per_point;
+}
+
+/* CaptureIndexer */
+
+CaptureIndexer::CaptureIndexer() :
+    file_pts( 0 ),
+    next_stream_sample( 0 ),
+    next_index_pt( 0 ),
+    have_blocks( false )
+{
+}
+
+void CaptureIndexer::Start( const CaptureHeader& hdr, uint64_t index_period_pts ) {
+    this->hdr = hdr;
+    this->hdr.index_period_pts = index_period_pts ? index_period_pts : DEF_INDEX_PERIOD_PTS;
+    if ( !this->hdr.bytes_per_point ) {
+        this->hdr.bytes_per_point = 1;
+    }
+    index.clear();
+    drops.clear();
+    blocks.clear();
+    file_pts      = 0;
+    next_index_pt = 0;
+    have_blocks   = false;
+}
+
+void CaptureIndexer::AddBlock( const StreamBlockInfo& info, size_t written8 ) {
+    uint64_t pts = written8 / hdr.bytes_per_point;
+    double ns_per_pt = hdr.sample_rate_hz > 0.0 ? 1.0e9 / hdr.sample_rate_hz : 0.0;
+
+    if ( !have_blocks ) {
+        // host_time_ns is taken when block is received, its first sample is one block earlier
+        int64_t wall_ns = std::chrono::duration_cast< std::chrono::nanoseconds >(
+                    std::chrono::system_clock::now().time_since_epoch() ).count();
+        hdr.start_sample  = info.first_sample;
+        hdr.start_unix_ns = wall_ns - ( StreamHostTimeNs() - info.host_time_ns ) - ( int64_t ) ( pts * ns_per_pt );
+        have_blocks = true;
+    } else if ( info.first_sample > next_stream_sample ) {
+        CaptureDropEntry drop;
+        drop.file_point   = file_pts;
+        drop.lost_samples = info.first_sample - next_stream_sample;
+        drops.push_back( drop );
+    } else if ( info.first_sample < next_stream_sample ) {
+        fprintf( stderr, "__warning__ CaptureIndexer: stream was restarted at point %llu, sample numbers of capture are not valid after it\n",
+                 ( unsigned long long ) file_pts );
+    }
+
+    while ( next_index_pt < file_pts + pts ) {
+        CaptureIndexEntry e;
+        e.stream_sample   = info.first_sample + ( next_index_pt - file_pts );
+        e.dropped_samples = info.dropped_samples;
+        e.host_time_ns    = info.host_time_ns - ( int64_t ) ( ( file_pts + pts - next_index_pt ) * ns_per_pt );
+        index.push_back( e );
+        next_index_pt += hdr.index_period_pts;
+    }
+    file_pts += pts;
+    next_stream_sample = info.first_sample + pts;
+}
+
+void CaptureIndexer::AddPackedBlock( const CaptureBlockEntry& blk ) {
+    blocks.push_back( blk );
+}
+
+const CaptureHeader& CaptureIndexer::Header() const {
+    return hdr;
+}
+
+uint64_t CaptureIndexer::Points() const {
+    return file_pts;
+}
+
+void CaptureIndexer::MakeHeaderBuf( std::vector< uint8_t >& buf ) const {
+    buf.assign( CAPTURE_HEADER_SIZE8, 0 );
+    memcpy( &buf[ 0 ], &hdr, sizeof( hdr ) );
+}
+
+bool CaptureIndexer::Finish( const std::string& fname ) {
+    FILE* f = fopen( fname.c_str(), "r+b" );
+    if ( !f ) {
+        fprintf( stderr, "__error__ CaptureIndexer::Finish() can't open '%s'\n", fname.c_str() );
+        return false;
+    }
+    capture_fseek( f, 0, SEEK_END );
+    uint64_t file_size8 = capture_ftell( f );
+    uint64_t payload8   = file_size8 > hdr.header_size8 ? file_size8 - hdr.header_size8 : 0;
+    uint64_t indexed8 = file_pts * hdr.bytes_per_point;
+    if ( hdr.compression ) {
+        indexed8 = 0;
+        for ( size_t i = 0; i < blocks.size(); i++ ) {
+            indexed8 += sizeof( CaptureBlockHeader ) + blocks[ i ].packed_size8;
+        }
+    }
+    if ( payload8 != indexed8 ) {
+        fprintf( stderr, "__warning__ CaptureIndexer::Finish() '%s' has %llu bytes of data, %llu are indexed\n",
+                 fname.c_str(), ( unsigned long long ) payload8, ( unsigned long long ) indexed8 );
+    }
+    hdr.payload_size8  = payload8;
+    hdr.index_offset8  = hdr.header_size8 + payload8;
+    hdr.index_count    = index.size();
+    hdr.drops_offset8  = hdr.index_offset8 + index.size() * sizeof( CaptureIndexEntry );
+    hdr.drops_count    = drops.size();
+    hdr.raw_size8      = file_pts * hdr.bytes_per_point;
+    hdr.blocks_offset8 = hdr.compression ? hdr.drops_offset8 + drops.size() * sizeof( CaptureDropEntry ) : 0;
+    hdr.blocks_count   = hdr.compression ? blocks.size() : 0;
+
+    bool ok = true;
+    if ( !index.empty() ) {
+        ok = ok && fwrite( &index[ 0 ], sizeof( CaptureIndexEntry ), index.size(), f ) == index.size();
+    }
+    if ( !drops.empty() ) {
+        ok = ok && fwrite( &drops[ 0 ], sizeof( CaptureDropEntry ), drops.size(), f ) == drops.size();
+    }
+    if ( hdr.blocks_count ) {
+        ok = ok && fwrite( &blocks[ 0 ], sizeof( CaptureBlockEntry ), blocks.size(), f ) == blocks.size();
+    }
+    std::vector< uint8_t > hbuf;
+    MakeHeaderBuf( hbuf );
+    capture_fseek( f, 0, SEEK_SET );
+    ok = ok && fwrite( &hbuf[ 0 ], 1, hbuf.size(), f ) == hbuf.size();
+    ok = ( fclose( f ) == 0 ) && ok;
+    if ( !ok ) {
+        fprintf( stderr, "__error__ CaptureIndexer::Finish() write to '%s' failed\n", fname.c_str() );
+    } else {
+        fprintf( stderr, "CaptureIndexer: '%s' %llu points, %llu index entries, %llu gaps\n", fname.c_str(),
+                 ( unsigned long long ) file_pts, ( unsigned long long ) index.size(), ( unsigned long long ) drops.size() );
+        if ( hdr.compression ) {
+            fprintf( stderr, "CaptureIndexer: '%s' %llu blocks, compression ratio %.2f\n", fname.c_str(),
+                     ( unsigned long long ) blocks.size(), payload8 ? ( double ) hdr.raw_size8 / payload8 : 0.0 );
+        }
+    }
+    return ok;
+}
+
+/* CaptureReader */
+
+CaptureReader::CaptureReader() :
+    file( NULL ),
+    points( 0 ),
+    cached_block( ( size_t ) -1 )
+{
+}
+
+CaptureReader::~CaptureReader() {
+    Close();
+}
+
+bool CaptureReader::IsCapture( const char* fname ) {
+    char magic[ 8 ];
+    FILE* f = fopen( fname, "rb" );
+    if ( !f ) {
+        return false;
+    }
+    bool res = fread( magic, 1, sizeof( magic ), f ) == sizeof( magic ) && memcmp( magic, CAPTURE_MAGIC, sizeof( magic ) ) == 0;
+    fclose( f );
+    return res;
+}
+
+bool CaptureReader::Open( const char* fname ) {
+    Close();
+    file = fopen( fname, "rb" );
+    if ( !file ) {
+        return false;
+    }
+    if ( fread( &hdr, sizeof( hdr ), 1, file ) != 1 ||
+         memcmp( hdr.magic, CAPTURE_MAGIC, sizeof( hdr.magic ) ) != 0 ) {
+        Close();
+        return false;
+    }
+    if ( hdr.version > CAPTURE_VERSION || hdr.bytes_per_point == 0 || hdr.header_size8 < sizeof( hdr ) ) {
+        fprintf( stderr, "__error__ CaptureReader::Open() '%s' has unsupported version %u\n", fname, hdr.version );
+        Close();
+        return false;
+    }
+    capture_fseek( file, 0, SEEK_END );
+    uint64_t file_size8 = capture_ftell( file );
+    if ( !hdr.index_offset8 ) {
+        hdr.payload_size8 = file_size8 > hdr.header_size8 ? file_size8 - hdr.header_size8 : 0;
+        fprintf( stderr, "__warning__ CaptureReader: '%s' was not finished, it has no index\n", fname );
+    }
+    points = hdr.payload_size8 / hdr.bytes_per_point;
+
+    index.resize( hdr.index_count );
+    drops.resize( hdr.drops_count );
+    bool ok = true;
+    if ( hdr.index_count ) {
+        ok = ok && capture_fseek( file, hdr.index_offset8, SEEK_SET ) == 0 &&
+             fread( &index[ 0 ], sizeof( CaptureIndexEntry ), index.size(), file ) == index.size();
+    }
+    if ( hdr.drops_count ) {
+        ok = ok && capture_fseek( file, hdr.drops_offset8, SEEK_SET ) == 0 &&
+             fread( &drops[ 0 ], sizeof( CaptureDropEntry ), drops.size(), file ) == drops.size();
+    }
+    if ( !ok ) {
+        fprintf( stderr, "__warning__ CaptureReader: index of '%s' is broken, it is not used\n", fname );
+        index.clear();
+        drops.clear();
+    }
+    lost_before.resize( drops.size() );
+    uint64_t lost = 0;
+    for ( size_t i = 0; i < drops.size(); i++ ) {
+        lost_before[ i ] = lost;
+        lost += drops[ i ].lost_samples;
+    }
+
+    if ( hdr.compression ) {
+        bool have_table = false;
+        if ( hdr.blocks_offset8 && hdr.blocks_count ) {
+            blocks.resize( hdr.blocks_count );
+            have_table = capture_fseek( file, hdr.blocks_offset8, SEEK_SET ) == 0 &&
+                    fread( &blocks[ 0 ], sizeof( CaptureBlockEntry ), blocks.size(), file ) == blocks.size();
+            if ( !have_table ) {
+                fprintf( stderr, "__warning__ CaptureReader: blocks table of '%s' is broken, blocks are searched\n", fname );
+            }
+        }
+        if ( !have_table ) {
+            scanBlocks( file_size8 );
+        }
+        points = blocks.empty() ? 0 : blocks.back().file_point + blocks.back().raw_size8 / hdr.bytes_per_point;
+    }
+    return true;
+}
+
+// Unfinished compressed capture, blocks follow each other after header
+bool CaptureReader::scanBlocks( uint64_t file_size8 ) {
+    blocks.clear();
+    uint64_t pos8 = hdr.header_size8;
+    uint64_t file_pt = 0;
+    while ( pos8 + sizeof( CaptureBlockHeader ) <= file_size8 ) {
+        CaptureBlockHeader bh;
+        if ( capture_fseek( file, pos8, SEEK_SET ) != 0 || fread( &bh, sizeof( bh ), 1, file ) != 1 ||
+             bh.magic != CAPTURE_BLOCK_MAGIC ||
+             pos8 + sizeof( bh ) + bh.packed_size8 > file_size8 ) {
+            break;
+        }
+        CaptureBlockEntry e;
+        e.file_point   = file_pt;
+        e.offset8      = pos8;
+        e.packed_size8 = bh.packed_size8;
+        e.raw_size8    = bh.raw_size8;
+        blocks.push_back( e );
+        file_pt += bh.raw_size8 / hdr.bytes_per_point;
+        pos8    += sizeof( bh ) + bh.packed_size8;
+    }
+    if ( pos8 != file_size8 ) {
+        fprintf( stderr, "__warning__ CaptureReader: data after block %llu are not readable\n",
+                 ( unsigned long long ) blocks.size() );
+    }
+    return !blocks.empty();
+}
+
+void CaptureReader::Close() {
+    if ( file ) {
+        fclose( file );
+        file = NULL;
+    }
+    points = 0;
+    index.clear();
+    drops.clear();
+    lost_before.clear();
+    blocks.clear();
+    block_cache.clear();
+    cached_block = ( size_t ) -1;
+}
+
+bool CaptureReader::IsOpen() const {
+    return file != NULL;
+}
+
+const CaptureHeader& CaptureReader::Header() const {
+    return hdr;
+}
+
+uint64_t CaptureReader::Points() const {
+    return points;
+}
+
+bool CaptureReader::IsCompressed() const {
+    return hdr.compression != CaptureCompression_None;
+}
+
+uint64_t CaptureReader::PayloadOffset8() const {
+    return hdr.header_size8;
+}
+
+uint64_t CaptureReader::PointOffset8( uint64_t file_pt ) const {
+    return hdr.header_size8 + file_pt * hdr.bytes_per_point;
+}
+
+static bool drop_point_less( uint64_t file_pt, const CaptureDropEntry& d ) {
+    return file_pt < d.file_point;
+}
+
+uint64_t CaptureReader::PointToStreamSample( uint64_t file_pt ) const {
+    // number of drops at or before file_pt
+    size_t n = std::upper_bound( drops.begin(), drops.end(), file_pt, drop_point_less ) - drops.begin();
+    uint64_t lost = n ? lost_before[ n - 1 ] + drops[ n - 1 ].lost_samples : 0;
+    return hdr.start_sample + file_pt + lost;
+}
+
+uint64_t CaptureReader::StreamSampleToPoint( uint64_t stream_sample ) const {
+    if ( stream_sample <= hdr.start_sample ) {
+        return 0;
+    }
+    uint64_t rel = stream_sample - hdr.start_sample;
+    // last drop whose first point has stream sample <= stream_sample
+    size_t lo = 0;
+    size_t hi = drops.size();
+    while ( lo < hi ) {
+        size_t mid = ( lo + hi ) / 2;
+        if ( drops[ mid ].file_point + lost_before[ mid ] + drops[ mid ].lost_samples <= rel ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    uint64_t lost = lo ? lost_before[ lo - 1 ] + drops[ lo - 1 ].lost_samples : 0;
+    uint64_t pt = rel - lost;
+    if ( lo < drops.size() && pt >= drops[ lo ].file_point ) {
+        pt = drops[ lo ].file_point;    // sample is in the gap
+    }
+    return pt < points ? pt : points;
+}
+
+uint64_t CaptureReader::TimeToPoint( double seconds ) const {
+    if ( seconds <= 0.0 ) {
+        return 0;
+    }
+    return StreamSampleToPoint( hdr.start_sample + ( uint64_t ) ( seconds * hdr.sample_rate_hz ) );
+}
+
+size_t CaptureReader::Read( uint64_t file_pt, void* dst, size_t pts ) {
+    if ( !file || file_pt >= points ) {
+        return 0;
+    }
+    if ( pts > points - file_pt ) {
+        pts = ( size_t ) ( points - file_pt );
+    }
+    if ( hdr.compression ) {
+        return readPacked( file_pt, ( uint8_t* ) dst, pts );
+    }
+    std::lock_guard< std::mutex > lck( mtx_file );
+    if ( capture_fseek( file, PointOffset8( file_pt ), SEEK_SET ) != 0 ) {
+        return 0;
+    }
+    return fread( dst, hdr.bytes_per_point, pts, file );
+}
+
+size_t CaptureReader::readPacked( uint64_t file_pt, uint8_t* dst, size_t pts ) {
+    size_t done = 0;
+    while ( done < pts ) {
+        size_t k = BlockOfPoint( file_pt );
+        if ( k >= blocks.size() ) {
+            break;
+        }
+        const CaptureBlockEntry& b = blocks[ k ];
+        if ( k != cached_block ) {
+            block_cache.resize( b.raw_size8 );
+            cached_block = ( size_t ) -1;
+            if ( !ReadBlock( k, block_cache.empty() ? NULL : &block_cache[ 0 ] ) ) {
+                fprintf( stderr, "__error__ CaptureReader: block %llu is broken\n", ( unsigned long long ) k );
+                break;
+            }
+            cached_block = k;
+        }
+        uint64_t block_pts = b.raw_size8 / hdr.bytes_per_point;
+        uint64_t in_block  = file_pt - b.file_point;
+        if ( in_block >= block_pts ) {
+            break;
+        }
+        size_t n = ( size_t ) std::min< uint64_t >( block_pts - in_block, pts - done );
+        memcpy( dst + done * hdr.bytes_per_point, &block_cache[ in_block * hdr.bytes_per_point ], n * hdr.bytes_per_point );
+        done    += n;
+        file_pt += n;
+    }
+    return done;
+}
+
+static bool block_point_less( uint64_t file_pt, const CaptureBlockEntry& b ) {
+    return file_pt < b.file_point;
+}
+
+const std::vector< CaptureBlockEntry >& CaptureReader::Blocks() const {
+    return blocks;
+}
+
+size_t CaptureReader::BlockOfPoint( uint64_t file_pt ) const {
+    size_t n = std::upper_bound( blocks.begin(), blocks.end(), file_pt, block_point_less ) - blocks.begin();
+    return n ? n - 1 : blocks.size();
+}
+
+bool CaptureReader::ReadBlock( size_t k, uint8_t* dst ) {
+    if ( k >= blocks.size() ) {
+        return false;
+    }
+    const CaptureBlockEntry& b = blocks[ k ];
+    std::vector< uint8_t > packed( b.packed_size8 );
+    bool ok;
+    {
+        std::lock_guard< std::mutex > lck( mtx_file );
+        ok = file && capture_fseek( file, b.offset8 + sizeof( CaptureBlockHeader ), SEEK_SET ) == 0 &&
+                fread( packed.empty() ? NULL : &packed[ 0 ], 1, packed.size(), file ) == packed.size();
+    }
+    return ok && block_decompress( packed.empty() ? NULL : &packed[ 0 ], packed.size(), dst, b.raw_size8 );
+}
+
+const std::vector< CaptureIndexEntry >& CaptureReader::Index() const {
+    return index;
+}
+
+const std::vector< CaptureDropEntry >& CaptureReader::Drops() const {
+    return drops;
+}
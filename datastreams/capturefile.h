@@ -0,0 +1,192 @@
+#ifndef CAPTUREFILE_H
+#define CAPTUREFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "datablock.h"
+#include "hwfx3/fx3config.h"
+
+/*
+ * ItsFx3 capture file (.itscap), little-endian:
+ *   header        CAPTURE_HEADER_SIZE8 bytes, CaptureHeader and zeros
+ *   payload       ADC data exactly as received from device (2-bit data stays packed)
+ *   index         CaptureIndexEntry for every index_period_pts points of payload
+ *   drops         CaptureDropEntry for every gap in recorded stream
+ *   blocks        CaptureBlockEntry for every block of compressed payload
+ * Index and drops are appended when recording is finished. File of interrupted recording
+ * has index_offset8 == 0, it is still readable, payload is the rest of file.
+ * Point is one sample of every channel (BYTES_PER_POINT of ADC format bytes).
+ *
+ * Compressed capture (version 2, compression != 0): payload is a sequence of
+ * CaptureBlockHeader and block packed by block_compress() (blockcodec.h). Blocks are
+ * independent, blocks table lets readers unpack any range and unpack blocks in parallel.
+ * Interrupted compressed recording has no table, reader finds blocks by their headers.
+ */
+
+#define CAPTURE_MAGIC        "ITSFX3CP"
+#define CAPTURE_VERSION      ( 2 )
+#define CAPTURE_HEADER_SIZE8 ( 4096 )   // payload stays aligned for O_DIRECT writers
+#define CAPTURE_FILE_EXT     ".itscap"
+
+struct CaptureHeader {
+    char     magic[ 8 ];
+    uint32_t version;
+    uint32_t header_size8;      // payload offset
+    uint32_t adc_type;          // ADCType
+    uint32_t chan_count;
+    uint32_t bytes_per_point;
+    uint32_t signal_type;       // SignalTypeIQR
+    double   sample_rate_hz;
+    double   inter_freq_hz;
+    int64_t  start_unix_ns;     // UTC time of the first sample, 0 if unknown
+    uint64_t start_sample;      // stream sample number (StreamBlockInfo::first_sample) of the first sample
+    uint64_t payload_size8;
+    uint64_t index_period_pts;
+    uint64_t index_offset8;     // 0 - index was not written
+    uint64_t index_count;
+    uint64_t drops_offset8;
+    uint64_t drops_count;
+    // version 2
+    uint32_t compression;       // CaptureCompression_t
+    uint32_t reserved;
+    uint64_t raw_size8;         // payload size after unpacking
+    uint64_t blocks_offset8;    // 0 - blocks table was not written
+    uint64_t blocks_count;
+
+    CaptureHeader();
+    void SetConfig( const FX3Config& cfg );
+};
+
+struct CaptureIndexEntry {
+    uint64_t stream_sample;     // stream sample number of point k * index_period_pts
+    uint64_t dropped_samples;   // samples lost since stream start up to this point
+    int64_t  host_time_ns;      // estimated StreamHostTimeNs() of this point
+};
+
+struct CaptureDropEntry {
+    uint64_t file_point;        // gap is just before this point of payload
+    uint64_t lost_samples;
+};
+
+enum CaptureCompression_t {
+    CaptureCompression_None  = 0,
+    CaptureCompression_Block = 1
+};
+
+#define CAPTURE_BLOCK_MAGIC ( 0x4B4C4243 )  // "CBLK"
+
+struct CaptureBlockHeader {
+    uint32_t magic;
+    uint32_t packed_size8;      // packed data after this header
+    uint32_t raw_size8;
+    uint32_t reserved;
+};
+
+struct CaptureBlockEntry {
+    uint64_t file_point;        // first point of block
+    uint64_t offset8;           // CaptureBlockHeader of block in file
+    uint32_t packed_size8;
+    uint32_t raw_size8;
+};
+
+/*
+ * Builds index of capture while it is recorded, Finish() writes it to the closed file.
+ * AddBlock() gets every block written to payload, gaps are found by sample numbers,
+ * so both router drops and data dropped by slow disk are marked.
+ */
+class CaptureIndexer {
+public:
+    static const uint64_t DEF_INDEX_PERIOD_PTS = 1024 * 1024;
+
+    CaptureIndexer();
+
+    void Start( const CaptureHeader& hdr, uint64_t index_period_pts = DEF_INDEX_PERIOD_PTS );
+    // written8 - size8 of block, 0 if writer dropped it
+    void AddBlock( const StreamBlockInfo& info, size_t written8 );
+    // Compressed capture: block which was completely written, its points were given to AddBlock
+    void AddPackedBlock( const CaptureBlockEntry& blk );
+    const CaptureHeader& Header() const;
+    uint64_t Points() const;
+
+    // Placeholder written first, so interrupted recording is readable
+    void MakeHeaderBuf( std::vector< uint8_t >& buf ) const;
+    // Appends index and drops to closed file and rewrites its header
+    bool Finish( const std::string& fname );
+
+private:
+    CaptureHeader hdr;
+    std::vector< CaptureIndexEntry > index;
+    std::vector< CaptureDropEntry > drops;
+    std::vector< CaptureBlockEntry > blocks;
+    uint64_t file_pts;
+    uint64_t next_stream_sample;
+    uint64_t next_index_pt;
+    bool have_blocks;
+};
+
+/*
+ * Reads capture file. Seek by point and by stream sample does not scan payload:
+ * point offset is computed, stream sample goes through the drops table.
+ */
+class CaptureReader {
+public:
+    CaptureReader();
+    ~CaptureReader();
+
+    // false if file can't be opened or is not a capture
+    bool Open( const char* fname );
+    void Close();
+    bool IsOpen() const;
+
+    static bool IsCapture( const char* fname );
+
+    const CaptureHeader& Header() const;
+    uint64_t Points() const;
+    bool IsCompressed() const;
+    // Raw captures only, data of compressed capture is read by Read() and ReadBlock()
+    uint64_t PayloadOffset8() const;
+    uint64_t PointOffset8( uint64_t file_pt ) const;
+
+    // Point which has this stream sample or the first point after it if it was lost
+    uint64_t StreamSampleToPoint( uint64_t stream_sample ) const;
+    uint64_t PointToStreamSample( uint64_t file_pt ) const;
+    // Seconds since the first sample, lost samples are counted
+    uint64_t TimeToPoint( double seconds ) const;
+
+    // Returns points read
+    size_t Read( uint64_t file_pt, void* dst, size_t pts );
+
+    const std::vector< CaptureIndexEntry >& Index() const;
+    const std::vector< CaptureDropEntry >& Drops() const;
+
+    // Compressed capture. ReadBlock() may be called from several threads at once,
+    // only file reading is serialized, dst has Blocks()[ k ].raw_size8 bytes.
+    const std::vector< CaptureBlockEntry >& Blocks() const;
+    size_t BlockOfPoint( uint64_t file_pt ) const;
+    bool ReadBlock( size_t k, uint8_t* dst );
+
+private:
+    CaptureReader( const CaptureReader& );
+    CaptureReader& operator=( const CaptureReader& );
+
+    bool scanBlocks( uint64_t file_size8 );
+    size_t readPacked( uint64_t file_pt, uint8_t* dst, size_t pts );
+
+    FILE* file;
+    std::mutex mtx_file;
+    CaptureHeader hdr;
+    uint64_t points;
+    std::vector< CaptureIndexEntry > index;
+    std::vector< CaptureDropEntry > drops;
+    std::vector< uint64_t > lost_before;   // lost samples before drops[ i ], cumulative
+    std::vector< CaptureBlockEntry > blocks;
+    std::vector< uint8_t > block_cache;     // unpacked block cached_block for Read()
+    size_t cached_block;
+};
+
+#endif // CAPTUREFILE_H
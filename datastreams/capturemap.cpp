@@ -0,0 +1,280 @@
+#include "capturemap.h"
+#include "streamdecoder.h"
+#include <cstdio>
+#include <cstring>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// 32-bit address space can't take the whole recording
+#define MAP_WINDOW_SIZE8 ( 256ULL * 1024 * 1024 )
+
+static uint64_t map_granularity8() {
+#ifdef WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo( &si );
+    return si.dwAllocationGranularity;
+#else
+    return ( uint64_t ) sysconf( _SC_PAGESIZE );
+#endif
+}
+
+CaptureMap::CaptureMap() :
+    points( 0 ),
+    file_size8( 0 ),
+    opened( false ),
+    decoder( NULL ),
+#ifdef WIN32
+    file( INVALID_HANDLE_VALUE ),
+    mapping( NULL ),
+#else
+    fd( -1 ),
+#endif
+    map_base( NULL ),
+    map_offset8( 0 ),
+    map_size8( 0 )
+{
+}
+
+CaptureMap::~CaptureMap() {
+    Close();
+}
+
+bool CaptureMap::Open( const char* fname ) {
+    Close();
+    if ( !reader.Open( fname ) ) {
+        return false;
+    }
+    hdr    = reader.Header();
+    points = reader.Points();
+    if ( !reader.IsCompressed() ) {
+        if ( !mapFile( fname ) ) {
+            Close();
+            return false;
+        }
+    }
+    decoder = StreamDecoder::Create( ( ADCType ) hdr.adc_type );
+    opened  = true;
+    return true;
+}
+
+bool CaptureMap::OpenRaw( const char* fname, uint32_t bytes_per_point, uint64_t data_offset8 ) {
+    Close();
+    if ( !bytes_per_point || !mapFile( fname ) ) {
+        Close();
+        return false;
+    }
+    hdr = CaptureHeader();
+    hdr.adc_type        = ADC_Types_Count;
+    hdr.chan_count      = 1;
+    hdr.bytes_per_point = bytes_per_point;
+    hdr.header_size8    = ( uint32_t ) data_offset8;
+    hdr.payload_size8   = file_size8 > data_offset8 ? file_size8 - data_offset8 : 0;
+    points = hdr.payload_size8 / bytes_per_point;
+    opened = true;
+    return true;
+}
+
+void CaptureMap::Close() {
+    unmapView();
+#ifdef WIN32
+    if ( mapping ) {
+        CloseHandle( ( HANDLE ) mapping );
+        mapping = NULL;
+    }
+    if ( file != INVALID_HANDLE_VALUE ) {
+        CloseHandle( ( HANDLE ) file );
+        file = INVALID_HANDLE_VALUE;
+    }
+#else
+    if ( fd >= 0 ) {
+        close( fd );
+        fd = -1;
+    }
+#endif
+    reader.Close();
+    delete decoder;
+    decoder    = NULL;
+    points     = 0;
+    file_size8 = 0;
+    opened     = false;
+}
+
+bool CaptureMap::IsOpen() const {
+    return opened;
+}
+
+const CaptureHeader& CaptureMap::Header() const {
+    return hdr;
+}
+
+uint64_t CaptureMap::Points() const {
+    return points;
+}
+
+const CaptureReader& CaptureMap::Reader() const {
+    return reader;
+}
+
+const uint8_t* CaptureMap::Raw( uint64_t first_pt, size_t pts ) {
+    if ( !opened || !pts || first_pt >= points || pts > points - first_pt ) {
+        return NULL;
+    }
+    size_t size8 = pts * hdr.bytes_per_point;
+    if ( hdr.compression ) {
+        if ( unpacked.size() < size8 ) {
+            unpacked.resize( size8 );
+        }
+        if ( reader.Read( first_pt, &unpacked[ 0 ], pts ) != pts ) {
+            return NULL;
+        }
+        return &unpacked[ 0 ];
+    }
+    return view( hdr.header_size8 + first_pt * hdr.bytes_per_point, size8 );
+}
+
+const int16_t* CaptureMap::Channel16( uint64_t first_pt, size_t pts, int channel ) {
+    const uint8_t* raw = Raw( first_pt, pts );
+    if ( !raw ) {
+        return NULL;
+    }
+    if ( !decoder ) {
+        // headerless dump is one channel
+        return ( channel == 0 && hdr.bytes_per_point == sizeof( int16_t ) ) ? ( const int16_t* ) raw : NULL;
+    }
+    if ( channel < 0 || channel >= ( int ) decoder->ChansCount() ) {
+        return NULL;
+    }
+    const StreamPlanes& planes = decoder->Decode( raw, pts * hdr.bytes_per_point, 1u << channel, 0, 0 );
+    return planes.i16[ channel ];
+}
+
+void CaptureMap::WillNeed( uint64_t first_pt, size_t pts ) {
+#ifndef WIN32
+    if ( !map_base || first_pt >= points ) {
+        return;
+    }
+    if ( pts > points - first_pt ) {
+        pts = ( size_t ) ( points - first_pt );
+    }
+    uint64_t begin8 = hdr.header_size8 + first_pt * hdr.bytes_per_point;
+    uint64_t end8   = begin8 + ( uint64_t ) pts * hdr.bytes_per_point;
+    if ( begin8 < map_offset8 ) {
+        begin8 = map_offset8;
+    }
+    if ( end8 > map_offset8 + map_size8 ) {
+        end8 = map_offset8 + map_size8;
+    }
+    if ( begin8 >= end8 ) {
+        return;
+    }
+    uint64_t page8 = map_granularity8();
+    uint64_t rel8  = ( begin8 - map_offset8 ) & ~( page8 - 1 );
+    madvise( map_base + rel8, ( size_t ) ( end8 - map_offset8 - rel8 ), MADV_WILLNEED );
+#else
+    ( void ) first_pt;
+    ( void ) pts;
+#endif
+}
+
+bool CaptureMap::mapFile( const char* fname ) {
+#ifdef WIN32
+    HANDLE h = CreateFileA( fname, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+    if ( h == INVALID_HANDLE_VALUE ) {
+        fprintf( stderr, "__error__ CaptureMap: can't open '%s'\n", fname );
+        return false;
+    }
+    file = h;
+    LARGE_INTEGER sz;
+    if ( !GetFileSizeEx( h, &sz ) ) {
+        return false;
+    }
+    file_size8 = ( uint64_t ) sz.QuadPart;
+    if ( file_size8 ) {
+        mapping = CreateFileMappingA( h, NULL, PAGE_READONLY, 0, 0, NULL );
+        if ( !mapping ) {
+            fprintf( stderr, "__error__ CaptureMap: can't map '%s'\n", fname );
+            return false;
+        }
+    }
+#else
+    fd = open( fname, O_RDONLY );
+    if ( fd < 0 ) {
+        fprintf( stderr, "__error__ CaptureMap: can't open '%s'\n", fname );
+        return false;
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 ) {
+        return false;
+    }
+    file_size8 = ( uint64_t ) st.st_size;
+#endif
+    return true;
+}
+
+// Window is moved only when range is out of it, so sequential views of 32-bit build
+// remap once per MAP_WINDOW_SIZE8
+const uint8_t* CaptureMap::view( uint64_t offset8, size_t size8 ) {
+    if ( offset8 + size8 > file_size8 ) {
+        return NULL;
+    }
+    if ( map_base && offset8 >= map_offset8 && offset8 + size8 <= map_offset8 + map_size8 ) {
+        return map_base + ( offset8 - map_offset8 );
+    }
+    unmapView();
+
+    uint64_t start8 = 0;
+    uint64_t len8   = file_size8;
+    if ( sizeof( void* ) < 8 ) {
+        start8 = offset8 & ~( map_granularity8() - 1 );
+        len8   = offset8 + size8 - start8;
+        if ( len8 < MAP_WINDOW_SIZE8 ) {
+            len8 = MAP_WINDOW_SIZE8;
+        }
+        if ( len8 > file_size8 - start8 ) {
+            len8 = file_size8 - start8;
+        }
+    }
+
+#ifdef WIN32
+    void* p = MapViewOfFile( ( HANDLE ) mapping, FILE_MAP_READ, ( DWORD ) ( start8 >> 32 ),
+                             ( DWORD ) ( start8 & 0xFFFFFFFF ), ( SIZE_T ) len8 );
+    if ( !p ) {
+        fprintf( stderr, "__error__ CaptureMap: MapViewOfFile() failed %lu\n", GetLastError() );
+        return NULL;
+    }
+#else
+    void* p = mmap( NULL, ( size_t ) len8, PROT_READ, MAP_SHARED, fd, ( off_t ) start8 );
+    if ( p == MAP_FAILED ) {
+        fprintf( stderr, "__error__ CaptureMap: mmap() failed\n" );
+        return NULL;
+    }
+    // signals are mostly taken from the beginning to the end
+    madvise( p, ( size_t ) len8, MADV_SEQUENTIAL );
+#endif
+    map_base    = ( uint8_t* ) p;
+    map_offset8 = start8;
+    map_size8   = len8;
+    return map_base + ( offset8 - map_offset8 );
+}
+
+void CaptureMap::unmapView() {
+    if ( !map_base ) {
+        return;
+    }
+#ifdef WIN32
+    UnmapViewOfFile( map_base );
+#else
+    munmap( map_base, ( size_t ) map_size8 );
+#endif
+    map_base    = NULL;
+    map_offset8 = 0;
+    map_size8   = 0;
+}
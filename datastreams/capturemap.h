@@ -0,0 +1,71 @@
+#ifndef CAPTUREMAP_H
+#define CAPTUREMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "capturefile.h"
+
+class StreamDecoder;
+
+/*
+ * Memory-mapped capture for offline processing. Views by point range are pointers into
+ * the mapping when data is stored as is, packed data is decoded on demand:
+ *   Raw()        points as they are in the file (compressed capture is unpacked)
+ *   Channel16()  one channel as int16, zero-copy for 16-bit single channel ADC
+ * View is valid until the next call. On 32-bit builds only a window of file is mapped
+ * and moved by the views, so long recordings don't need the address space.
+ * OpenRaw() maps headerless dump (old recordings), header describes it then.
+ */
+class CaptureMap {
+public:
+    CaptureMap();
+    ~CaptureMap();
+
+    bool Open( const char* fname );
+    bool OpenRaw( const char* fname, uint32_t bytes_per_point, uint64_t data_offset8 = 0 );
+    void Close();
+    bool IsOpen() const;
+
+    const CaptureHeader& Header() const;
+    uint64_t Points() const;
+    // Index, drops and time of capture, not open for headerless dump
+    const CaptureReader& Reader() const;
+
+    // NULL if range is not in the file
+    const uint8_t* Raw( uint64_t first_pt, size_t pts );
+    const int16_t* Channel16( uint64_t first_pt, size_t pts, int channel );
+
+    // Hint that range is read soon, batch jobs call it for the next signal
+    void WillNeed( uint64_t first_pt, size_t pts );
+
+private:
+    CaptureMap( const CaptureMap& );
+    CaptureMap& operator=( const CaptureMap& );
+
+    bool mapFile( const char* fname );
+    const uint8_t* view( uint64_t offset8, size_t size8 );
+    void unmapView();
+
+    CaptureHeader hdr;
+    uint64_t points;
+    uint64_t file_size8;
+    bool opened;
+
+    CaptureReader reader;               // compressed capture is unpacked by reader
+    std::vector< uint8_t > unpacked;
+    StreamDecoder* decoder;
+
+#ifdef WIN32
+    void* file;
+    void* mapping;
+#else
+    int fd;
+#endif
+    uint8_t* map_base;
+    uint64_t map_offset8;
+    uint64_t map_size8;
+};
+
+#endif // CAPTUREMAP_H
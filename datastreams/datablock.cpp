@@ -0,0 +1,106 @@
+#include "datablock.h"
+#include <cstdio>
+
+DataBlock::DataBlock() :
+    data( NULL ),
+    size8( 0 ),
+    capacity8( 0 ),
+    planes( NULL ),
+    refs( 0 ),
+    pool( NULL )
+{
+
+}
+
+void DataBlock::AddRef() {
+    refs.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void DataBlock::Release() {
+    if ( refs.fetch_sub( 1, std::memory_order_acq_rel ) == 1 ) {
+        pool->onBlockFree();
+    }
+}
+
+bool DataBlock::IsUnique() const {
+    return refs.load( std::memory_order_acquire ) == 1;
+}
+
+
+DataBlockPool* DataBlockPool::Create(size_t block_size8, uint32_t blocks_count) {
+    return new DataBlockPool( block_size8, blocks_count );
+}
+
+DataBlockPool::DataBlockPool(size_t block_size8, uint32_t blocks_count) :
+    block_size8( block_size8 ),
+    blocks_count( blocks_count ),
+    next_idx( 0 ),
+    blocks( NULL ),
+    raw_mem( NULL ),
+    refs( 1 )
+{
+    size_t stride8 = ( ( block_size8 + DATA_BLOCK_ALIGN - 1 ) / DATA_BLOCK_ALIGN ) * DATA_BLOCK_ALIGN;
+    raw_mem = new uint8_t[ stride8 * blocks_count + DATA_BLOCK_ALIGN ];
+    uint8_t* base = raw_mem + ( DATA_BLOCK_ALIGN - ( ( uintptr_t ) raw_mem ) % DATA_BLOCK_ALIGN ) % DATA_BLOCK_ALIGN;
+
+    blocks = new DataBlock[ blocks_count ];
+    for ( uint32_t i = 0; i < blocks_count; i++ ) {
+        blocks[ i ].data      = base + i * stride8;
+        blocks[ i ].capacity8 = block_size8;
+        blocks[ i ].pool      = this;
+    }
+}
+
+DataBlockPool::~DataBlockPool() {
+    delete [] blocks;
+    delete [] raw_mem;
+}
+
+void DataBlockPool::Dispose() {
+    unref();
+}
+
+DataBlock* DataBlockPool::Acquire() {
+    for ( uint32_t i = 0; i < blocks_count; i++ ) {
+        uint32_t idx = ( next_idx + i ) % blocks_count;
+        DataBlock* b = &blocks[ idx ];
+        if ( b->refs.load( std::memory_order_acquire ) == 0 ) {
+            next_idx = ( idx + 1 ) % blocks_count;
+            refs.fetch_add( 1, std::memory_order_relaxed );
+            b->size8 = 0;
+            b->info  = StreamBlockInfo();
+            b->planes = NULL;
+            b->refs.store( 1, std::memory_order_relaxed );
+            return b;
+        }
+    }
+    return NULL;
+}
+
+size_t DataBlockPool::BlockSize() const {
+    return block_size8;
+}
+
+uint32_t DataBlockPool::BlocksCount() const {
+    return blocks_count;
+}
+
+uint32_t DataBlockPool::FreeCount() const {
+    uint32_t cnt = 0;
+    for ( uint32_t i = 0; i < blocks_count; i++ ) {
+        if ( blocks[ i ].refs.load( std::memory_order_relaxed ) == 0 ) {
+            cnt++;
+        }
+    }
+    return cnt;
+}
+
+void DataBlockPool::onBlockFree() {
+    unref();
+}
+
+void DataBlockPool::unref() {
+    if ( refs.fetch_sub( 1, std::memory_order_acq_rel ) == 1 ) {
+        delete this;
+    }
+}
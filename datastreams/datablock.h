@@ -0,0 +1,99 @@
+#ifndef DATABLOCK_H
+#define DATABLOCK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+
+#define DATA_BLOCK_ALIGN ( 64 )
+
+/*
+ * Position and timing of one block in the stream.
+ * Device fills stream_offset8 and host_time_ns, router fills the rest.
+ */
+struct StreamBlockInfo {
+    uint64_t seq;              // number of block at router input, gap means block was dropped in router queues
+    uint64_t stream_offset8;   // position of block in device stream (bytes), data lost by device is counted
+    uint64_t first_sample;     // index of the first sample (per channel) since stream start
+    uint64_t dropped_samples;  // samples lost since stream start up to this block
+    int64_t  host_time_ns;     // StreamHostTimeNs() when block was received from device
+
+    StreamBlockInfo() :
+        seq( 0 ), stream_offset8( 0 ), first_sample( 0 ), dropped_samples( 0 ), host_time_ns( 0 ) {}
+};
+
+// Monotonic host clock used for block timestamps
+inline int64_t StreamHostTimeNs() {
+    return std::chrono::duration_cast< std::chrono::nanoseconds >(
+                std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+class DataBlockPool;
+struct StreamPlanes;
+
+/*
+ * Chunk of stream data with fixed capacity.
+ * Blocks live inside DataBlockPool and are reference counted:
+ * when the last reference is released the block goes back to its pool.
+ */
+class DataBlock {
+public:
+    uint8_t* data;
+    size_t   size8;     // valid bytes in data
+    size_t   capacity8; // allocated bytes (size of one pool slot)
+    StreamBlockInfo info;
+    const StreamPlanes* planes; // decoded by router for all handlers, NULL if nobody wanted samples
+
+    void AddRef();
+    void Release();
+    // Caller's reference is the only one
+    bool IsUnique() const;
+
+private:
+    friend class DataBlockPool;
+    DataBlock();
+    DataBlock( const DataBlock& );
+    DataBlock& operator=( const DataBlock& );
+
+    std::atomic<int> refs;
+    DataBlockPool* pool;
+};
+
+/*
+ * Preallocated set of equal blocks.
+ * Memory for all blocks is allocated once in Create(), every block starts on DATA_BLOCK_ALIGN boundary.
+ * Acquire() must be called from one thread only (the producer), Release() of blocks can be called from any thread.
+ * Owner calls Dispose() instead of delete, pool memory is freed when the last block is returned.
+ */
+class DataBlockPool {
+public:
+    static DataBlockPool* Create( size_t block_size8, uint32_t blocks_count );
+    void Dispose();
+
+    // Returns block with one reference or NULL if all blocks are in use
+    DataBlock* Acquire();
+
+    size_t   BlockSize() const;
+    uint32_t BlocksCount() const;
+    uint32_t FreeCount() const;
+
+private:
+    DataBlockPool( size_t block_size8, uint32_t blocks_count );
+    ~DataBlockPool();
+    DataBlockPool( const DataBlockPool& );
+    DataBlockPool& operator=( const DataBlockPool& );
+
+    friend class DataBlock;
+    void onBlockFree();
+    void unref();
+
+    size_t      block_size8;
+    uint32_t    blocks_count;
+    uint32_t    next_idx;
+    DataBlock*  blocks;
+    uint8_t*    raw_mem;
+    std::atomic<int> refs; // owner + blocks in use
+};
+
+#endif // DATABLOCK_H
@@ -2,13 +2,64 @@
 #define STREAMDATAHANDLER_H
 
 #include <cstddef>
+#include <cstdint>
 #include <vector>
 
+#include "datablock.h"
+
+// Sample formats of decoded channels (bit mask)
+enum StreamDataFormat_t {
+    SDF_Int16 = 0x01,   // HandleStreamDataOneChan
+    SDF_Int8  = 0x02,   // HandleStreamDataOneChanInt8
+    SDF_Float = 0x04    // HandleStreamDataOneChanFloat
+};
+
+#define SDF_ALL_CHANS ( 0xFFFFFFFF )
+
+// How router delivers blocks to handler which is slower than the stream
+enum StreamDelivery_t {
+    StreamDelivery_Lossless,    // router waits for handler (recording)
+    StreamDelivery_LatestOnly   // handler gets the newest block, others are skipped (visualization)
+};
+
+/*
+ * What handler wants to receive from the router.
+ * Router asks all handlers before each block and decodes the union of requested channels and
+ * formats once, so handler which returns empty subscription costs nothing.
+ */
+struct StreamSubscription {
+    bool     raw;        // HandleADCStreamData with undecoded ADC data
+    bool     all_chans;  // HandleAllChansData with int16 samples of all channels
+    uint32_t chan_mask;  // bit per channel for one channel callbacks
+    uint32_t formats;    // StreamDataFormat_t mask for one channel callbacks
+
+    StreamSubscription( bool raw = false, bool all_chans = false, uint32_t chan_mask = 0, uint32_t formats = SDF_Int16 ) :
+        raw( raw ), all_chans( all_chans ), chan_mask( chan_mask ), formats( formats ) {}
+
+    bool Empty() const { return !raw && !all_chans && !( chan_mask && formats ); }
+};
+
 class StreamDataHandler {
 public:
+    // Called before data callbacks of every block which is delivered to handler
+    virtual void HandleBlockInfo( const StreamBlockInfo& info ) {}
+
     virtual void HandleADCStreamData( void* data, size_t size8 ) {}
     virtual void HandleStreamDataOneChan( short* one_ch_data, size_t pts_cnt, int channel ) {}
+    virtual void HandleStreamDataOneChanInt8( int8_t* one_ch_data, size_t pts_cnt, int channel ) {}
+    virtual void HandleStreamDataOneChanFloat( float* one_ch_data, size_t pts_cnt, int channel ) {}
     virtual void HandleAllChansData( std::vector<short*>& all_ch_data, size_t pts_cnt ) {}
+
+    // Called by AddOutPoint and by handler's worker thread before every block, router
+    // decodes by the last returned value. Default is everything in int16.
+    virtual StreamSubscription GetSubscription() {
+        return StreamSubscription( true, true, SDF_ALL_CHANS, SDF_Int16 );
+    }
+
+    // Asked once when handler is added to the router
+    virtual StreamDelivery_t GetDelivery() {
+        return StreamDelivery_Lossless;
+    }
 };
 
 #endif // STREAMDATAHANDLER_H
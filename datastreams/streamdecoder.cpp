@@ -0,0 +1,58 @@
+#include "streamdecoder.h"
+
+struct StreamDecoderFactory {
+    StreamDecoder* decoder;
+
+    StreamDecoderFactory() : decoder( NULL ) {}
+
+    template < class Format >
+    void Visit() {
+        decoder = new StreamDecoderT< Format >();
+    }
+};
+
+StreamDecoder* StreamDecoder::Create( ADCType type ) {
+    StreamDecoderFactory factory;
+    adc_format_visit( type, factory );
+    return factory.decoder;
+}
+
+StreamDecoderPool::StreamDecoderPool( ADCType type ) :
+    type( type ),
+    chans( 0 )
+{
+    StreamDecoder* first = StreamDecoder::Create( type );
+    if ( first ) {
+        chans = first->ChansCount();
+        all.push_back( first );
+        free_list.push_back( first );
+    }
+}
+
+StreamDecoderPool::~StreamDecoderPool() {
+    for ( size_t i = 0; i < all.size(); i++ ) {
+        delete all[ i ];
+    }
+}
+
+StreamDecoder* StreamDecoderPool::Acquire() {
+    if ( !chans ) {
+        return NULL;
+    }
+    if ( free_list.empty() ) {
+        StreamDecoder* decoder = StreamDecoder::Create( type );
+        all.push_back( decoder );
+        return decoder;
+    }
+    StreamDecoder* decoder = free_list.back();
+    free_list.pop_back();
+    return decoder;
+}
+
+void StreamDecoderPool::Release( StreamDecoder* decoder ) {
+    free_list.push_back( decoder );
+}
+
+uint32_t StreamDecoderPool::ChansCount() const {
+    return chans;
+}
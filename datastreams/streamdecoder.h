@@ -0,0 +1,168 @@
+#ifndef STREAMDECODER_H
+#define STREAMDECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "adcformat.h"
+
+// Decoded channels of one block. Not requested channels are NULL.
+struct StreamPlanes {
+    int16_t* i16[ STREAM_MAX_CHANS ];
+    int8_t*  i8[ STREAM_MAX_CHANS ];
+    float*   f32[ STREAM_MAX_CHANS ];
+    size_t   pts;   // points per channel
+};
+
+/*
+ * Converts blocks of one ADC format into channel planes.
+ * Made once by Create() for the configured ADC type, so the per-block path has no format checks.
+ * Planes belong to decoder and are valid until the next Decode().
+ */
+class StreamDecoder {
+public:
+    virtual ~StreamDecoder() {}
+
+    // Returns NULL for unknown ADC type
+    static StreamDecoder* Create( ADCType type );
+
+    virtual uint32_t ChansCount() const = 0;
+    virtual uint32_t BytesPerPoint() const = 0;
+
+    // need16, need8, needf: bit per channel which is wanted in this format
+    virtual const StreamPlanes& Decode( const void* data, size_t size8, uint32_t need16, uint32_t need8, uint32_t needf ) = 0;
+};
+
+/*
+ * Decoders of blocks in flight. Router decodes every block once into a free decoder and
+ * gives it back when all workers are done with the block. Router thread only.
+ */
+class StreamDecoderPool {
+public:
+    explicit StreamDecoderPool( ADCType type );
+    ~StreamDecoderPool();
+
+    // NULL for unknown ADC type, pool grows when all decoders are in use
+    StreamDecoder* Acquire();
+    void Release( StreamDecoder* decoder );
+    uint32_t ChansCount() const;
+
+private:
+    StreamDecoderPool( const StreamDecoderPool& );
+    StreamDecoderPool& operator=( const StreamDecoderPool& );
+
+    ADCType type;
+    uint32_t chans;
+    std::vector< StreamDecoder* > all;
+    std::vector< StreamDecoder* > free_list;
+};
+
+template < class Format >
+class StreamDecoderT : public StreamDecoder {
+public:
+    StreamDecoderT();
+    ~StreamDecoderT();
+
+    uint32_t ChansCount() const { return Format::CHANS; }
+    uint32_t BytesPerPoint() const { return Format::BYTES_PER_POINT; }
+    const StreamPlanes& Decode( const void* data, size_t size8, uint32_t need16, uint32_t need8, uint32_t needf );
+
+private:
+    template < typename T >
+    static void reserve( T* planes[], size_t& planes_pts, size_t pts );
+
+    static const uint32_t CHANS_MASK = ( 1u << Format::CHANS ) - 1;
+
+    int16_t* buf16[ STREAM_MAX_CHANS ];
+    int8_t*  buf8[ STREAM_MAX_CHANS ];
+    float*   buff[ STREAM_MAX_CHANS ];
+    size_t buf16_pts;
+    size_t buf8_pts;
+    size_t buff_pts;
+
+    StreamPlanes out;
+};
+
+template < class Format >
+StreamDecoderT< Format >::StreamDecoderT() :
+    buf16_pts( 0 ),
+    buf8_pts( 0 ),
+    buff_pts( 0 )
+{
+    for ( int ch = 0; ch < STREAM_MAX_CHANS; ch++ ) {
+        buf16[ ch ] = NULL;
+        buf8[ ch ]  = NULL;
+        buff[ ch ]  = NULL;
+    }
+}
+
+template < class Format >
+StreamDecoderT< Format >::~StreamDecoderT() {
+    for ( int ch = 0; ch < STREAM_MAX_CHANS; ch++ ) {
+        delete [] buf16[ ch ];
+        delete [] buf8[ ch ];
+        delete [] buff[ ch ];
+    }
+}
+
+template < class Format >
+template < typename T >
+void StreamDecoderT< Format >::reserve( T* planes[], size_t& planes_pts, size_t pts ) {
+    if ( pts <= planes_pts ) {
+        return;
+    }
+    for ( uint32_t ch = 0; ch < Format::CHANS; ch++ ) {
+        delete [] planes[ ch ];
+        planes[ ch ] = new T[ pts ];
+    }
+    planes_pts = pts;
+}
+
+template < class Format >
+const StreamPlanes& StreamDecoderT< Format >::Decode( const void* data, size_t size8, uint32_t need16, uint32_t need8, uint32_t needf ) {
+    need16 &= CHANS_MASK;
+    need8  &= CHANS_MASK;
+    needf  &= CHANS_MASK;
+    if ( Format::NARROW_FROM_INT16 ) {
+        need16 |= need8 | needf;
+    }
+
+    size_t pts = size8 / Format::BYTES_PER_POINT;
+    out.pts = pts;
+    for ( int ch = 0; ch < STREAM_MAX_CHANS; ch++ ) {
+        out.i16[ ch ] = NULL;
+        out.i8[ ch ]  = NULL;
+        out.f32[ ch ] = NULL;
+    }
+
+    if ( need16 ) {
+        if ( !Format::ZERO_COPY16 ) {
+            reserve( buf16, buf16_pts, pts );
+        }
+        for ( uint32_t ch = 0; ch < Format::CHANS; ch++ ) {
+            if ( need16 & ( 1 << ch ) ) {
+                // zero-copy trait points plane into data itself
+                out.i16[ ch ] = Format::ZERO_COPY16 ? ( int16_t* ) data : buf16[ ch ];
+            }
+        }
+        Format::Decode16( data, pts, out.i16 );
+    }
+    if ( need8 ) {
+        reserve( buf8, buf8_pts, pts );
+        for ( uint32_t ch = 0; ch < Format::CHANS; ch++ ) {
+            out.i8[ ch ] = ( need8 & ( 1 << ch ) ) ? buf8[ ch ] : NULL;
+        }
+        Format::Decode8( data, out.i16, pts, out.i8 );
+    }
+    if ( needf ) {
+        reserve( buff, buff_pts, pts );
+        for ( uint32_t ch = 0; ch < Format::CHANS; ch++ ) {
+            out.f32[ ch ] = ( needf & ( 1 << ch ) ) ? buff[ ch ] : NULL;
+        }
+        Format::DecodeF( data, out.i16, pts, out.f32 );
+    }
+    return out;
+}
+
+#endif // STREAMDECODER_H
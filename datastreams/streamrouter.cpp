@@ -1,201 +1,356 @@
 #include "streamrouter.h"
 #include "string.h"
-#include "util/Chan2bitParser.h"
+#include <algorithm>
+#include <chrono>
+#include "util/ThreadConfig.h"
 
-StreamRouter::StreamRouter( ADCType type ) :
+StreamRouter::StreamRouter( ADCType type, uint32_t queue_depth, size_t block_size8, OverrunPolicy_t policy, uint32_t worker_depth ) :
+    route_list( new WorkerList() ),
+    have_removed( false ),
+    decoders( type ),
+    tc( "convert" ),
+    pools_count( 0 ),
+    pool_blocks( 0 ),
+    block_size8( block_size8 ),
+    queue_depth( queue_depth ),
+    ring( queue_depth, policy ),
+    pool_empty_blocks( 0 ),
+    pool_empty_bytes( 0 ),
     loop_running( true ),
-    queue_size8( 0 ),
+    in_seq( 0 ),
+    in_offset8( 0 ),
+    expected_offset8( 0 ),
+    dropped8( 0 ),
+    reported_drop_blocks( 0 ),
+    reported_drop_bytes( 0 ),
     adc_type( type ),
-    hack_len( 0 ),
-    tc("convert")
+    worker_depth( worker_depth ),
+    hack_len( 0 )
 {
+    if ( !decoders.ChansCount() ) {
+        fprintf( stderr, "__error__ StreamRouter() UNKNOWN adc type %d, only raw data is delivered\n", ( int ) type );
+    }
+    for ( int i = 0; i < MAX_POOLS; i++ ) {
+        pools[ i ] = NULL;
+    }
+    growPool();
+    decoded.reserve( 64 );
+    tc.SetPrintPeriod( 200 );
+    fprintf( stderr, "StreamRouter: 2-bit decoder uses %s\n", chan2bit_isa_name( chan2bit_isa() ) );
+    fprintf( stderr, "StreamRouter: queue %u x %.1f MBytes, %s on overrun, %u blocks per lossless handler\n",
+             queue_depth, block_size8 / ( 1024.0 * 1024.0 ),
+             policy == Overrun_DropOldest ? "drop oldest" : "drop newest", worker_depth );
     data_handler_thread = std::thread(&StreamRouter::DataHandleLoop, this);
-    tc.SetPrintPeriod(200);
 }
 
 StreamRouter::~StreamRouter() {
+    mtx_hnd.lock();
+    std::map< StreamDataHandler*, WorkerPtr > all( workers );
+    workers.clear();
+    publishRouteList();
+    mtx_hnd.unlock();
+
+    // Router thread may wait for place in a lossless worker's queue
+    for ( std::map< StreamDataHandler*, WorkerPtr >::iterator it = all.begin(); it != all.end(); it++ ) {
+        it->second->Stop();
+    }
     loop_running = false;
-    HandleADCStreamData( NULL, 0 );
+    ring.Wakeup();
     if ( data_handler_thread.joinable() ) {
         data_handler_thread.join();
     }
+    all.clear();
+    retired.clear();
+    releaseRemoved();
+    releaseDecoded( true );
+    delete route_list.load();
+    ring.Flush();
+    for ( int i = 0; i < pools_count; i++ ) {
+        pools[ i ].load()->Dispose();
+    }
 }
 
 void StreamRouter::AddOutPoint(StreamDataHandler* handler) {
     mtx_hnd.lock();
-    handlers.insert( handler );
+    if ( workers.find( handler ) == workers.end() ) {
+        workers[ handler ] = WorkerPtr( new StreamWorker( handler, decoders.ChansCount(), worker_depth ) );
+        growPool();
+        publishRouteList();
+    }
     mtx_hnd.unlock();
 }
 
 void StreamRouter::DeleteOutPoint(StreamDataHandler* handler) {
+    WorkerPtr worker;
     mtx_hnd.lock();
-    int erased_count = handlers.erase( handler );
-    if ( erased_count == 0 ) {
+    std::map< StreamDataHandler*, WorkerPtr >::iterator it = workers.find( handler );
+    if ( it != workers.end() ) {
+        worker = it->second;
+        workers.erase( it );
+        publishRouteList();
+        worker->Stop();
+        if ( worker->IsWorkerThread() ) {
+            // Handler removes itself from its callback, thread will be joined later
+            retired.push_back( worker );
+            have_removed = true;
+            worker.reset();
+        }
+    } else {
         fprintf( stderr, "__warning__ DeleteOutPoint(%p) not found\n", handler );
     }
     mtx_hnd.unlock();
+
+    if ( worker ) {
+        worker->Join();
+        if ( worker->SkippedBlocks() ) {
+            fprintf( stderr, "StreamRouter: handler %p skipped %llu blocks\n",
+                     handler, ( unsigned long long ) worker->SkippedBlocks() );
+        }
+    }
 }
 
-void StreamRouter::HandleADCStreamData(void* data, size_t size8) {
-    uint8_t* buf = NULL;
-    StreamData elem;
-    if ( data ) {
-        buf = new uint8_t[ size8 ];
-        memcpy( buf, data, size8 );
-        elem.data = buf;
-        elem.size8 = size8;
+// Pools are not shrunk when handlers are deleted
+void StreamRouter::growPool() {
+    // router queue, block in router's hands and block being filled by producer
+    uint32_t need = queue_depth + 2;
+    for ( std::map< StreamDataHandler*, WorkerPtr >::iterator it = workers.begin(); it != workers.end(); it++ ) {
+        need += it->second->Delivery() == StreamDelivery_Lossless ? worker_depth + 1 : 2;
     }
-    
-    // there are some c++11 magic
-    {
-        std::lock_guard<std::mutex> lck( mtx_q );
-        dqueue.push( elem );
-        queue_size8 += size8;
+    if ( need <= pool_blocks ) {
+        return;
     }
-    cond_var.notify_one();
+    if ( pools_count == MAX_POOLS ) {
+        fprintf( stderr, "__warning__ StreamRouter: %u blocks are needed, pool has %u\n", need, pool_blocks );
+        return;
+    }
+    pools[ pools_count++ ].store( DataBlockPool::Create( block_size8, need - pool_blocks ), std::memory_order_release );
+    pool_blocks = need;
 }
 
-void StreamRouter::HandleStreamDataOneChan(short*, size_t, int) {
-
+DataBlock* StreamRouter::acquireBlock() {
+    for ( int i = 0; i < MAX_POOLS; i++ ) {
+        DataBlockPool* p = pools[ i ].load( std::memory_order_acquire );
+        if ( !p ) {
+            break;
+        }
+        DataBlock* blk = p->Acquire();
+        if ( blk ) {
+            return blk;
+        }
+    }
+    return NULL;
 }
 
-void StreamRouter::SetHackedLen(int hacked_len) {
-    this->hack_len = hacked_len;
+void StreamRouter::publishRouteList() {
+    WorkerList* list = new WorkerList();
+    list->reserve( workers.size() );
+    for ( std::map< StreamDataHandler*, WorkerPtr >::iterator it = workers.begin(); it != workers.end(); it++ ) {
+        list->push_back( it->second );
+    }
+    const WorkerList* old_list = route_list.exchange( list );
+    // Router thread may still route a block to old list
+    old_route_lists.push_back( old_list );
+    have_removed = true;
 }
 
-static double ctr_fl = 0.0f;
-void StreamRouter::RouteData(void* data, size_t size8) {
-    if ( hack_len ) {
-        size8 = hack_len;
+void StreamRouter::releaseRemoved() {
+    if ( !have_removed ) {
+        return;
+    }
+    std::vector< const WorkerList* > old_lists;
+    std::vector< WorkerPtr > finished;
+    mtx_hnd.lock();
+    old_lists.swap( old_route_lists );
+    for ( size_t i = 0; i < retired.size(); ) {
+        if ( retired[ i ]->IsFinished() ) {
+            finished.push_back( retired[ i ] );
+            retired.erase( retired.begin() + i );
+        } else {
+            i++;
+        }
+    }
+    have_removed = !retired.empty();
+    mtx_hnd.unlock();
+
+    // Removed workers are already stopped, they are joined and deleted here, out of the lock
+    for ( size_t i = 0; i < old_lists.size(); i++ ) {
+        delete old_lists[ i ];
     }
+}
 
-    std::vector< int16_t* > chans_data;
-    chans_data.resize( 0 );
-    bool need_delete = false;
+void StreamRouter::HandleADCStreamData(void* data, size_t size8) {
+    StreamBlockInfo info;
+    info.host_time_ns   = StreamHostTimeNs();
+    info.stream_offset8 = in_offset8;
+    HandleADCStreamData( data, size8, info );
+}
 
-    uint32_t pts_cnt;
-    if ( adc_type == ADC_NT1065 || adc_type == ADC_SE4150 || adc_type == ADC_NT1065_File ) {
-        tc.Start();
-        pts_cnt = size8 / sizeof( uint8_t );
-        chans_data.resize( 4 );
+void StreamRouter::HandleADCStreamData(void* data, size_t size8, const StreamBlockInfo& info) {
+    uint8_t* src = ( uint8_t* ) data;
+    uint64_t offset8 = info.stream_offset8;
+    while ( src && size8 ) {
+        size_t chunk8 = size8 < block_size8 ? size8 : block_size8;
 
-        need_delete = true;
-        for ( uint32_t ch = 0; ch < chans_data.size(); ch++ ) {
-            chans_data[ ch ] = new int16_t[ pts_cnt ];
+        DataBlock* blk = acquireBlock();
+        if ( blk ) {
+            memcpy( blk->data, src, chunk8 );
+            blk->size8 = chunk8;
+            blk->info.host_time_ns   = info.host_time_ns;
+            blk->info.stream_offset8 = offset8;
+            pushBlock( blk );
+        } else {
+            pool_empty_blocks++;
+            pool_empty_bytes += chunk8;
+            in_seq++;
         }
 
-        uint32_t* p32 = ( uint32_t* ) data;
-        for ( uint32_t i = 0; i < pts_cnt/4; i++ ) {
-            decode4bytes_to_4shorts_ch0( p32[ i ], &chans_data[ 0 ][ 4*i ] );
-            decode4bytes_to_4shorts_ch1( p32[ i ], &chans_data[ 1 ][ 4*i ] );
-            decode4bytes_to_4shorts_ch2( p32[ i ], &chans_data[ 2 ][ 4*i ] );
-            decode4bytes_to_4shorts_ch3( p32[ i ], &chans_data[ 3 ][ 4*i ] );
-        }
-        tc.Finish(size8+pts_cnt*sizeof(short)*4);
-    } else if ( adc_type == ADC_1ch_16bit ) {
-        pts_cnt = size8 / sizeof( uint16_t );
-        chans_data.resize( 1 );
-        need_delete = false;
-        chans_data[ 0 ] = ( int16_t* ) data;
-
-    } else if ( adc_type == ADC_AD9361 ) {
-        pts_cnt = size8 / sizeof( uint16_t );
-        chans_data.resize( 2 );
-        need_delete = true;
-        for ( uint32_t ch = 0; ch < chans_data.size(); ch++ ) {
-            chans_data[ ch ] = new int16_t[ pts_cnt / 2 ];
+        src     += chunk8;
+        size8   -= chunk8;
+        offset8 += chunk8;
+    }
+    in_offset8 = offset8;
+}
+
+void StreamRouter::HandleADCStreamBlock(DataBlock* blk) {
+    if ( blk && blk->size8 ) {
+        blk->AddRef();
+        in_offset8 = blk->info.stream_offset8 + blk->size8;
+        pushBlock( blk );
+    }
+}
+
+bool StreamRouter::WaitForSpace(size_t size8, uint32_t timeout_ms) {
+    uint32_t need = ( uint32_t ) ( ( size8 + block_size8 - 1 ) / block_size8 );
+    need = std::max( 1u, std::min( need, ring.Depth() ) );
+    while ( ring.Depth() - ring.Size() < need ) {
+        if ( ring.Size() < ring.Depth() ) {
+            // data is longer than a block, some place is free already
+            std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+        } else if ( !ring.WaitNotFull( timeout_ms ) ) {
+            return false;
         }
+    }
+    return true;
+}
 
-        int16_t* p16 = ( int16_t* ) data;
-        for ( uint32_t i = 0; i < pts_cnt / 2; i += 4 ) {
+void StreamRouter::pushBlock(DataBlock* blk) {
+    blk->info.seq = in_seq++;
+    ring.Push( blk );
+}
+
+void StreamRouter::HandleStreamDataOneChan(short*, size_t, int) {
 
-            chans_data[ 0 ][ i + 0 ] = *p16++; // I
-            chans_data[ 0 ][ i + 1 ] = *p16++; // Q
+}
 
-            chans_data[ 1 ][ i + 0 ] = *p16++; // I
-            chans_data[ 1 ][ i + 1 ] = *p16++; // Q
+void StreamRouter::SetHackedLen(int hacked_len) {
+    this->hack_len = hacked_len;
+}
 
-            chans_data[ 0 ][ i + 2 ] = *p16++; // I
-            chans_data[ 0 ][ i + 3 ] = *p16++; // Q
+uint64_t StreamRouter::GetDroppedBlocks() const {
+    return ring.DroppedBlocks() + pool_empty_blocks.load();
+}
 
-            chans_data[ 1 ][ i + 2 ] = *p16++; // I
-            chans_data[ 1 ][ i + 3 ] = *p16++; // Q
+uint64_t StreamRouter::GetDroppedBytes() const {
+    return ring.DroppedBytes() + pool_empty_bytes.load();
+}
 
-        }
+uint32_t StreamRouter::BytesPerPoint(ADCType type) {
+    return adc_format_info( type ).bytes_per_point;
+}
 
+void StreamRouter::fillBlockInfo(StreamBlockInfo& info, size_t size8) {
+    if ( info.stream_offset8 < expected_offset8 ) {
+        // device was restarted
+        dropped8 = 0;
     } else {
-        static int error_count = 0;
-        if ( error_count++ % 10 == 0 ) {
-            fprintf( stderr, "__error__ StreamRouter::RouteData UNKNOWN adc type %d\n", ( int ) adc_type );
-        }
+        dropped8 += info.stream_offset8 - expected_offset8;
     }
-    mtx_hnd.lock();
-    std::set< StreamDataHandler* > handlers_copy( handlers );
-    mtx_hnd.unlock();
-    std::set< StreamDataHandler* >::iterator handler = handlers_copy.begin();
-    while ( handler != handlers_copy.end() ) {
-        (*handler)->HandleADCStreamData(data, size8);
-        (*handler)->HandleAllChansData( chans_data, pts_cnt );
-        for ( uint32_t ch = 0; ch < chans_data.size(); ch++ ) {
-            uint32_t p_cnt_fixed = pts_cnt;
-            if ( adc_type == ADC_AD9361 ) {
-                p_cnt_fixed = pts_cnt / 2;
-            }
-            (*handler)->HandleStreamDataOneChan(chans_data[ ch ], p_cnt_fixed, ch);
-        }
-        handler++;
+    expected_offset8 = info.stream_offset8 + size8;
+
+    uint32_t bpp = BytesPerPoint( adc_type );
+    info.first_sample    = info.stream_offset8 / bpp;
+    info.dropped_samples = dropped8 / bpp;
+}
+
+void StreamRouter::decodeBlock(const WorkerList& list, DataBlock* blk) {
+    uint32_t chans_mask = ( 1u << decoders.ChansCount() ) - 1;
+    uint32_t need16 = 0;
+    uint32_t need8  = 0;
+    uint32_t needf  = 0;
+    for ( size_t i = 0; i < list.size(); i++ ) {
+        StreamWorker::AddNeeds( list[ i ]->Subscription(), chans_mask, need16, need8, needf );
     }
+    if ( !( need16 | need8 | needf ) ) {
+        return;
+    }
+    StreamDecoder* decoder = decoders.Acquire();
+    if ( !decoder ) {
+        return;
+    }
+    tc.Start();
+    blk->planes = &decoder->Decode( blk->data, blk->size8, need16, need8, needf );
+    tc.Finish( blk->size8 );
+
+    blk->AddRef();
+    DecodedBlock d = { blk, decoder };
+    decoded.push_back( d );
+}
 
-    if ( need_delete ) {
-        for ( uint32_t ch = 0; ch < chans_data.size(); ch++ ) {
-            delete [] chans_data[ ch ];
+void StreamRouter::releaseDecoded(bool all) {
+    for ( size_t i = 0; i < decoded.size(); ) {
+        DecodedBlock& d = decoded[ i ];
+        if ( all || d.blk->IsUnique() ) {
+            d.blk->planes = NULL;
+            decoders.Release( d.decoder );
+            d.blk->Release();
+            d = decoded.back();
+            decoded.pop_back();
+        } else {
+            i++;
         }
     }
 }
 
+void StreamRouter::RouteBlock(DataBlock* blk) {
+    const WorkerList& list = *route_list.load();
+    decodeBlock( list, blk );
+    for ( size_t i = 0; i < list.size(); i++ ) {
+        list[ i ]->Push( blk );
+    }
+}
+
 void StreamRouter::onOverrun(uint64_t over_size8, uint32_t over_queue_count) {
-    fprintf( stderr, "__warning__ queue overrun: %d %f MBytes\n", over_queue_count, over_size8 / ( 1024.0 * 1024.0 ) );
+    fprintf( stderr, "__warning__ queue overrun: %u blocks %f MBytes dropped (%llu blocks total)\n",
+             over_queue_count, over_size8 / ( 1024.0 * 1024.0 ), ( unsigned long long ) GetDroppedBlocks() );
 }
 
 void StreamRouter::DataHandleLoop() {
-    uint32_t queue_size = 0;
-    
+    pipe_thread_setup( PipeThread_Router );
     while ( loop_running ) {
-        StreamData elem;
-
-        {
-            std::unique_lock<std::mutex> lck( mtx_q );
-            queue_size = dqueue.size();
-            if ( queue_size ) {
-                elem = dqueue.front();
-                dqueue.pop();
-                lck.unlock();
-            } else {
-                cond_var.wait( lck );
-                queue_size = dqueue.size();
-                if ( queue_size ) {
-                    elem = dqueue.front();
-                    dqueue.pop();
-                }
-            }
+        releaseRemoved();
+        releaseDecoded( false );
+
+        DataBlock* blk = ring.Pop();
+        if ( !blk ) {
+            ring.WaitNotEmpty( WAIT_TIMEOUT_MS );
+            continue;
         }
 
-        queue_size8 -= elem.size8;
-        
-        if ( queue_size > 1 ) {
-            onOverrun( queue_size8, queue_size );
+        uint64_t drop_blocks = GetDroppedBlocks();
+        uint64_t drop_bytes  = GetDroppedBytes();
+        if ( drop_blocks != reported_drop_blocks ) {
+            onOverrun( drop_bytes - reported_drop_bytes, ( uint32_t ) ( drop_blocks - reported_drop_blocks ) );
+            reported_drop_blocks = drop_blocks;
+            reported_drop_bytes  = drop_bytes;
         }
-        
-        if ( loop_running && queue_size && elem.data && elem.size8 ) {
-            RouteData( elem.data, elem.size8 );
-            delete [] (uint8_t*) elem.data;
+
+        fillBlockInfo( blk->info, blk->size8 );
+        if ( hack_len && ( size_t ) hack_len < blk->size8 ) {
+            blk->size8 = hack_len;
         }
+        if ( loop_running && blk->size8 ) {
+            RouteBlock( blk );
+        }
+        blk->Release();
     }
 }
-
-StreamData::StreamData() :
-    data( NULL ),
-    size8( 0 )
-{
-    
-}
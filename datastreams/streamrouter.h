@@ -1,56 +1,132 @@
 #ifndef STREAMROUTER_H
 #define STREAMROUTER_H
 
-#include <queue>
-#include <set>
+#include <atomic>
+#include <map>
+#include <memory>
 #include <thread>
 #include <mutex>
-#include <condition_variable>
+#include <vector>
 
 #include "streamdatahandler.h"
+#include "datablock.h"
+#include "blockring.h"
+#include "streamworker.h"
+#include "streamdecoder.h"
 #include "hwfx3/fx3config.h"
 #include "util/TimeComputator.h"
 
 
-struct StreamData {
-    StreamData();
-    void* data;
-    size_t size8;
-};
-
 class StreamRouter : public StreamDataHandler
 {
 public:
-    StreamRouter( ADCType type );
+    static const uint32_t DEF_QUEUE_DEPTH  = 16;
+    static const size_t   DEF_BLOCK_SIZE8  = 4 * 1024 * 1024;
+    static const uint32_t DEF_WORKER_DEPTH = 4;
+    static const uint32_t WAIT_TIMEOUT_MS  = 100;
+
+    StreamRouter( ADCType type,
+                  uint32_t queue_depth = DEF_QUEUE_DEPTH,
+                  size_t block_size8 = DEF_BLOCK_SIZE8,
+                  OverrunPolicy_t policy = Overrun_DropOldest,
+                  uint32_t worker_depth = DEF_WORKER_DEPTH );
     virtual ~StreamRouter();
+
+    // Every handler gets its own worker thread and queue (see StreamWorker)
     void AddOutPoint( StreamDataHandler* handler );
+    // When called not from handler's own callback, returns after handler's last call is finished
     void DeleteOutPoint( StreamDataHandler* handler );
-    
+
     // StreamDataHandler interface
     virtual void HandleADCStreamData(void* data, size_t size8);
+    // Copies data from device, info has position of data in device stream and receive time
+    void HandleADCStreamData(void* data, size_t size8, const StreamBlockInfo& info);
     virtual void HandleStreamDataOneChan( short* one_ch_data, size_t pts_cnt, int channel );
 
+    // Queues block without copying, router keeps its own reference until block is routed
+    void HandleADCStreamBlock( DataBlock* blk );
+
+    // Producer side. Sleeps until input queue has place for size8 bytes, false on timeout.
+    // Source which is not paced (file replay) calls it before every block instead of overrunning.
+    bool WaitForSpace( size_t size8, uint32_t timeout_ms );
+
     void SetHackedLen( int hacked_len );
+
+    uint64_t GetDroppedBlocks() const;
+    uint64_t GetDroppedBytes() const;
+
+    // Size of one sample of one channel in ADC stream (StreamBlockInfo::first_sample units)
+    static uint32_t BytesPerPoint( ADCType type );
 protected:
-    virtual void RouteData( void* data, size_t size8 );
+    virtual void RouteBlock( DataBlock* blk );
     virtual void onOverrun( uint64_t over_size8, uint32_t over_queue_count );
-    
+
 private:
-    std::set< StreamDataHandler* > handlers;
-    std::queue< StreamData > dqueue;
-    
-    std::mutex mtx_q, mtx_hnd;
+    typedef std::shared_ptr< StreamWorker > WorkerPtr;
+    typedef std::vector< WorkerPtr > WorkerList;
+
+    // Writer side, changed under mtx_hnd
+    std::map< StreamDataHandler*, WorkerPtr > workers;
+    std::vector< WorkerPtr > retired;   // removed from their own threads, joined later
+
+    // Snapshot of workers for RouteBlock, never changed after publishing.
+    // Router thread is its only reader, so replaced snapshots are deleted by router thread
+    // between blocks and the per-block path takes no lock and allocates nothing.
+    std::atomic< const WorkerList* > route_list;
+    std::vector< const WorkerList* > old_route_lists;
+    std::atomic<bool> have_removed;     // old_route_lists or retired are not empty
+    void publishRouteList();    // under mtx_hnd
+    void releaseRemoved();      // router thread only
+
+    // Blocks are decoded once for all workers, router keeps its reference of decoded block
+    // until workers have released it, then gives the decoder back (router thread only)
+    struct DecodedBlock {
+        DataBlock* blk;
+        StreamDecoder* decoder;
+    };
+    StreamDecoderPool decoders;
+    std::vector< DecodedBlock > decoded;
+    TimeComputator tc;
+    void decodeBlock( const WorkerList& list, DataBlock* blk );
+    void releaseDecoded( bool all );
+
+    // Input blocks. First pool covers router queue, pools are added when handlers are added, so
+    // queue of every lossless worker and block in delivery of every worker are covered too.
+    // Slots are filled under mtx_hnd, producer only reads them.
+    static const int MAX_POOLS = 16;
+    std::atomic< DataBlockPool* > pools[ MAX_POOLS ];
+    int pools_count;
+    uint32_t pool_blocks;
+    size_t block_size8;
+    uint32_t queue_depth;
+    void growPool();            // under mtx_hnd
+    DataBlock* acquireBlock();  // producer side
+
+    BlockRing ring;
+    std::atomic<uint64_t> pool_empty_blocks;
+    std::atomic<uint64_t> pool_empty_bytes;
+
+    std::mutex mtx_hnd;
     std::thread data_handler_thread;
     void DataHandleLoop(void);
-    bool loop_running;
-    std::condition_variable cond_var;
-    
-    uint64_t queue_size8;
+    std::atomic<bool> loop_running;
+
+    // producer side
+    uint64_t in_seq;
+    uint64_t in_offset8;
+    void pushBlock( DataBlock* blk );
+
+    // consumer side
+    uint64_t expected_offset8;
+    uint64_t dropped8;
+    void fillBlockInfo( StreamBlockInfo& info, size_t size8 );
+
+    uint64_t reported_drop_blocks;
+    uint64_t reported_drop_bytes;
     ADCType adc_type;
+    uint32_t worker_depth;
 
     int hack_len;
-    TimeComputator tc;
-
 };
 
 #endif
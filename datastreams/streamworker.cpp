@@ -0,0 +1,150 @@
+#include "streamworker.h"
+#include <cstdio>
+#include "util/ThreadConfig.h"
+
+StreamWorker::StreamWorker( StreamDataHandler* handler, uint32_t chans_count, uint32_t lossless_depth ) :
+    handler( handler ),
+    delivery( handler->GetDelivery() ),
+    ring( delivery == StreamDelivery_Lossless ? lossless_depth : 1,
+          delivery == StreamDelivery_Lossless ? Overrun_DropNewest : Overrun_DropOldest ),
+    subscription( handler->GetSubscription() ),
+    stopping( false ),
+    finished( false ),
+    chans_count( chans_count )
+{
+    thread = std::thread( &StreamWorker::WorkLoop, this );
+}
+
+StreamWorker::~StreamWorker() {
+    Stop();
+    Join();
+    ring.Flush();
+}
+
+void StreamWorker::Push( DataBlock* blk ) {
+    blk->AddRef();
+    if ( delivery == StreamDelivery_LatestOnly ) {
+        ring.Push( blk );
+        return;
+    }
+    while ( !ring.TryPush( blk ) ) {
+        if ( stopping ) {
+            blk->Release();
+            return;
+        }
+        ring.WaitNotFull( WAIT_TIMEOUT_MS );
+    }
+}
+
+void StreamWorker::Stop() {
+    stopping = true;
+    ring.Wakeup();
+}
+
+void StreamWorker::Join() {
+    std::lock_guard< std::mutex > lck( mtx_join );
+    if ( thread.joinable() ) {
+        thread.join();
+    }
+}
+
+bool StreamWorker::IsWorkerThread() const {
+    return std::this_thread::get_id() == thread.get_id();
+}
+
+bool StreamWorker::IsFinished() const {
+    return finished;
+}
+
+StreamDataHandler* StreamWorker::Handler() const {
+    return handler;
+}
+
+StreamDelivery_t StreamWorker::Delivery() const {
+    return delivery;
+}
+
+StreamSubscription StreamWorker::Subscription() const {
+    std::lock_guard< std::mutex > lck( mtx_sub );
+    return subscription;
+}
+
+uint64_t StreamWorker::SkippedBlocks() const {
+    return ring.DroppedBlocks();
+}
+
+void StreamWorker::WorkLoop() {
+    pipe_thread_setup( PipeThread_Worker );
+    while ( !stopping ) {
+        DataBlock* blk = ring.Pop();
+        if ( !blk ) {
+            ring.WaitNotEmpty( WAIT_TIMEOUT_MS );
+            continue;
+        }
+        if ( !stopping ) {
+            Deliver( blk );
+        }
+        blk->Release();
+    }
+    finished = true;
+}
+
+void StreamWorker::AddNeeds( StreamSubscription sub, uint32_t chans_mask, uint32_t& need16, uint32_t& need8, uint32_t& needf ) {
+    sub.chan_mask &= chans_mask;
+    if ( sub.all_chans ) {
+        need16 |= chans_mask;
+    }
+    if ( sub.formats & SDF_Int16 ) {
+        need16 |= sub.chan_mask;
+    }
+    if ( sub.formats & SDF_Int8 ) {
+        need8 |= sub.chan_mask;
+    }
+    if ( sub.formats & SDF_Float ) {
+        needf |= sub.chan_mask;
+    }
+}
+
+// Subscription may change after router decoded the block, planes which were not decoded
+// are skipped for this block. Router sees the change from the next block.
+void StreamWorker::Deliver( DataBlock* blk ) {
+    StreamSubscription sub = handler->GetSubscription();
+    mtx_sub.lock();
+    subscription = sub;
+    mtx_sub.unlock();
+    if ( sub.Empty() ) {
+        return;
+    }
+    const StreamPlanes* planes = blk->planes;
+    uint32_t chans = planes ? chans_count : 0;
+    size_t pts_cnt = planes ? planes->pts : 0;
+
+    handler->HandleBlockInfo( blk->info );
+    if ( sub.raw ) {
+        handler->HandleADCStreamData( blk->data, blk->size8 );
+    }
+    if ( sub.all_chans && chans ) {
+        bool have_all = true;
+        for ( uint32_t ch = 0; ch < chans; ch++ ) {
+            have_all = have_all && planes->i16[ ch ];
+        }
+        if ( have_all ) {
+            std::vector< int16_t* > chans_data( planes->i16, planes->i16 + chans );
+            handler->HandleAllChansData( chans_data, pts_cnt );
+        }
+    }
+    for ( uint32_t ch = 0; ch < chans; ch++ ) {
+        if ( !( sub.chan_mask & ( 1 << ch ) ) ) {
+            continue;
+        }
+        if ( ( sub.formats & SDF_Int16 ) && planes->i16[ ch ] ) {
+            handler->HandleStreamDataOneChan( planes->i16[ ch ], pts_cnt, ch );
+        }
+        if ( ( sub.formats & SDF_Int8 ) && planes->i8[ ch ] ) {
+            handler->HandleStreamDataOneChanInt8( planes->i8[ ch ], pts_cnt, ch );
+        }
+        if ( ( sub.formats & SDF_Float ) && planes->f32[ ch ] ) {
+            handler->HandleStreamDataOneChanFloat( planes->f32[ ch ], pts_cnt, ch );
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef STREAMWORKER_H
+#define STREAMWORKER_H
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <vector>
+
+#include "streamdatahandler.h"
+#include "datablock.h"
+#include "blockring.h"
+#include "streamdecoder.h"
+
+/*
+ * Own thread and queue of one StreamDataHandler.
+ * Router decodes every block once for the union of subscriptions (DataBlock::planes) and
+ * pushes it to all workers, worker calls its handler. So slow handler delays only itself:
+ *   StreamDelivery_Lossless   - router waits for free place in worker's queue
+ *   StreamDelivery_LatestOnly - queue of one block, older block is replaced by newer
+ */
+class StreamWorker {
+public:
+    // chans_count - channels of ADC stream, 0 - only raw data is delivered
+    StreamWorker( StreamDataHandler* handler, uint32_t chans_count, uint32_t lossless_depth );
+    ~StreamWorker();
+
+    // Router side. Takes its own reference of blk
+    void Push( DataBlock* blk );
+
+    // Asks worker thread to exit after current block, does not wait
+    void Stop();
+    // Waits for worker thread, can not be called from worker thread itself
+    void Join();
+    bool IsWorkerThread() const;
+    bool IsFinished() const;
+
+    StreamDataHandler* Handler() const;
+    StreamDelivery_t Delivery() const;
+    // Last subscription of the handler, router uses it instead of calling the handler
+    StreamSubscription Subscription() const;
+    uint64_t SkippedBlocks() const;
+
+    // Adds planes which sub needs to the router's decode masks (bit per channel)
+    static void AddNeeds( StreamSubscription sub, uint32_t chans_mask, uint32_t& need16, uint32_t& need8, uint32_t& needf );
+
+private:
+    StreamWorker( const StreamWorker& );
+    StreamWorker& operator=( const StreamWorker& );
+
+    void WorkLoop();
+    void Deliver( DataBlock* blk );
+
+    static const uint32_t WAIT_TIMEOUT_MS = 100;
+
+    StreamDataHandler* handler;
+    StreamDelivery_t delivery;
+    BlockRing ring;
+
+    StreamSubscription subscription;
+    mutable std::mutex mtx_sub;
+
+    std::atomic<bool> stopping;
+    std::atomic<bool> finished;
+    std::mutex mtx_join;
+    std::thread thread;
+
+    uint32_t chans_count;
+};
+
+#endif // STREAMWORKER_H
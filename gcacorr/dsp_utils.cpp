@@ -121,6 +121,33 @@ float_cpx_t *freq_shift(const float_cpx_t *signal, uint32_t samples_count, doubl
     return out;
 }
 
+float_cpx_t *freq_shift(const float *signal, uint32_t samples_count, double SR_hz, double freq_shift_hz) {
+    float_cpx_t* out = new float_cpx_t[ samples_count ];
+    float t = freq_shift_hz * 2.0f * M_PI / SR_hz;
+    for ( uint32_t i = 0; i < samples_count; i++ ) {
+        float phi = t * i;
+        out[ i ] = float_cpx_t( signal[ i ] * cos( phi ), signal[ i ] * sin( phi ) );
+    }
+    return out;
+}
+
+float_cpx_t* circle_shift_real(const float_cpx_t *half_spectrum, int samples, int rotate_idx) {
+    float_cpx_t* out = new float_cpx_t[ samples ];
+    int half_len = samples / 2;
+    int m = ( -rotate_idx ) % samples;
+    if ( m < 0 ) {
+        m += samples;
+    }
+    for ( int k = 0; k < samples; k++ ) {
+        // upper half of real signal spectrum is the conjugated mirror of lower
+        out[ k ] = ( m <= half_len ) ? half_spectrum[ m ] : half_spectrum[ samples - m ].conj();
+        if ( ++m == samples ) {
+            m = 0;
+        }
+    }
+    return out;
+}
+
 float_cpx_t* make_fir(const float_cpx_t *S, const float *fir, int out_len, int fir_len) {
     float_cpx_t* ans = new float_cpx_t[ out_len ];
 
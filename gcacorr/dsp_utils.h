@@ -19,6 +19,7 @@ void add_vector(float_cpx_t *dst, const float_cpx_t *B, int len );
 void get_lengths(const float_cpx_t* A, float* result, int len , double scale);
 float get_mean( const float* A, int len );
 float_cpx_t* freq_shift(const float_cpx_t *signal, uint32_t samples_count, double SR_hz, double freq_shift_hz);
+float_cpx_t* freq_shift(const float *signal, uint32_t samples_count, double SR_hz, double freq_shift_hz);
 float_cpx_t* make_fir(const float_cpx_t *S, const float *fir, int out_len, int fir_len );
 float_cpx_t calc_correlation( float_cpx_t* A, float_cpx_t* B, int len );
 
@@ -47,4 +48,7 @@ data_t* circle_shift( data_t* data, int samples, int rotate_idx ) {
     return out;
 }
 
+// circle_shift() of full spectrum of real signal, which is given by bins 0 .. samples / 2 (r2c output)
+float_cpx_t* circle_shift_real( const float_cpx_t* half_spectrum, int samples, int rotate_idx );
+
 #endif // DSP_UTILS_H
@@ -0,0 +1,233 @@
+#include "fftplans.h"
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+struct FFTPlanKey {
+    int  n;
+    int  howmany;
+    int  kind;
+    int  threads;
+    bool aligned;
+    bool in_place;
+
+    bool operator<( const FFTPlanKey& k ) const {
+        if ( n != k.n )             return n < k.n;
+        if ( howmany != k.howmany ) return howmany < k.howmany;
+        if ( kind != k.kind )       return kind < k.kind;
+        if ( threads != k.threads ) return threads < k.threads;
+        if ( aligned != k.aligned ) return aligned < k.aligned;
+        return in_place < k.in_place;
+    }
+};
+
+static std::mutex planner_mtx;
+static std::map< FFTPlanKey, fftwf_plan > plans;
+static unsigned planner_flags = FFTW_MEASURE;
+static bool threads_ready = false;
+static int  plan_threads  = 1;
+static int  threads_min_size = 0;
+
+// planner_mtx is held
+static bool init_threads() {
+    if ( !threads_ready ) {
+        if ( !fftwf_init_threads() ) {
+            fprintf( stderr, "__warning__ fft_plans_set_threads() FFTW threads can't be initialized\n" );
+            return false;
+        }
+        threads_ready = true;
+    }
+    return true;
+}
+
+void fft_plans_set_effort( FFTPlanEffort_t effort ) {
+    std::lock_guard< std::mutex > lck( planner_mtx );
+    switch ( effort ) {
+        case FFTEffort_Estimate: planner_flags = FFTW_ESTIMATE; break;
+        case FFTEffort_Patient:  planner_flags = FFTW_PATIENT;  break;
+        default:                 planner_flags = FFTW_MEASURE;  break;
+    }
+}
+
+void fft_plans_set_threads( int threads, int min_size ) {
+    std::lock_guard< std::mutex > lck( planner_mtx );
+    if ( threads > 1 && !init_threads() ) {
+        threads = 1;
+    }
+    plan_threads     = threads > 1 ? threads : 1;
+    threads_min_size = min_size;
+    if ( plan_threads > 1 ) {
+        fprintf( stderr, "fft_plans_set_threads() %d threads for transforms of %d points and more\n",
+                 plan_threads, threads_min_size );
+    }
+}
+
+fftwf_plan fft_plan_get( int n, FFTPlanKind_t kind, const void* in, const void* out, int howmany ) {
+    if ( howmany < 1 ) {
+        howmany = 1;
+    }
+    FFTPlanKey key;
+    key.n        = n;
+    key.howmany  = howmany;
+    key.kind     = kind;
+    key.aligned  = fftwf_alignment_of( ( float* ) in ) == 0 && fftwf_alignment_of( ( float* ) out ) == 0;
+    key.in_place = ( in == out );
+
+    std::lock_guard< std::mutex > lck( planner_mtx );
+    key.threads  = ( ( int64_t ) n * howmany >= threads_min_size ) ? plan_threads : 1;
+    std::map< FFTPlanKey, fftwf_plan >::iterator it = plans.find( key );
+    if ( it != plans.end() ) {
+        return it->second;
+    }
+
+    // Measuring planner overwrites arrays, so plan is made on scratch ones of the same kind,
+    // unaligned plan gets arrays shifted by one float
+    // batch of in-place real transforms keeps padded inputs
+    size_t out_cpx = ( kind == FFTPlan_RealForward ) ? n / 2 + 1 : n;
+    size_t in_dist = ( kind == FFTPlan_RealForward ) ? ( key.in_place ? 2 * out_cpx : n ) : n;
+    size_t in_flt  = ( kind == FFTPlan_RealForward ) ? in_dist : 2 * n;
+    size_t shift   = key.aligned ? 0 : 1;
+    float* a = ( float* ) fftwf_malloc( ( in_flt * howmany + shift ) * sizeof( float ) );
+    float* b = key.in_place ? a : ( float* ) fftwf_malloc( ( 2 * out_cpx * howmany + shift ) * sizeof( float ) );
+    float* pin  = a + shift;
+    float* pout = b + shift;
+    unsigned flags = planner_flags | ( key.aligned ? 0 : FFTW_UNALIGNED );
+
+    if ( threads_ready ) {
+        fftwf_plan_with_nthreads( key.threads );
+    }
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    fftwf_plan p = NULL;
+    switch ( kind ) {
+        case FFTPlan_Forward:
+        case FFTPlan_Backward:
+            p = fftwf_plan_many_dft( 1, &n, howmany, ( fftwf_complex* ) pin, NULL, 1, n,
+                                     ( fftwf_complex* ) pout, NULL, 1, n,
+                                     kind == FFTPlan_Forward ? FFTW_FORWARD : FFTW_BACKWARD, flags );
+            break;
+        case FFTPlan_RealForward:
+            p = fftwf_plan_many_dft_r2c( 1, &n, howmany, pin, NULL, 1, ( int ) in_dist,
+                                         ( fftwf_complex* ) pout, NULL, 1, ( int ) out_cpx, flags );
+            break;
+        default:
+            break;
+    }
+    double ms = std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - t0 ).count();
+
+    if ( !key.in_place ) {
+        fftwf_free( b );
+    }
+    fftwf_free( a );
+
+    if ( !p ) {
+        fprintf( stderr, "__error__ fft_plan_get() can't make plan n = %d x %d kind %d\n", n, howmany, ( int ) kind );
+        return NULL;
+    }
+    if ( ms > 100.0 ) {
+        fprintf( stderr, "fft_plan_get() plan n = %d x %d kind %d threads %d took %.0f ms\n",
+                 n, howmany, ( int ) kind, key.threads, ms );
+    }
+    plans[ key ] = p;
+    return p;
+}
+
+bool fft_wisdom_import( const char* fname ) {
+    FILE* f = fopen( fname, "r" );
+    if ( !f ) {
+        return true;
+    }
+    fclose( f );
+    std::lock_guard< std::mutex > lck( planner_mtx );
+    if ( !fftwf_import_wisdom_from_filename( fname ) ) {
+        fprintf( stderr, "__warning__ fft_wisdom_import() '%s' is broken, plans will be measured\n", fname );
+        return false;
+    }
+    return true;
+}
+
+bool fft_wisdom_export( const char* fname ) {
+    std::lock_guard< std::mutex > lck( planner_mtx );
+    if ( !fftwf_export_wisdom_to_filename( fname ) ) {
+        fprintf( stderr, "__warning__ fft_wisdom_export() can't write '%s'\n", fname );
+        return false;
+    }
+    return true;
+}
+
+// ms per in-place forward transform, planned with FFTW_MEASURE, planner_mtx is held
+static double bench_transform( fftwf_complex* buf, int n, int threads ) {
+    fftwf_plan_with_nthreads( threads );
+    fftwf_plan p = fftwf_plan_dft_1d( n, buf, buf, FFTW_FORWARD, FFTW_MEASURE );
+    if ( !p ) {
+        return 0.0;
+    }
+    for ( int i = 0; i < n; i++ ) {
+        buf[ i ][ 0 ] = ( float ) ( i % 7 );
+        buf[ i ][ 1 ] = 0.0f;
+    }
+    fftwf_execute( p );
+    // at least 200 ms of transforms
+    int reps = 0;
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    double ms = 0.0;
+    do {
+        for ( int i = 0; i < 8; i++ ) {
+            fftwf_execute( p );
+        }
+        reps += 8;
+        ms = std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - t0 ).count();
+    } while ( ms < 200.0 );
+    fftwf_destroy_plan( p );
+    return ms / reps;
+}
+
+int fft_threads_benchmark( int max_threads ) {
+    // powers of 2 and acquisition lengths SR / 1000 of NT1065, AD9361, ADC_1ch_16bit
+    static const int sizes[] = { 1024, 4096, 16384, 32768, 53000, 65536, 70000, 120000, 262144, 1048576 };
+    const int sizes_count = sizeof( sizes ) / sizeof( sizes[ 0 ] );
+
+    std::lock_guard< std::mutex > lck( planner_mtx );
+    if ( max_threads < 2 || !init_threads() ) {
+        fprintf( stderr, "__warning__ fft_threads_benchmark() needs 2 threads or more\n" );
+        return 0;
+    }
+    fftwf_complex* buf = ( fftwf_complex* ) fftwf_malloc( sizeof( fftwf_complex ) * sizes[ sizes_count - 1 ] );
+    if ( !buf ) {
+        return 0;
+    }
+
+    fprintf( stderr, "fft_threads_benchmark() ms per complex transform\n%10s", "n" );
+    for ( int t = 1; t <= max_threads; t *= 2 ) {
+        fprintf( stderr, " %9dt", t );
+    }
+    fprintf( stderr, "\n" );
+
+    int crossover = 0;
+    for ( int s = 0; s < sizes_count; s++ ) {
+        int n = sizes[ s ];
+        fprintf( stderr, "%10d", n );
+        double single = 0.0;
+        double best   = 0.0;
+        for ( int t = 1; t <= max_threads; t *= 2 ) {
+            double ms = bench_transform( buf, n, t );
+            fprintf( stderr, " %10.4f", ms );
+            if ( t == 1 ) {
+                single = ms;
+            } else if ( best == 0.0 || ms < best ) {
+                best = ms;
+            }
+        }
+        fprintf( stderr, "\n" );
+        if ( !crossover && best > 0.0 && best < 0.9 * single ) {
+            crossover = n;
+        }
+    }
+    fftwf_free( buf );
+    // registry plans are made with their own thread count
+    fftwf_plan_with_nthreads( 1 );
+
+    fprintf( stderr, "fft_threads_benchmark() threads are faster from n = %d\n", crossover );
+    return crossover;
+}
@@ -0,0 +1,49 @@
+#ifndef FFTPLANS_H
+#define FFTPLANS_H
+
+#include <fftw3.h>
+
+#define FFT_WISDOM_FILE_NAME "fftw_wisdom.dat"
+
+/*
+ * Process-wide cache of FFTW plans. Plan is made once for size, kind and the arrays
+ * properties (alignment, in-place), any number of FFTWrapper share it and run it with
+ * new-array execution (fftwf_execute_dft...). FFTW planner is not thread-safe, all
+ * planning goes through the registry mutex, execution needs no lock.
+ * Plans live until process exit.
+ */
+enum FFTPlanKind_t {
+    FFTPlan_Forward = 0,    // complex to complex
+    FFTPlan_Backward,
+    FFTPlan_RealForward,    // real to N / 2 + 1 complex
+    FFTPlan_KindsCount
+};
+
+enum FFTPlanEffort_t {
+    FFTEffort_Estimate = 0,
+    FFTEffort_Measure,
+    FFTEffort_Patient
+};
+
+// Effort of plans made after the call, measured plans take time once, then come from wisdom
+void fft_plans_set_effort( FFTPlanEffort_t effort );
+
+// Plans of n * howmany >= min_size points made after the call are executed by 'threads'
+// threads (FFTW threads, transforms below some size only lose on it). Call before wisdom import.
+void fft_plans_set_threads( int threads, int min_size );
+
+// in, out - arrays the plan will be executed with, or arrays with the same alignment
+// and in-place property. Returns NULL if FFTW can't make the plan.
+// howmany > 1 - batch of transforms, contiguous: input k at in + k * n (values),
+// output k at out + k * ( n / 2 + 1 ) complex for real input, k * n otherwise.
+fftwf_plan fft_plan_get( int n, FFTPlanKind_t kind, const void* in, const void* out, int howmany = 1 );
+
+// false if file can't be read or written, missing file at first start is not an error
+bool fft_wisdom_import( const char* fname = FFT_WISDOM_FILE_NAME );
+bool fft_wisdom_export( const char* fname = FFT_WISDOM_FILE_NAME );
+
+// Times complex transforms of typical sizes with 1 .. max_threads threads and prints the table.
+// Returns the smallest size where threads were at least 10% faster, 0 if none.
+int fft_threads_benchmark( int max_threads );
+
+#endif // FFTPLANS_H
@@ -1,73 +1,100 @@
 #include "fftwrapper.h"
 
 #include <string.h>
+#include <algorithm>
 
 
 FFTWrapper::FFTWrapper(unsigned int N) :
+    in_float( N ),
     t( "fft" )
 {
     t.SetPrintPeriod( 64 );
     this->N = N;
-    in_float    = ( float* )         fftwf_malloc( N * sizeof( float ) );
-    in_complex  = ( fftwf_complex* ) fftwf_malloc( N * sizeof( fftwf_complex ) );
-    out_complex = ( fftwf_complex* ) fftwf_malloc( N * sizeof( fftwf_complex ) );
-
-    plan_real         = fftwf_plan_dft_r2c_1d( N, in_float, out_complex, FFTW_ESTIMATE );
-    plan_complex[ 0 ] = fftwf_plan_dft_1d( N, in_complex, out_complex, FFTW_FORWARD, FFTW_ESTIMATE );
-    plan_complex[ 1 ] = fftwf_plan_dft_1d( N, in_complex, out_complex, FFTW_BACKWARD, FFTW_ESTIMATE );
+    memset( plans, 0, sizeof( plans ) );
 }
 
 FFTWrapper::~FFTWrapper() {
-    fftwf_destroy_plan( plan_real );
-    fftwf_destroy_plan( plan_complex[ 0 ] );
-    fftwf_destroy_plan( plan_complex[ 1 ] );
-    fftwf_free( in_float    );
-    fftwf_free( in_complex  );
-    fftwf_free( out_complex );
+}
+
+fftwf_plan FFTWrapper::planFor( FFTPlanKind_t kind, const void* in, const void* out ) {
+    int aligned  = fftwf_alignment_of( ( float* ) in ) == 0 && fftwf_alignment_of( ( float* ) out ) == 0;
+    int in_place = ( in == out );
+    fftwf_plan& p = plans[ kind ][ aligned ][ in_place ];
+    if ( !p ) {
+        // shared plans, see fftplans.h
+        p = fft_plan_get( N, kind, in, out );
+    }
+    return p;
 }
 
 void FFTWrapper::Transform( const float *in, float_cpx_t *out ) {
-    memcpy( in_float, in, N * sizeof( float ) );
-    fftwf_execute( plan_real );
-    convert( out, out_complex, N );
+    // out-of-place r2c keeps input
+    fftwf_execute_dft_r2c( planFor( FFTPlan_RealForward, in, out ), ( float* ) in, ( fftwf_complex* ) out );
 }
 
 void FFTWrapper::TransformShort(const short *in, float_cpx_t *out , bool inverse_spectrum) {
-    for ( int i = 0; i < N; i++ ) {
+    for ( unsigned int i = 0; i < N; i++ ) {
         in_float[ i ] = (float) in[ i ];
     }
-    fftwf_execute( plan_real );
+    fftwf_execute_dft_r2c( planFor( FFTPlan_RealForward, in_float.data(), out ), in_float.data(), ( fftwf_complex* ) out );
     if ( inverse_spectrum ) {
-        convert_inv( out, out_complex, N );
-    } else {
-        convert( out, out_complex, N );
+        std::reverse( out, out + N / 2 + 1 );
     }
 }
 
 
 void FFTWrapper::Transform( const float_cpx_t *in, float_cpx_t *out, bool is_inverse ) {
     //t.Start();
-    memcpy( in_complex, in, N * sizeof( float_cpx_t ) );
-    fftwf_execute( plan_complex[ is_inverse ] );
-    convert( out, out_complex, N );
+    FFTPlanKind_t kind = is_inverse ? FFTPlan_Backward : FFTPlan_Forward;
+    fftwf_execute_dft( planFor( kind, in, out ), ( fftwf_complex* ) in, ( fftwf_complex* ) out );
     //t.Finish();
 }
 
-void FFTWrapper::convert(float_cpx_t *dst, fftwf_complex *src, int len) {
-    //memcpy( dst, src, len * sizeof( fftwf_complex ) );
-    for ( int i = 0; i < len; i++ ) {
-        dst[ i ].i = src[ i ][ 0 ];
-        dst[ i ].q = src[ i ][ 1 ];
+int FFTWrapper::BatchBins() const {
+    return N / 2 + 1;
+}
+
+template < typename T >
+void FFTWrapper::batchConvert( const T* const in[], int arrays, int windows, const float* window_fn, int stride ) {
+    batch_in.resize( ( size_t ) arrays * windows * N );
+    for ( int w = 0; w < windows; w++ ) {
+        for ( int a = 0; a < arrays; a++ ) {
+            const T* src = in[ a ] + ( size_t ) w * N * stride;
+            float* dst = batch_in.data() + ( ( size_t ) w * arrays + a ) * N;
+            if ( window_fn ) {
+                for ( unsigned int i = 0; i < N; i++ ) {
+                    dst[ i ] = ( float ) src[ i * stride ] * window_fn[ i ];
+                }
+            } else {
+                for ( unsigned int i = 0; i < N; i++ ) {
+                    dst[ i ] = ( float ) src[ i * stride ];
+                }
+            }
+        }
     }
 }
 
-void FFTWrapper::convert_inv(float_cpx_t *dst, fftwf_complex *src, int len) {
-    for ( int i = 0; i < len/2; i++ ) {
-        dst[ i ].i = src[ len/2 - i ][ 0 ];
-        dst[ i ].q = src[ len/2 - i ][ 1 ];
+void FFTWrapper::batchExecute( int count, float_cpx_t* out ) {
+    fftwf_plan p = fft_plan_get( N, FFTPlan_RealForward, batch_in.data(), out, count );
+    if ( p ) {
+        fftwf_execute_dft_r2c( p, batch_in.data(), ( fftwf_complex* ) out );
     }
-    for ( int i = len/2; i < len; i++ ) {
-        dst[ i ].i = src[ len - i ][ 0 ];
-        dst[ i ].q = src[ len - i ][ 1 ];
+}
+
+void FFTWrapper::TransformShortBatch( const short* const in[], int arrays, int windows, float_cpx_t* out,
+                                      const float* window_fn, int stride ) {
+    if ( arrays <= 0 || windows <= 0 ) {
+        return;
+    }
+    batchConvert( in, arrays, windows, window_fn, stride );
+    batchExecute( arrays * windows, out );
+}
+
+void FFTWrapper::TransformBatch( const float* const in[], int arrays, int windows, float_cpx_t* out,
+                                 const float* window_fn, int stride ) {
+    if ( arrays <= 0 || windows <= 0 ) {
+        return;
     }
+    batchConvert( in, arrays, windows, window_fn, stride );
+    batchExecute( arrays * windows, out );
 }
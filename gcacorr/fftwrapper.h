@@ -1,27 +1,82 @@
 #ifndef FFTWRAPPER_H
 #define FFTWRAPPER_H
 
+#include <cstddef>
 #include <fftw3.h>
 #include "mathTypes.h"
+#include "fftplans.h"
 #include "util/TimeComputator.h"
 
+static_assert( sizeof( float_cpx_t ) == sizeof( fftwf_complex ), "float_cpx_t must be layout-compatible with fftwf_complex" );
+
+// Array aligned for FFTW SIMD code (fftwf_malloc), transforms of it take the aligned plans
+template < typename T >
+class FFTBuffer {
+public:
+    explicit FFTBuffer( size_t n = 0 ) : ptr( NULL ), n( 0 ) { resize( n ); }
+    ~FFTBuffer() { fftwf_free( ptr ); }
+
+    // Contents are not kept
+    void resize( size_t count ) {
+        if ( count == n ) {
+            return;
+        }
+        fftwf_free( ptr );
+        ptr = count ? ( T* ) fftwf_malloc( count * sizeof( T ) ) : NULL;
+        n   = count;
+    }
+
+    T* data() { return ptr; }
+    const T* data() const { return ptr; }
+    size_t size() const { return n; }
+    T& operator[]( size_t i ) { return ptr[ i ]; }
+    const T& operator[]( size_t i ) const { return ptr[ i ]; }
+
+private:
+    FFTBuffer( const FFTBuffer& );
+    FFTBuffer& operator=( const FFTBuffer& );
+
+    T* ptr;
+    size_t n;
+};
+
+/*
+ * Transforms run on caller arrays (new-array execution of shared plans), in == out is
+ * in-place. Any alignment works, FFTBuffer arrays get the fastest plans.
+ * Real input transforms write bins 0 .. N / 2, the upper half of out is not touched.
+ */
 class FFTWrapper {
 public:
     FFTWrapper( unsigned int N  );
     ~FFTWrapper();
     void Transform( const float* in,       float_cpx_t* out );
+    // inverse_spectrum: out[ i ] = bin N / 2 - i
     void TransformShort( const short* in,  float_cpx_t* out, bool inverse_spectrum );
     void Transform( const float_cpx_t* in, float_cpx_t* out, bool is_inverse );
 
+    /*
+     * Real transforms of windows x arrays in one plan execution. Window w of array a is
+     * in[ a ][ ( w * N + i ) * stride ], i < N (stride > 1 takes one channel of interleaved data).
+     * Its N / 2 + 1 bins are written to out + ( w * arrays + a ) * BatchBins().
+     * window_fn (N values) or NULL is applied while input is converted to float.
+     */
+    void TransformShortBatch( const short* const in[], int arrays, int windows, float_cpx_t* out,
+                              const float* window_fn = NULL, int stride = 1 );
+    void TransformBatch( const float* const in[], int arrays, int windows, float_cpx_t* out,
+                         const float* window_fn = NULL, int stride = 1 );
+    int BatchBins() const;
+
 private:
-    void convert( float_cpx_t* dst, fftwf_complex* src, int len );
-    void convert_inv( float_cpx_t* dst, fftwf_complex* src, int len );
-    float* in_float;
-    fftwf_complex* in_complex;
-    fftwf_complex* out_complex;
-
-    fftwf_plan plan_real;
-    fftwf_plan plan_complex[ 2 ];
+    fftwf_plan planFor( FFTPlanKind_t kind, const void* in, const void* out );
+    template < typename T >
+    void batchConvert( const T* const in[], int arrays, int windows, const float* window_fn, int stride );
+    void batchExecute( int count, float_cpx_t* out );
+
+    FFTBuffer< float > in_float;
+    FFTBuffer< float > batch_in;
+
+    // [ kind ][ aligned ][ in-place ], taken from registry on first use
+    fftwf_plan plans[ FFTPlan_KindsCount ][ 2 ][ 2 ];
     unsigned int N;
     TimeComputator t;
 };
@@ -12,27 +12,15 @@ GPSVis::GPSVis(uint32_t prn, const double doppler_freq_border, const double dopp
     DOPPLER_STEP_CNT( 1 + ( doppler_freq_border * 2 ) / doppler_step ),
     CPS( is_glonass ? 511000.0f : 1023000.0f ),
     fft( NPNT ),
-    tmp_vec_cpx( NULL ),
-    tmp_vec_flt( NULL ),
-    etcode_fft_conj( NULL ),
+    tmp_vec_cpx( NPNT ),
+    tmp_vec_flt( NPNT ),
+    etcode_fft_conj( NPNT ),
     sigs( NULL )
 {
-    tmp_vec_cpx = new float_cpx_t[ NPNT ];
-    tmp_vec_flt = new float[ NPNT ];
-    etcode_fft_conj = new float_cpx_t[ NPNT ];
     GenerateEtalonCode();
 }
 
 GPSVis::~GPSVis() {
-    if ( tmp_vec_cpx ) {
-        delete [] tmp_vec_cpx;
-    }
-    if ( tmp_vec_flt ) {
-        delete [] tmp_vec_flt;
-    }
-    if ( etcode_fft_conj ) {
-        delete [] etcode_fft_conj;
-    }
 }
 
 void GPSVis::SetSignal(std::vector<RawSignal *> *signals_ptr) {
@@ -71,11 +59,14 @@ void GPSVis::GenerateEtalonCode() {
 
     for ( int char_idx = 0; char_idx < NPNT; char_idx++ ) {
         int code_idx = ( int ) floor( char_idx / samples_per_char );
-        tmp_vec_cpx[ char_idx ].i = 1.0f * ( float ) -code[ code_idx ];
-        tmp_vec_cpx[ char_idx ].q = 0.0f;
+        tmp_vec_flt[ char_idx ] = 1.0f * ( float ) -code[ code_idx ];
+    }
+    // code is real, upper half of spectrum is mirror of r2c bins
+    fft.Transform( tmp_vec_flt.data(), etcode_fft_conj.data() );
+    for ( int k = NPNT / 2 + 1; k < NPNT; k++ ) {
+        etcode_fft_conj[ k ] = etcode_fft_conj[ NPNT - k ].conj();
     }
-    fft.Transform( tmp_vec_cpx, etcode_fft_conj, false );
-    conjugate( etcode_fft_conj, NPNT );
+    conjugate( etcode_fft_conj.data(), NPNT );
 }
 
 void GPSVis::CalcCorrVector(double doppler_freq) {
@@ -99,10 +90,10 @@ void GPSVis::CalcCorrVector(double doppler_freq) {
     for ( uint32_t i = 0; i < sigs->size(); i++ ) {
         const float_cpx_t* sig = sigs->at( i )->GetSignalShifted( -( doppler_freq + GPS_FREQ ) );
 
-        mul_vectors( sig, etcode_fft_conj, tmp_vec_cpx, NPNT );
-        fft.Transform( tmp_vec_cpx, tmp_vec_cpx, true );
-        get_lengths( tmp_vec_cpx, tmp_vec_flt, NPNT, 1.0 / NPNT );
-        add_vector( &( corrvec.data[ 0 ] ), tmp_vec_flt, NPNT );
+        mul_vectors( sig, etcode_fft_conj.data(), tmp_vec_cpx.data(), NPNT );
+        fft.Transform( tmp_vec_cpx.data(), tmp_vec_cpx.data(), true );
+        get_lengths( tmp_vec_cpx.data(), tmp_vec_flt.data(), NPNT, 1.0 / NPNT );
+        add_vector( &( corrvec.data[ 0 ] ), tmp_vec_flt.data(), NPNT );
     }
     corrvec.stat.process_vector( &( corrvec.data[ 0 ] ), NPNT );
 }
@@ -59,9 +59,9 @@ private:
 
 private:
     FFTWrapper fft;
-    float_cpx_t* tmp_vec_cpx;
-    float* tmp_vec_flt;
-    float_cpx_t* etcode_fft_conj;
+    FFTBuffer< float_cpx_t > tmp_vec_cpx;
+    FFTBuffer< float > tmp_vec_flt;
+    FFTBuffer< float_cpx_t > etcode_fft_conj;
     correlation_matrix_t corr_matrix;
 
     std::vector< RawSignal* >* sigs;
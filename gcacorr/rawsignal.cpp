@@ -1,61 +1,86 @@
 #include "rawsignal.h"
+#include "datastreams/capturefile.h"
+#include "datastreams/capturemap.h"
 
 
 
 RawSignal::RawSignal(int pts_count, double sample_rate) :
+    real_input( false ),
+    signal_source( pts_count ),
+    signal_fft( pts_count ),
     N( pts_count ),
     FILTER_WIDTH( 1000.0 ),
     SR( sample_rate ),
     fft( pts_count )
 {
-    signal_source = new float_cpx_t[ N ];
-    signal_fft = new float_cpx_t[ N ];
 }
 
 RawSignal::~RawSignal() {
     ClearShiftedCache();
-    delete [] signal_source;
-    delete [] signal_fft;
 }
 
-void RawSignal::LoadDataFromFile(const char *fileName, DataType dtype, size_t offset_pts) {
-    FILE* f = fopen( fileName, "rb" );
-    if ( !f ) {
+void RawSignal::LoadDataFromFile(const char *fileName, DataType dtype, size_t offset_pts, int channel) {
+    CaptureMap map;
+    bool ok;
+    if ( CaptureReader::IsCapture( fileName ) ) {
+        ok = map.Open( fileName );
+    } else if ( dtype == DT_INT8_REAL || dtype == DT_INT16_REAL ) {
+        ok = map.OpenRaw( fileName, dtype == DT_INT8_REAL ? sizeof( int8_t ) : sizeof( int16_t ) );
+    } else {
+        fprintf( stderr, "RawSignal::LoadDataFromFile() error data type unknown\n" );
+        return;
+    }
+    if ( !ok ) {
         fprintf( stderr, "RawSignal::LoadDataFromFile() file IO ERROR\n" );
+        return;
     }
+    LoadDataFromMap( map, offset_pts, channel );
+}
 
-
-    if ( dtype == DT_INT8_REAL ) {
-        uint32_t len = N + sizeof( int8_t ) * offset_pts;
-        int8_t* p8 = new int8_t[ len ];
-        fread( p8, sizeof( int8_t ), len, f );
-        LoadData( p8, dtype, offset_pts );
-        delete [] p8;
-    } else if ( dtype == DT_INT16_REAL ) {
-        uint32_t len = N + sizeof( int16_t ) * offset_pts;
-        int16_t* p16 = new int16_t[ len ];
-        fread( p16, sizeof( int16_t ), len, f );
-        LoadData( p16, dtype, offset_pts );
-        delete [] p16;
-    } else {
-        fprintf( stderr, "RawSignal::LoadDataFromFile() error data type unknown\n" );
+bool RawSignal::LoadDataFromMap(CaptureMap& map, uint64_t offset_pts, int channel) {
+    const CaptureHeader& hdr = map.Header();
+    // Decoded I/Q channel is I, Q, I, Q, ..., so complex sample takes two points
+    bool iq = ( hdr.signal_type == SigTypeIQParts );
+    size_t pts     = iq ? 2 * N : N;
+    uint64_t first = iq ? 2 * offset_pts : offset_pts;
+    if ( first + pts > map.Points() ) {
+        fprintf( stderr, "RawSignal::LoadDataFromMap() capture has less than %u points after %u\n",
+                 ( unsigned ) pts, ( unsigned ) offset_pts );
+        return false;
+    }
+    if ( hdr.adc_type == ADC_Types_Count && hdr.bytes_per_point == sizeof( int8_t ) ) {
+        // headerless int8 dump
+        LoadData( ( void* ) map.Raw( first, pts ), DT_INT8_REAL, 0 );
+        return true;
     }
+    const int16_t* p16 = map.Channel16( first, pts, channel );
+    if ( !p16 ) {
+        fprintf( stderr, "RawSignal::LoadDataFromMap() error adc type %u chan %d\n", hdr.adc_type, channel );
+        return false;
+    }
+    LoadData( ( void* ) p16, iq ? DT_INT16_IQ : DT_INT16_REAL, 0 );
+    return true;
 }
 
 void RawSignal::LoadData(void *data, DataType dtype, uint32_t offset) {
     ClearShiftedCache();
+    setRealInput( dtype == DT_INT8_REAL || dtype == DT_INT16_REAL );
 
     if ( dtype == DT_INT8_REAL ) {
         int8_t* p8 = ( int8_t* ) data;
         for ( int i = 0; i < N; i++ ) {
-            signal_source[ i ].i = ( float ) p8[ i + offset ];
-            signal_source[ i ].q = 0.0f;
+            signal_real[ i ] = ( float ) p8[ i + offset ];
         }
     } else if ( dtype == DT_INT16_REAL ) {
         int16_t* p16 = ( int16_t* ) data;
         for ( int i = 0; i < N; i++ ) {
-            signal_source[ i ].i = ( float ) p16[ i + offset ];
-            signal_source[ i ].q = 0.0f;
+            signal_real[ i ] = ( float ) p16[ i + offset ];
+        }
+    } else if ( dtype == DT_INT16_IQ ) {
+        int16_t* p16 = ( int16_t* ) data + 2 * offset;
+        for ( int i = 0; i < N; i++ ) {
+            signal_source[ i ].i = ( float ) p16[ 2 * i + 0 ];
+            signal_source[ i ].q = ( float ) p16[ 2 * i + 1 ];
         }
     } else if ( dtype == DT_FLOAT_IQ ) {
         float_cpx_t* pIQF = ( float_cpx_t* ) data;
@@ -81,10 +106,18 @@ const float_cpx_t* RawSignal::GetSignalShifted(double freq) {
         float_cpx_t* sig;
         if ( abs( rotIdx * FILTER_WIDTH - freq ) < 0.5 ) {
             // can use fast alg - precision is 1 FILTER_WIDTH = 1 kHz
-            sig = circle_shift( signal_fft, N, rotIdx );
+            if ( real_input ) {
+                sig = circle_shift_real( signal_fft.data(), N, rotIdx );
+            } else {
+                sig = circle_shift( signal_fft.data(), N, rotIdx );
+            }
         } else {
             // have to use slow alg - precision is 1 Hz (in theroy)
-            sig = freq_shift( signal_source, N, SR, freq );
+            if ( real_input ) {
+                sig = freq_shift( signal_real.data(), N, SR, freq );
+            } else {
+                sig = freq_shift( signal_source.data(), N, SR, freq );
+            }
             fft.Transform( sig, sig, false );
         }
         signal_shifted[ freq ] = sig;
@@ -95,7 +128,11 @@ const float_cpx_t* RawSignal::GetSignalShifted(double freq) {
 }
 
 void RawSignal::MakeSignalFFT() {
-    fft.Transform( signal_source, signal_fft, false );
+    if ( real_input ) {
+        fft.Transform( signal_real.data(), signal_fft.data() );
+    } else {
+        fft.Transform( signal_source.data(), signal_fft.data(), false );
+    }
     //file_dump( signal_fft, N*8, "sig_fft.flt" );
     //float* spec = make_magnitude_spectrum( signal_fft, N );
     //file_dump( spec, N*4, "sig_spec.flt" );
@@ -104,7 +141,22 @@ void RawSignal::MakeSignalFFT() {
 void RawSignal::ClearShiftedCache() {
     std::map< double, float_cpx_t* >::iterator it = signal_shifted.begin();
     while ( it != signal_shifted.end() ) {
-        delete it->second;
+        delete [] it->second;
         ++it;
     }
+    signal_shifted.clear();
+}
+
+// Buffers of the other kind of data are freed
+void RawSignal::setRealInput( bool real ) {
+    real_input = real;
+    if ( real ) {
+        signal_source.resize( 0 );
+        signal_real.resize( N );
+        signal_fft.resize( N / 2 + 1 );
+    } else {
+        signal_real.resize( 0 );
+        signal_source.resize( N );
+        signal_fft.resize( N );
+    }
 }
@@ -11,16 +11,28 @@
 enum DataType {
     DT_INT8_REAL  = 0,
     DT_INT16_REAL = 1,
-    DT_FLOAT_IQ   = 2
+    DT_FLOAT_IQ   = 2,
+    DT_INT16_IQ   = 3     // I, Q, I, Q, ...
 };
 
+class CaptureMap;
+
+/*
+ * Real data (DT_INT8_REAL, DT_INT16_REAL) is kept as r2c half spectrum, shifted spectrum
+ * is taken from it by bin offset, bins of the other sideband are conjugated mirror.
+ * GetSignalShifted() gives full N-point spectrum for both kinds of data.
+ */
 class RawSignal {
 public:
     RawSignal( int pts_count, double sample_rate );
     ~RawSignal();
 
 public:
-    void LoadDataFromFile(const char* fileName, DataType dtype, size_t offset_pts);
+    // Capture file (capturefile.h) is recognized by header, then dtype is taken from it and
+    // channel is decoded from offset_pts, without reading the data before it
+    void LoadDataFromFile(const char* fileName, DataType dtype, size_t offset_pts, int channel = 0);
+    // Batch processing keeps one map of recording and loads signals one by one
+    bool LoadDataFromMap(CaptureMap& map, uint64_t offset_pts, int channel = 0);
     void LoadData(void* data, DataType dtype , uint32_t offset);
     const float_cpx_t* GetSignalShifted( double freq );
 
@@ -28,8 +40,12 @@ private:
     void MakeSignalFFT();
     void ClearShiftedCache();
 private:
-    float_cpx_t* signal_source;
-    float_cpx_t* signal_fft;
+    void setRealInput( bool real );
+
+    bool real_input;
+    FFTBuffer< float_cpx_t > signal_source;     // complex data only
+    FFTBuffer< float > signal_real;             // real data only
+    FFTBuffer< float_cpx_t > signal_fft;        // N / 2 + 1 bins for real data
     int N;
     double FILTER_WIDTH;
     double SR;
@@ -5,9 +5,9 @@
 
 #include "gpscorrform.h"
 #include "ui_gpscorrform.h"
-#include "leap/leapconverter.h"
 
 #include "util/Chan2bitParser.h"
+#include "util/ThreadConfig.h"
 
 enum TableColumnsIndexes {
     COL_STAT = 0,
@@ -209,11 +209,16 @@ void GPSCorrForm::PrepareRawData()
     int ALL_DATA_SIZE = DATA_SIZE * avg_cnt;
     int ALL_DATA_SIZE_WFIR = ALL_DATA_SIZE + GetFilterLen();
 
-    float_cpx_t* sss = new float_cpx_t[ ALL_DATA_SIZE_WFIR ];
-
-    for ( int i = 0; i < ALL_DATA_SIZE_WFIR; i++ ) {
-        sss[i].i = (float) cached_one_chan_data[ i ];
-        sss[i].q = 0.0f;
+    // Filter is applied to signal shifted by satellite frequency, which is complex.
+    // Without filter RawSignal gets real samples and makes r2c half spectrum of them.
+    bool use_filter = ui->checkBoxUseFilter->isChecked();
+    float_cpx_t* sss = NULL;
+    if ( use_filter ) {
+        sss = new float_cpx_t[ ALL_DATA_SIZE_WFIR ];
+        for ( int i = 0; i < ALL_DATA_SIZE_WFIR; i++ ) {
+            sss[i].i = (float) cached_one_chan_data[ i ];
+            sss[i].q = 0.0f;
+        }
     }
 
     for ( int prn = 1; prn <= GetPrnCount(); prn++ ) {
@@ -223,7 +228,7 @@ void GPSCorrForm::PrepareRawData()
         fprintf( stderr, "%3d", prn);
         sigs[ prn ].resize( avg_cnt );
 
-        if ( ui->checkBoxUseFilter->isChecked() ) {
+        if ( use_filter ) {
 
             // ****** SHIFT & FILTER ******
             float_cpx_t* shifted  = freq_shift( sss, ALL_DATA_SIZE_WFIR, cfg->adc_sample_rate_hz, -GetFreq(prn) );
@@ -257,7 +262,7 @@ void GPSCorrForm::PrepareRawData()
             // ****** Use original signal ******
             for ( uint32_t i = 0; i < sigs[ prn ].size(); i++ ) {
                 sigs[ prn ][ i ] = new RawSignal( DATA_SIZE, cfg->adc_sample_rate_hz );
-                sigs[ prn ][ i ]->LoadData( sss, DT_FLOAT_IQ, i*DATA_SIZE );
+                sigs[ prn ][ i ]->LoadData( cached_one_chan_data.data(), DT_INT16_REAL, i*DATA_SIZE );
             }
 
         }
@@ -457,24 +462,30 @@ void GPSCorrForm::HandleStreamDataOneChan(short *one_ch_data, size_t pts_cnt, in
     }
 }
 
+StreamDelivery_t GPSCorrForm::GetDelivery() {
+    return StreamDelivery_LatestOnly;
+}
+
+StreamSubscription GPSCorrForm::GetSubscription() {
+    StreamSubscription sub;
+    int channel = ui->comboBoxChannel->currentIndex();
+    if ( !working && ui->checkRefresh->isChecked() && channel >= 0 && channel < 32 ) {
+        sub.chan_mask = 1 << channel;
+    }
+    return sub;
+}
+
 void GPSCorrForm::onFileDumpComplete(std::string fname, ChunkDumpParams params) {
     router->DeleteOutPoint( &dumper );
     fprintf( stderr, "GPSCorrForm::onFileDumpComplete %s %d x (%d + %d)\n",
              fname.c_str(), params.count, params.len, params.gap );
 
-    LEAPConverter converter( ( int ) cfg->adc_sample_rate_hz, cfg->inter_freq_hz );
-    int bytes_per_ms = ( int ) ( cfg->adc_sample_rate_hz / 1000.0 ) * sizeof( short );
-
-    converter.convertFile( fname.c_str(),
-                           params.count,
-                           params.len / bytes_per_ms,
-                           params.gap / bytes_per_ms );
-
     ui->pushButtonSaveFile->setEnabled( true );
 }
 
 void GPSCorrForm::calcLoop() {
     qDebug( "GPSCorrForm::calcLoop() STARTED\n" );
+    pipe_thread_setup( PipeThread_GPSCorr );
     while ( running ) {
         std::this_thread::sleep_for(std::chrono::milliseconds(500));
         if ( working ) {
@@ -589,14 +600,15 @@ void GPSCorrForm::cellSelected(int x, int) {
 void GPSCorrForm::RecFile(bool) {
     ui->pushButtonSaveFile->setEnabled( false );
 
-    int bytes_per_ms = ( int ) ( cfg->adc_sample_rate_hz / 1000.0 ) * sizeof( short );
+    int pts_per_ms = ( int ) ( cfg->adc_sample_rate_hz / 1000.0 );
 
     ChunkDumpParams params;
     params.all_chans_raw_sig = false;
     params.chan_num = ui->comboBoxChannel->currentIndex();
     params.count    = ui->spinBoxChunkCount->value();
-    params.len      = ui->spinBoxChunkLen->value() * bytes_per_ms;
-    params.gap      = ui->spinBoxChunkGap->value() * bytes_per_ms;
+    params.len      = ui->spinBoxChunkLen->value() * pts_per_ms;
+    params.gap      = ui->spinBoxChunkGap->value() * pts_per_ms;
+    dumper.SetConfig( *cfg );
     int res = dumper.DumpAsync( ui->lineRecFileName->text().toLatin1().data(), params, this );
     if ( res ) {
         fprintf( stderr, "GPSCorrForm::RecFile() bad file\n" );
@@ -117,6 +117,8 @@ signals:
 public:
     void HandleADCStreamData(void *data, size_t size8);
     void HandleStreamDataOneChan(short *one_ch_data, size_t pts_cnt, int channel);
+    StreamSubscription GetSubscription();
+    StreamDelivery_t GetDelivery();
 
     // FileDumpCallbackIfce interface
 public:
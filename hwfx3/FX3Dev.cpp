@@ -1,20 +1,34 @@
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 #include "FX3Dev.h"
 #include "HexParser.h"
+#include "util/ThreadConfig.h"
 
 #ifdef WIN32
 #include <windows.h>
 #endif
 
-FX3Dev::FX3Dev( size_t one_block_size8, uint32_t dev_buffers_count ) :
+FX3Dev::FX3Dev( size_t one_block_size8, uint32_t dev_buffers_count, uint32_t spare_buffers_count ) :
     ctx( NULL ),
     device_handle( NULL ),
     endpoint_from_hst_num( endpoint_invalid ),
     endpoint_from_dev_num( endpoint_invalid ),
     event_loop_running( false ),
     buffers_count( dev_buffers_count ),
+    spare_count( spare_buffers_count ),
     half_full_size8( one_block_size8 ),
+    buf_pool( NULL ),
+    pool_exhausted_count( 0 ),
+    stream_offset8( 0 ),
+    done_transfers( 0 ),
+    failed_transfers( 0 ),
+    first_done_ns( 0 ),
+    first_done_size8( 0 ),
+    last_done_ns( 0 ),
+    interval_sum_ms( 0.0 ),
+    interval_sq_sum_ms( 0.0 ),
+    interval_max_ms( 0.0 ),
     write_transfer( NULL ),
     write_buffer( NULL ),
     data_handler( NULL ),
@@ -32,11 +46,13 @@ FX3Dev::FX3Dev( size_t one_block_size8, uint32_t dev_buffers_count ) :
         fprintf( stderr, "FX3Dev::FX3Dev __warning__ dev_buffers_count (%u) changed to %d\n", dev_buffers_count, buffers_count );
     }
     transfers.resize( buffers_count );
-    
-    half_full_buffers.resize( buffers_count );
+    transfer_ctxs.resize( buffers_count );
     for( uint32_t i = 0; i < buffers_count; i++ ) {
-        half_full_buffers[ i ] = new uint8_t[ half_full_size8 ];
+        transfer_ctxs[ i ].self  = this;
+        transfer_ctxs[ i ].block = NULL;
     }
+
+    buf_pool = DataBlockPool::Create( half_full_size8, buffers_count + spare_count );
     write_buffer = new uint8_t[ half_full_size8 ];
 }
 
@@ -58,9 +74,7 @@ FX3Dev::~FX3Dev() {
         libusb_exit( ctx );
     }
     
-    for( uint32_t i = 0; i < buffers_count; i++ ) {
-        delete [] half_full_buffers[ i ];
-    }
+    buf_pool->Dispose();
     if ( write_buffer ) {
         delete[] write_buffer;
     }
@@ -539,6 +553,16 @@ fx3_dev_err_t FX3Dev::sendDataToDeviceASynch(uint8_t* data, uint32_t size8) {
 void FX3Dev::startRead( DeviceDataHandlerIfce* handler ) {
     fprintf(stderr,"FX3Dev::startRead()\n");
     size_tx_mb = 0.0;
+    stream_offset8 = 0;
+    pool_exhausted_count = 0;
+    done_transfers     = 0;
+    failed_transfers   = 0;
+    first_done_ns      = 0;
+    first_done_size8   = 0;
+    last_done_ns       = 0;
+    interval_sum_ms    = 0.0;
+    interval_sq_sum_ms = 0.0;
+    interval_max_ms    = 0.0;
     
     int res;
     for(uint32_t i = 0;i<buffers_count;i++) {
@@ -550,8 +574,9 @@ void FX3Dev::startRead( DeviceDataHandlerIfce* handler ) {
     }
 
     for(uint32_t i = 0;i<buffers_count;i++) {
-        libusb_fill_bulk_transfer(transfers[i], device_handle, (endpoint_from_dev_num | LIBUSB_ENDPOINT_IN), half_full_buffers[i],
-                                  half_full_size8, FX3Dev::onDataReady, this, DEV_DOWNLOAD_TIMEOUT_MS);
+        transfer_ctxs[i].block = buf_pool->Acquire();
+        libusb_fill_bulk_transfer(transfers[i], device_handle, (endpoint_from_dev_num | LIBUSB_ENDPOINT_IN), transfer_ctxs[i].block->data,
+                                  half_full_size8, FX3Dev::onDataReady, &transfer_ctxs[i], DEV_DOWNLOAD_TIMEOUT_MS);
     }
     
     data_handler = handler;
@@ -569,6 +594,7 @@ void FX3Dev::startRead( DeviceDataHandlerIfce* handler ) {
 
 void FX3Dev::event_loop( void ) {
     fprintf( stderr, "FX3Dev::read_loop() started\n" );
+    pipe_thread_setup( PipeThread_Usb );
     while(event_loop_running) {
         struct timeval tv  = { 0, DEV_DOWNLOAD_TIMEOUT_MS * 1000 };
         int res = libusb_handle_events_timeout_completed( NULL, &tv, NULL );
@@ -598,48 +624,118 @@ void FX3Dev::stopRead() {
         
         for(uint32_t i = 0;i<buffers_count;i++) {
             libusb_free_transfer(transfers[i]);
+            if ( transfer_ctxs[i].block ) {
+                transfer_ctxs[i].block->Release();
+                transfer_ctxs[i].block = NULL;
+            }
         }
         
+        if ( pool_exhausted_count ) {
+            fprintf( stderr, "FX3Dev::stopRead() no spare buffer for %llu blocks, they were copied\n", ( unsigned long long ) pool_exhausted_count );
+        }
         data_handler = NULL;
         fprintf( stderr, "FX3Dev::stopRead() all done!\n" );    
     }
 }
 
 void LIBUSB_CALL FX3Dev::onDataReady( libusb_transfer* xfr ) {
-    FX3Dev *self = (FX3Dev *) xfr->user_data;
+    TransferCtx* ctx = (TransferCtx *) xfr->user_data;
+    FX3Dev *self = ctx->self;
     switch(xfr->status) {
-        case LIBUSB_TRANSFER_COMPLETED:
-            libusb_submit_transfer(xfr);
+        case LIBUSB_TRANSFER_COMPLETED: {
+            DataBlock* done = ctx->block;
+            DataBlock* next = self->buf_pool->Acquire();
+            done->size8 = xfr->actual_length;
+            done->info.host_time_ns   = StreamHostTimeNs();
+            done->info.stream_offset8 = self->stream_offset8;
+            self->countTransfer( done->info.host_time_ns, xfr->actual_length );
+            self->stream_offset8 += xfr->actual_length;
             self->size_tx_mb += ( double ) xfr->actual_length / ( 1024.0 * 1024.0 );
-            if ( self->data_handler ) {
-                self->data_handler->HandleDeviceData( (short*) xfr->buffer, xfr->actual_length );
+            if ( next ) {
+                // Hand filled buffer to handler and continue with the free one
+                ctx->block = next;
+                xfr->buffer = next->data;
+                libusb_submit_transfer(xfr);
+                if ( self->data_handler ) {
+                    self->data_handler->HandleDeviceBlock( done );
+                }
+                done->Release();
+            } else {
+                // All spare buffers are still held by handler, it has to copy data
+                self->pool_exhausted_count++;
+                if ( self->data_handler ) {
+                    self->data_handler->HandleDeviceDataEx( done->data, done->size8, done->info );
+                }
+                libusb_submit_transfer(xfr);
             }
             break;
+        }
         case LIBUSB_TRANSFER_CANCELLED:
             fprintf( stderr,"FX3Dev::onDataReady(): __warning__ LIBUSB_TRANSFER_CANCELLED\n" );
             break;
         case LIBUSB_TRANSFER_NO_DEVICE:
+            self->failed_transfers++;
             fprintf( stderr,"FX3Dev::onDataReady(): __error__ LIBUSB_TRANSFER_NO_DEVICE\n" );
             break;
         case LIBUSB_TRANSFER_TIMED_OUT:
+            self->failed_transfers++;
             fprintf( stderr,"FX3Dev::onDataReady(): __error__ LIBUSB_TRANSFER_TIMED_OUT\n" );
             break;
         case LIBUSB_TRANSFER_ERROR:
+            self->failed_transfers++;
             fprintf( stderr,"FX3Dev::onDataReady(): __error__ LIBUSB_TRANSFER_ERROR\n" );
             break;
         case LIBUSB_TRANSFER_STALL:
+            self->failed_transfers++;
             fprintf( stderr,"FX3Dev::onDataReady(): __error__ LIBUSB_TRANSFER_STALL\n" );
             break;
         case LIBUSB_TRANSFER_OVERFLOW:
+            self->failed_transfers++;
             fprintf( stderr,"FX3Dev::onDataReady(): __error__ LIBUSB_TRANSFER_OVERFLOW\n" );
             break;
 
         default:
+            self->failed_transfers++;
             fprintf( stderr,"FX3Dev::onDataReady(): __error__ unknown xfr->status %d\n", xfr->status );
     }
     
 }
 
+void FX3Dev::countTransfer( int64_t done_ns, size_t size8 ) {
+    if ( done_transfers == 0 ) {
+        first_done_ns    = done_ns;
+        first_done_size8 = size8;
+    } else {
+        double interval_ms = ( done_ns - last_done_ns ) / 1.0e6;
+        interval_sum_ms    += interval_ms;
+        interval_sq_sum_ms += interval_ms * interval_ms;
+        if ( interval_ms > interval_max_ms ) {
+            interval_max_ms = interval_ms;
+        }
+    }
+    last_done_ns = done_ns;
+    done_transfers++;
+}
+
+fx3_stream_stats_t FX3Dev::GetStreamStats() const {
+    fx3_stream_stats_t stats;
+    stats.transfers        = done_transfers;
+    stats.bytes            = stream_offset8;
+    stats.failed_transfers = failed_transfers;
+    stats.copied_blocks    = pool_exhausted_count;
+    stats.seconds          = ( last_done_ns - first_done_ns ) / 1.0e9;
+    if ( done_transfers > 1 ) {
+        double n = ( double ) ( done_transfers - 1 );
+        stats.interval_avg_ms = interval_sum_ms / n;
+        stats.interval_max_ms = interval_max_ms;
+        double var = interval_sq_sum_ms / n - stats.interval_avg_ms * stats.interval_avg_ms;
+        stats.jitter_ms = var > 0.0 ? sqrt( var ) : 0.0;
+        // first transfer was received before first_done_ns
+        stats.bytes -= first_done_size8;
+    }
+    return stats;
+}
+
 void FX3Dev::onWriteReady(libusb_transfer* xfr) {
     switch(xfr->status) {
         case LIBUSB_TRANSFER_COMPLETED:
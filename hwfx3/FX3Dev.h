@@ -25,17 +25,41 @@ extern "C" {
 #include <vector>
 
 
+// Transfer statistics since last startRead (see FX3Dev::GetStreamStats)
+struct fx3_stream_stats_t {
+    uint64_t transfers;         // completed transfers
+    uint64_t bytes;
+    uint64_t failed_transfers;  // transfers finished with error (timeout, overflow, ...)
+    uint64_t copied_blocks;     // no spare buffer was free, handler had to copy data
+    double   seconds;           // from first to last completed transfer
+    double   interval_avg_ms;   // between two completed transfers
+    double   interval_max_ms;
+    double   jitter_ms;         // standard deviation of interval
+
+    fx3_stream_stats_t() :
+        transfers( 0 ), bytes( 0 ), failed_transfers( 0 ), copied_blocks( 0 ),
+        seconds( 0.0 ), interval_avg_ms( 0.0 ), interval_max_ms( 0.0 ), jitter_ms( 0.0 )
+    {}
+
+    double MBytesPerSec() const {
+        return seconds > 0.0 ? bytes / ( 1024.0 * 1024.0 ) / seconds : 0.0;
+    }
+};
 
 /*
  * Find, opens and flash FX3 device.
  * 1. Create with new FX3Dev( size ) and set block size.
  * 2. Start device reading and set handler class.
  *    You will receive data continuously block by block with size you set in constructor,
- *    The handler's function HandleDeviceData will be called - you must copy data and return from function as fast as possible.
+ *    The handler's function HandleDeviceBlock will be called with the completed transfer buffer.
+ *    Handler may keep the block (AddRef) and release it later - the transfer is resubmitted with
+ *    another free buffer from the pool of buffers_count + spare_buffers_count buffers.
+ *    If all spare buffers are held by handler, HandleDeviceData is called instead and you must copy data.
  *    If you have errors of skipping data you should do one or more of the following:
  *      a) increase block size (which is set in constructor)
- *      b) increase buffers_count (which is set in constructor)
- *      c) Just copy data and return in HandleDeviceData function! Do not do any signal processing there!
+ *      b) increase buffers_count or spare_buffers_count (which are set in constructor)
+ *      c) Just take the block and return in HandleDeviceBlock function! Do not do any signal processing there!
+ *    FX3UsbTuner (fx3usbtuner.h) measures a and b on this host and stores the best values in FX3Config.
  * 
  * 3. Stop reading. (not tested)
  * 4. Destroy FX3Dev 
@@ -43,7 +67,7 @@ extern "C" {
 class FX3Dev : public FX3DevIfce {
 public:
 
-    FX3Dev( size_t one_block_size8 = (3072 * 1250), uint32_t dev_buffers_count = 2 );
+    FX3Dev( size_t one_block_size8 = (3072 * 1250), uint32_t dev_buffers_count = 2, uint32_t spare_buffers_count = 18 );
     virtual ~FX3Dev();
 
     // **** overrides FX3DevIfce
@@ -53,6 +77,9 @@ public:
     void sendAttCommand5bits( uint32_t bits );
     fx3_dev_debug_info_t getDebugInfoFromBoard( bool ask_speed_only = false );
     // ****
+
+    // Values are exact after stopRead, while reading they may be slightly inconsistent
+    fx3_stream_stats_t GetStreamStats() const;
 protected:
     fx3_dev_err_t ctrlToDevice(   uint8_t cmd, uint16_t value = 0, uint16_t index = 0, void* data = nullptr, size_t data_len = 0 );
     fx3_dev_err_t ctrlFromDevice( uint8_t cmd, uint16_t value = 0, uint16_t index = 0, void* dest = nullptr, size_t data_len = 0 );
@@ -113,9 +140,29 @@ private:
     void event_loop(void);
     
     uint32_t buffers_count; // Number of buffers which is used for continuous data transfer from device
+    uint32_t spare_count;   // Number of additional buffers which can be held by data handler
     size_t half_full_size8;     // Size of one transfer block (data from device to host)
     std::vector< struct libusb_transfer* > transfers;
-    std::vector< uint8_t* > half_full_buffers;
+
+    struct TransferCtx {
+        FX3Dev*    self;
+        DataBlock* block;  // buffer which is currently owned by transfer
+    };
+    std::vector< TransferCtx > transfer_ctxs;
+    DataBlockPool* buf_pool;
+    uint64_t pool_exhausted_count;
+    uint64_t stream_offset8;    // bytes received since startRead
+
+    // onDataReady timing, see fx3_stream_stats_t
+    uint64_t done_transfers;
+    uint64_t failed_transfers;
+    int64_t  first_done_ns;
+    size_t   first_done_size8;
+    int64_t  last_done_ns;
+    double   interval_sum_ms;
+    double   interval_sq_sum_ms;
+    double   interval_max_ms;
+    void countTransfer( int64_t done_ns, size_t size8 );
     
     struct libusb_transfer* write_transfer;
     uint8_t* write_buffer;
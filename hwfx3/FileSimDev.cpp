@@ -1,55 +1,65 @@
 #include "FileSimDev.h"
+#include <cstdio>
+#include <chrono>
+#include "util/ThreadConfig.h"
 
-#ifdef WIN32
-#include <windows.h>
-#else
-#include <unistd.h>
+#ifndef WIN32
+#include <cerrno>
+#include <ctime>
 #endif
 
+const double FileSimDev::MIN_RATE = 0.1;
+const double FileSimDev::MAX_RATE = 10.0;
 
-int fseek_cross( FILE* f, int64_t offset, int origin ) {
-#ifdef WIN32
-    return _fseeki64( f, offset, origin );
-#else
-    return fseek( f, offset, origin );
-#endif
-}
+#define FILESIM_IDLE_NS   ( 10 * 1000 * 1000LL )
+#define FILESIM_WAKE_NS   ( 100 * 1000 * 1000LL )     // need_exit is checked while sleeping
+#define FILESIM_RESYNC_NS ( 1000 * 1000 * 1000LL )    // behind more than this - don't catch up
+#define FILESIM_WAIT_MS   ( 100 )                     // running is checked while handler is full
 
-int64_t ftell_cross( FILE* f ) {
-#ifdef WIN32
-    return _ftelli64( f );
-#else
-    return ftell( f );
-#endif
-}
-
-
-
-FileSimDev::FileSimDev(const char *sigfname, double real_sr, size_t pts_cnt_per_block) :
+FileSimDev::FileSimDev(const char *sigfname, double real_sr, size_t block_size8, uint32_t bytes_per_point) :
     cb_handle( NULL ),
-    file( NULL ),
+    is_open( false ),
+    is_capture( false ),
     SR( real_sr ),
-    block_pts( pts_cnt_per_block ),
-    sleep_ms( ( ( double ) pts_cnt_per_block / real_sr ) * 1000.0 ),
-    current_offset8( 0 ),
-    file_size8( 0 ),
-    buf_file( NULL ),
+    block_pts( 1 ),
+    bytes_per_point( bytes_per_point ? bytes_per_point : 1 ),
+    current_pt( 0 ),
+    rate( 1.0 ),
+    seek_pt( -1 ),
+    loop_begin_pt( 0 ),
+    loop_end_pt( 0 ),
+    late_blocks( 0 ),
+    stream_offset8( 0 ),
     running ( false ),
     need_exit( false )
 
 {
-    file = fopen( sigfname, "rb" );
-    if ( file ) {
-        fprintf( stderr, "FileSimDev::FileSimDev() file was opened\n" );
-        fseek_cross( file, 0, SEEK_END );
-        file_size8 = ftell_cross( file );
-        fseek_cross( file, 0, SEEK_SET );
-        fprintf( stderr, "FileSimDev::FileSimDev() file size %lld bytes\n", file_size8 );
-        fprintf( stderr, "FileSimDev::FileSimDev() sleep pause = %u ms\n", sleep_ms );
+    is_capture = map.Open( sigfname );
+    is_open = is_capture || map.OpenRaw( sigfname, this->bytes_per_point );
+    if ( is_open ) {
+        const CaptureHeader& hdr = map.Header();
+        this->bytes_per_point = hdr.bytes_per_point;
+        fprintf( stderr, "FileSimDev::FileSimDev() file was opened, %llu points of %u bytes\n",
+                 ( unsigned long long ) map.Points(), hdr.bytes_per_point );
+        if ( is_capture ) {
+            fprintf( stderr, "FileSimDev::FileSimDev() capture: adc type %u, %u chans, SR %.0f Hz, IF %.0f Hz, %llu gaps%s\n",
+                     hdr.adc_type, hdr.chan_count, hdr.sample_rate_hz, hdr.inter_freq_hz,
+                     ( unsigned long long ) hdr.drops_count, hdr.compression ? ", compressed" : "" );
+            if ( hdr.sample_rate_hz != real_sr ) {
+                fprintf( stderr, "__warning__ FileSimDev::FileSimDev() capture was recorded at %.0f Hz, replayed at %.0f Hz\n",
+                         hdr.sample_rate_hz, real_sr );
+            }
+        }
     } else {
         fprintf( stderr, "__error__ FileSimDev::FileSimDev() file IO error \n" );
     }
-    buf_file = new int8_t[ block_pts ];
+    // block holds whole points
+    block_pts = block_size8 / this->bytes_per_point;
+    if ( block_pts == 0 ) {
+        block_pts = 1;
+    }
+    fprintf( stderr, "FileSimDev::FileSimDev() block %u points, %.3f ms\n",
+             ( unsigned ) block_pts, SR > 0.0 ? 1000.0 * block_pts / SR : 0.0 );
     thr = std::thread( &FileSimDev::run, this );
 }
 
@@ -59,43 +69,119 @@ FileSimDev::~FileSimDev() {
     if ( thr.joinable() ) {
         thr.join();
     }
+    map.Close();
+}
 
-    if ( file ) {
-        fclose( file );
-        file = NULL;
-    }
-    if ( buf_file ) {
-        delete [] buf_file;
-        buf_file = NULL;
+bool FileSimDev::sleepUntil(int64_t deadline_ns) {
+    for ( ;; ) {
+        if ( need_exit ) {
+            return false;
+        }
+        int64_t now = StreamHostTimeNs();
+        if ( now >= deadline_ns ) {
+            return true;
+        }
+        int64_t wake = deadline_ns - now > FILESIM_WAKE_NS ? now + FILESIM_WAKE_NS : deadline_ns;
+#ifdef WIN32
+        std::this_thread::sleep_until( std::chrono::steady_clock::time_point(
+                                           std::chrono::duration_cast< std::chrono::steady_clock::duration >(
+                                               std::chrono::nanoseconds( wake ) ) ) );
+#else
+        // steady_clock is CLOCK_MONOTONIC, absolute deadline has no drift of relative sleeps
+        struct timespec ts;
+        ts.tv_sec  = ( time_t ) ( wake / 1000000000LL );
+        ts.tv_nsec = ( long ) ( wake % 1000000000LL );
+        while ( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL ) == EINTR ) {
+        }
+#endif
     }
 }
 
 void FileSimDev::run() {
+    pipe_thread_setup( PipeThread_FileSim );
+    bool paced = false;
+    int64_t base_ns = 0;        // pacing start
+    uint64_t base_pts = 0;      // points sent since base_ns
+    double base_rate = 0.0;
     while ( !need_exit ) {
-        #ifdef WIN32
-        Sleep( sleep_ms );
-        #else
-        usleep( sleep_ms * 1000 );
-        #endif
-        if ( running ) {
-            if ( file_size8 < current_offset8 + block_pts ) {
-                current_offset8 = 0;
-                fseek_cross( file, 0, SEEK_SET );
-            }
-            //fprintf( stderr, "current_offset8 %12lld, %5.0f ms\n", current_offset8, 1000.0 * ((double)current_offset8/1) / SR );
-            fread( buf_file, 1, block_pts, file );
-            current_offset8 += block_pts;
+        if ( !running || !is_open || map.Points() == 0 ) {
+            paced = false;
+            sleepUntil( StreamHostTimeNs() + FILESIM_IDLE_NS );
+            continue;
+        }
+
+        uint64_t points = map.Points();
+        uint64_t begin = loop_begin_pt;
+        uint64_t end   = loop_end_pt;
+        if ( end == 0 || end > points ) {
+            end = points;
+        }
+        if ( begin >= end ) {
+            begin = 0;
+        }
+        int64_t seek = seek_pt.exchange( -1 );
+        if ( seek >= 0 ) {
+            current_pt = ( uint64_t ) seek;
+        }
+        if ( current_pt < begin || current_pt >= end ) {
+            current_pt = begin;
+        }
+        // last block of loop is shorter, so the loop range is replayed exactly
+        size_t pts = end - current_pt < block_pts ? ( size_t ) ( end - current_pt ) : block_pts;
 
-            if ( cb_handle ) {
-                cb_handle->HandleDeviceData( buf_file, block_pts );
+        double r = rate;
+        if ( r > 0.0 && SR > 0.0 ) {
+            int64_t now = StreamHostTimeNs();
+            if ( !paced || r != base_rate ) {
+                paced     = true;
+                base_ns   = now;
+                base_pts  = 0;
+                base_rate = r;
+            }
+            // block is sent when its last point would come from device
+            int64_t deadline = base_ns + ( int64_t ) ( ( base_pts + pts ) * 1.0e9 / ( SR * r ) );
+            if ( now > deadline ) {
+                late_blocks++;
+                if ( now - deadline > FILESIM_RESYNC_NS ) {
+                    base_ns  = now;
+                    base_pts = 0;
+                }
+            } else if ( !sleepUntil( deadline ) ) {
+                break;
             }
+            base_pts += pts;
+        } else {
+            paced = false;
+            // as fast as handler takes data: wait for its queue instead of overrunning it
+            while ( cb_handle && running && !need_exit &&
+                    !cb_handle->WaitForSpace( pts * bytes_per_point, FILESIM_WAIT_MS ) ) {
+            }
+        }
+
+        const uint8_t* data = map.Raw( current_pt, pts );
+        if ( !data ) {
+            fprintf( stderr, "__error__ FileSimDev::run() can't read %u points at %llu\n",
+                     ( unsigned ) pts, ( unsigned long long ) current_pt );
+            running = false;
+            continue;
+        }
+        current_pt += pts;
+
+        size_t size8 = pts * bytes_per_point;
+        if ( cb_handle ) {
+            StreamBlockInfo info;
+            info.host_time_ns   = StreamHostTimeNs();
+            info.stream_offset8 = stream_offset8;
+            // router copies data, mapping is read-only
+            cb_handle->HandleDeviceDataEx( ( void* ) data, size8, info );
         }
+        stream_offset8 += size8;
     }
 }
 
 
 fx3_dev_err_t FileSimDev::init(const char*, const char*) {
-    if ( file ) {
+    if ( is_open ) {
         return FX3_ERR_OK;
     } else {
         return FX3_ERR_BAD_DEVICE;
@@ -105,13 +191,67 @@ fx3_dev_err_t FileSimDev::init(const char*, const char*) {
 void FileSimDev::startRead(DeviceDataHandlerIfce *handler) {
     if ( !running ) {
         cb_handle = handler;
-        current_offset8 = 0;
+        stream_offset8 = 0;
+        late_blocks = 0;
+        seek_pt = ( int64_t ) loop_begin_pt;
         running = true;
     }
 }
 
 void FileSimDev::stopRead() {
     running = false;
+    if ( late_blocks ) {
+        fprintf( stderr, "FileSimDev::stopRead() %llu blocks were sent late\n", ( unsigned long long ) late_blocks );
+    }
+}
+
+bool FileSimDev::IsCapture() const {
+    return is_capture;
+}
+
+const CaptureHeader& FileSimDev::GetCaptureHeader() const {
+    return map.Header();
+}
+
+void FileSimDev::SeekPoint(uint64_t file_pt) {
+    if ( file_pt > map.Points() ) {
+        file_pt = map.Points();
+    }
+    seek_pt = ( int64_t ) file_pt;
+}
+
+void FileSimDev::SeekSeconds(double seconds) {
+    SeekPoint( secondsToPoint( seconds ) );
+}
+
+void FileSimDev::SetRate(double r) {
+    if ( r <= 0.0 ) {
+        r = 0.0;
+    } else if ( r < MIN_RATE || r > MAX_RATE ) {
+        fprintf( stderr, "__warning__ FileSimDev::SetRate() %.2f is out of %.1f..%.1f\n", r, MIN_RATE, MAX_RATE );
+        r = r < MIN_RATE ? MIN_RATE : MAX_RATE;
+    }
+    rate = r;
+}
+
+void FileSimDev::SetLoopPoints(uint64_t begin_pt, uint64_t end_pt) {
+    loop_begin_pt = begin_pt;
+    loop_end_pt   = end_pt;
+}
+
+void FileSimDev::SetLoopSeconds(double begin_s, double end_s) {
+    SetLoopPoints( secondsToPoint( begin_s ), end_s > 0.0 ? secondsToPoint( end_s ) : 0 );
+}
+
+uint64_t FileSimDev::LateBlocks() const {
+    return late_blocks;
+}
+
+uint64_t FileSimDev::secondsToPoint(double seconds) const {
+    if ( seconds <= 0.0 ) {
+        return 0;
+    }
+    return is_capture ? map.Reader().TimeToPoint( seconds ) : ( uint64_t ) ( seconds * SR );
 }
 
 void FileSimDev::sendAttCommand5bits(uint32_t) {
@@ -123,4 +263,3 @@ fx3_dev_debug_info_t FileSimDev::getDebugInfoFromBoard(bool ask_speed_only) {
     info.status = FX3_ERR_REG_WRITE_FAIL;
     return info;
 }
-
@@ -2,12 +2,24 @@
 #define FILESIMDEV_H
 
 #include "fx3devifce.h"
+#include "datastreams/capturemap.h"
 #include <thread>
+#include <atomic>
 
+/*
+ * Replays a recording as a device. File is memory-mapped (CaptureMap), blocks are sent at
+ * absolute deadlines computed from points sent, so sleep errors don't add up and the rate
+ * holds for any block size. Rate multiplier scales time, 0 sends as fast as handler takes
+ * data (pipeline benchmarks). Playback loops over [loop begin, loop end).
+ */
 class FileSimDev : public FX3DevIfce
 {
 public:
-    FileSimDev( const char* sigfname, double real_sr, size_t block_pts );
+    static const double MIN_RATE;
+    static const double MAX_RATE;
+
+    // bytes_per_point is used for headerless data only, capture has it in header
+    FileSimDev( const char* sigfname, double real_sr, size_t block_size8, uint32_t bytes_per_point = 1 );
     ~FileSimDev();
 
     fx3_dev_err_t init(const char *firmwareFileName, const char *additionalFirmwareFileName);
@@ -16,24 +28,48 @@ public:
     void sendAttCommand5bits(uint32_t bits);
     fx3_dev_debug_info_t getDebugInfoFromBoard( bool ask_speed_only = false );
 
+    // Capture file (capturefile.h) or headerless data. Seek is applied before the next block.
+    bool IsCapture() const;
+    const CaptureHeader& GetCaptureHeader() const;
+    void SeekPoint( uint64_t file_pt );
+    void SeekSeconds( double seconds );
+
+    // 1.0 - real time, clamped to MIN_RATE..MAX_RATE, 0 - no pacing
+    void SetRate( double rate );
+    // end_pt 0 - end of data
+    void SetLoopPoints( uint64_t begin_pt, uint64_t end_pt );
+    void SetLoopSeconds( double begin_s, double end_s );
+    // Blocks which were sent after their deadline (handler or disk is too slow)
+    uint64_t LateBlocks() const;
+
 protected:
     virtual fx3_dev_err_t ctrlToDevice(   uint8_t cmd, uint16_t value = 0, uint16_t index = 0, void* data = nullptr, size_t data_len = 0 ) { return FX3_ERR_OK; }
     virtual fx3_dev_err_t ctrlFromDevice( uint8_t cmd, uint16_t value = 0, uint16_t index = 0, void* dest = nullptr, size_t data_len = 0 ) { return FX3_ERR_OK; }
 
 
 private:
+    uint64_t secondsToPoint( double seconds ) const;
+    // false if need_exit was set while sleeping
+    bool sleepUntil( int64_t deadline_ns );
+
     DeviceDataHandlerIfce *cb_handle;
-    FILE* file;
+    CaptureMap map;
+    bool is_open;
+    bool is_capture;
 
     double SR;
-    int64_t block_pts;
-    uint32_t sleep_ms;
-    int64_t current_offset8;
-    int64_t file_size8;
-    int8_t*  buf_file;
-
-    bool running;
-    bool need_exit;
+    size_t block_pts;
+    uint32_t bytes_per_point;
+    uint64_t current_pt;
+    std::atomic<double> rate;
+    std::atomic<int64_t> seek_pt;       // -1 - no seek
+    std::atomic<uint64_t> loop_begin_pt;
+    std::atomic<uint64_t> loop_end_pt;
+    std::atomic<uint64_t> late_blocks;
+    uint64_t stream_offset8;    // bytes sent since startRead, does not wrap with the file
+
+    std::atomic<bool> running;
+    std::atomic<bool> need_exit;
     std::thread thr;
     void run();
 
@@ -3,6 +3,10 @@
 
 #include "fx3devdrvtype.h"
 #include <string>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
 
 // ITs FX3
 // GPS L1   = 1575.42 MHz
@@ -26,6 +30,15 @@
 #define DEF_FW_NAME "fx3_att_dbg.img"
 //#define DEF_FW_NAME "D:\\work\\SlaveFifoSyncKeldush\\Release\\SlaveFifoSync.img"
 
+// Result of FX3UsbTuner for this host, read at start
+#define USB_TUNE_FILE_NAME "fx3_usb_tune.cfg"
+
+// Result of "--fft-bench" for this host, read at start before settings file
+#define FFT_TUNE_FILE_NAME "fx3_fft_tune.cfg"
+
+// Stream, dump and FFT settings, "key value" per line, '#' starts comment (FX3Config::SetValue)
+#define SETTINGS_FILE_NAME "fx3_settings.cfg"
+
 enum ADCType {
     ADC_NT1065,
     ADC_NT1065_File,
@@ -56,6 +69,53 @@ struct FX3Config {
     bool auto_start_streams;
     int hacked_len = 0;
 
+    // StreamRouter input queue: depth in blocks, one block size and overrun policy
+    int    router_queue_depth  = 16;
+    size_t router_block_size8  = 4 * 1024 * 1024;
+    bool   router_drop_oldest  = true;
+    int    router_worker_depth = 4;     // queue of every lossless handler (blocks)
+
+    // Device read buffers: transfer size, transfers in flight and spare buffers held by router (FX3Dev)
+    size_t usb_block_size8      = 3072 * 1250;
+    int    usb_buffers_count    = 2;
+    int    usb_spare_count      = 18;
+    size_t filesim_block_size8  = 4 * 1024 * 1024;
+
+    // FileSimDev replay: rate multiplier (0 - as fast as possible) and loop range, end 0 - end of file
+    double filesim_rate         = 1.0;
+    double filesim_loop_begin_s = 0.0;
+    double filesim_loop_end_s   = 0.0;
+
+    // StreamDumper disk writer (AsyncWriterOptions)
+    size_t   dump_buffer_size8    = 32 * 1024 * 1024;
+    int      dump_buffers_count   = 2;
+    bool     dump_direct_io       = false;
+    uint64_t dump_prealloc_size8  = 0;
+    bool     dump_use_uring       = false;  // continuous "All ADC data" recording by StreamUringDumper
+    int      dump_compress_threads = 2;     // packing threads of compressed capture
+
+    // StreamDumper segments (DumpSegmentOptions), 0 - no limit
+    uint64_t dump_segment_size8   = 0;
+    double   dump_segment_seconds = 0.0;
+    uint32_t dump_keep_segments   = 0;
+
+    // Flight recorder (StreamFlightRecorder), off if flight_pre_seconds is 0
+    double      flight_pre_seconds      = 0.0;
+    double      flight_post_seconds     = 2.0;
+    uint64_t    flight_max_ram8         = 1024ull * 1024 * 1024;
+    std::string flight_file_prefix      = "flight";
+    float       flight_spectrum_trigger = 0.0f;     // SpectrumForm power which triggers recorder, 0 - off
+    float       flight_trigger_rearm    = 3.0f;     // trigger is armed again when power falls this much below it
+    double      flight_trigger_holdoff_s = 10.0;    // minimal time between spectrum triggers
+
+    // FFTW plans (fftplans.h): planner effort 0 - estimate, 1 - measure, 2 - patient, wisdom is kept in file
+    int         fft_planner_effort = 1;
+    std::string fft_wisdom_file    = "fftw_wisdom.dat";
+    // FFTW threads for transforms of fft_threads_min_size points and more, 1 - single-threaded.
+    // Crossover depends on CPU, "--fft-bench" measures it and saves to FFT_TUNE_FILE_NAME.
+    int         fft_threads          = 1;
+    int         fft_threads_min_size = 32768;
+
     FX3Config() :
         adc_type( ADC_1ch_16bit ),
         drv_type( DrvTypeLibUsb ),
@@ -82,6 +142,150 @@ struct FX3Config {
         }
     }
 
+    // Reads usb_* values saved by SaveUsbTune, returns false if there is no file
+    bool LoadUsbTune( const char* fname = USB_TUNE_FILE_NAME ) {
+        FILE* f = fopen( fname, "r" );
+        if ( !f ) {
+            return false;
+        }
+        char key[ 64 ];
+        unsigned long long val;
+        while ( fscanf( f, "%63s %llu", key, &val ) == 2 ) {
+            if ( strcmp( key, "usb_block_size8" ) == 0 ) {
+                usb_block_size8 = ( size_t ) val;
+            } else if ( strcmp( key, "usb_buffers_count" ) == 0 ) {
+                usb_buffers_count = ( int ) val;
+            } else if ( strcmp( key, "usb_spare_count" ) == 0 ) {
+                usb_spare_count = ( int ) val;
+            }
+        }
+        fclose( f );
+        fprintf( stderr, "FX3Config: usb tune from %s: block %llu bytes, %d transfers, %d spare\n", fname,
+                 ( unsigned long long ) usb_block_size8, usb_buffers_count, usb_spare_count );
+        return true;
+    }
+
+    static bool parseBool( const char* val ) {
+        return strcmp( val, "true" ) == 0 || strcmp( val, "on" ) == 0 || atoi( val ) != 0;
+    }
+
+    bool SaveUsbTune( const char* fname = USB_TUNE_FILE_NAME ) const {
+        FILE* f = fopen( fname, "w" );
+        if ( !f ) {
+            fprintf( stderr, "__error__ FX3Config::SaveUsbTune() can't open '%s'\n", fname );
+            return false;
+        }
+        fprintf( f, "usb_block_size8 %llu\n", ( unsigned long long ) usb_block_size8 );
+        fprintf( f, "usb_buffers_count %d\n", usb_buffers_count );
+        fprintf( f, "usb_spare_count %d\n", usb_spare_count );
+        fclose( f );
+        return true;
+    }
+
+    // Crossover measured by "--fft-bench", LoadSettings( FFT_TUNE_FILE_NAME ) reads it
+    bool SaveFftTune( const char* fname = FFT_TUNE_FILE_NAME ) const {
+        FILE* f = fopen( fname, "w" );
+        if ( !f ) {
+            fprintf( stderr, "__error__ FX3Config::SaveFftTune() can't open '%s'\n", fname );
+            return false;
+        }
+        fprintf( f, "fft_threads_min_size %d\n", fft_threads_min_size );
+        fclose( f );
+        return true;
+    }
+
+    // Sets field by its settings name, returns false for unknown key
+    bool SetValue( const char* key, const char* val ) {
+        if ( strcmp( key, "router_queue_depth" ) == 0 ) {
+            router_queue_depth = atoi( val );
+        } else if ( strcmp( key, "router_block_size8" ) == 0 ) {
+            router_block_size8 = ( size_t ) strtoull( val, NULL, 10 );
+        } else if ( strcmp( key, "router_drop_oldest" ) == 0 ) {
+            router_drop_oldest = parseBool( val );
+        } else if ( strcmp( key, "router_worker_depth" ) == 0 ) {
+            router_worker_depth = atoi( val );
+        } else if ( strcmp( key, "filesim_rate" ) == 0 ) {
+            filesim_rate = atof( val );
+        } else if ( strcmp( key, "filesim_loop_begin_s" ) == 0 ) {
+            filesim_loop_begin_s = atof( val );
+        } else if ( strcmp( key, "filesim_loop_end_s" ) == 0 ) {
+            filesim_loop_end_s = atof( val );
+        } else if ( strcmp( key, "dump_buffer_size8" ) == 0 ) {
+            dump_buffer_size8 = ( size_t ) strtoull( val, NULL, 10 );
+        } else if ( strcmp( key, "dump_buffers_count" ) == 0 ) {
+            dump_buffers_count = atoi( val );
+        } else if ( strcmp( key, "dump_direct_io" ) == 0 ) {
+            dump_direct_io = parseBool( val );
+        } else if ( strcmp( key, "dump_prealloc_size8" ) == 0 ) {
+            dump_prealloc_size8 = strtoull( val, NULL, 10 );
+        } else if ( strcmp( key, "dump_use_uring" ) == 0 ) {
+            dump_use_uring = parseBool( val );
+        } else if ( strcmp( key, "dump_compress_threads" ) == 0 ) {
+            dump_compress_threads = atoi( val );
+        } else if ( strcmp( key, "dump_segment_size8" ) == 0 ) {
+            dump_segment_size8 = strtoull( val, NULL, 10 );
+        } else if ( strcmp( key, "dump_segment_seconds" ) == 0 ) {
+            dump_segment_seconds = atof( val );
+        } else if ( strcmp( key, "dump_keep_segments" ) == 0 ) {
+            dump_keep_segments = ( uint32_t ) strtoul( val, NULL, 10 );
+        } else if ( strcmp( key, "flight_pre_seconds" ) == 0 ) {
+            flight_pre_seconds = atof( val );
+        } else if ( strcmp( key, "flight_post_seconds" ) == 0 ) {
+            flight_post_seconds = atof( val );
+        } else if ( strcmp( key, "flight_max_ram8" ) == 0 ) {
+            flight_max_ram8 = strtoull( val, NULL, 10 );
+        } else if ( strcmp( key, "flight_file_prefix" ) == 0 ) {
+            flight_file_prefix = val;
+        } else if ( strcmp( key, "flight_spectrum_trigger" ) == 0 ) {
+            flight_spectrum_trigger = ( float ) atof( val );
+        } else if ( strcmp( key, "flight_trigger_rearm" ) == 0 ) {
+            flight_trigger_rearm = ( float ) atof( val );
+        } else if ( strcmp( key, "flight_trigger_holdoff_s" ) == 0 ) {
+            flight_trigger_holdoff_s = atof( val );
+        } else if ( strcmp( key, "fft_planner_effort" ) == 0 ) {
+            fft_planner_effort = atoi( val );
+        } else if ( strcmp( key, "fft_wisdom_file" ) == 0 ) {
+            fft_wisdom_file = val;
+        } else if ( strcmp( key, "fft_threads" ) == 0 ) {
+            fft_threads = atoi( val );
+        } else if ( strcmp( key, "fft_threads_min_size" ) == 0 ) {
+            fft_threads_min_size = atoi( val );
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Reads SetValue keys, returns false if there is no file
+    bool LoadSettings( const char* fname = SETTINGS_FILE_NAME ) {
+        FILE* f = fopen( fname, "r" );
+        if ( !f ) {
+            return false;
+        }
+        char line[ 512 ];
+        int line_num = 0;
+        while ( fgets( line, sizeof( line ), f ) ) {
+            line_num++;
+            char* comment = strchr( line, '#' );
+            if ( comment ) {
+                *comment = '\0';
+            }
+            char* key = strtok( line, " \t\r\n" );
+            if ( !key ) {
+                continue;
+            }
+            char* val = strtok( NULL, " \t\r\n" );
+            if ( !val ) {
+                fprintf( stderr, "__warning__ %s:%d no value of '%s'\n", fname, line_num, key );
+            } else if ( !SetValue( key, val ) ) {
+                fprintf( stderr, "__warning__ %s:%d unknown key '%s'\n", fname, line_num, key );
+            }
+        }
+        fclose( f );
+        fprintf( stderr, "FX3Config: settings from %s\n", fname );
+        return true;
+    }
+
     void FinishConfigure() {
         switch ( adc_type ) {
         case ADC_1ch_16bit:
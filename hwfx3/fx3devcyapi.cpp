@@ -4,13 +4,15 @@
 #ifndef NO_CY_API
 
 #include "HexParser.h"
+#include "util/ThreadConfig.h"
 #include "ad9361/ad9361_tuner.h"
 
 
 FX3DevCyAPI::FX3DevCyAPI() :
     data_handler( NULL ),
     last_overflow_count( 0 ),
-    size_tx_mb( 0.0 )
+    size_tx_mb( 0.0 ),
+    stream_offset8( 0 )
 {
 
 }
@@ -136,6 +138,7 @@ fx3_dev_err_t FX3DevCyAPI::init(const char *firmwareFileName, const char *additi
 
 void FX3DevCyAPI::startRead(DeviceDataHandlerIfce *handler) {
     size_tx_mb = 0.0;
+    stream_offset8 = 0;
     startTransferData(0, 128, 4, 1500);
     data_handler = handler;
     xfer_thread = std::thread(&FX3DevCyAPI::xfer_loop, this);
@@ -485,6 +488,7 @@ fx3_dev_err_t FX3DevCyAPI::ctrlFromDevice(uint8_t cmd, uint16_t value, uint16_t
 
 void FX3DevCyAPI::xfer_loop() {
     fprintf( stderr, "FX3DevCyAPI::xfer_loop() started\n" );
+    pipe_thread_setup( PipeThread_Usb );
     StartDataTransferParams* Params = &StartParams;
     
     
@@ -595,8 +599,12 @@ void FX3DevCyAPI::xfer_loop() {
 
         size_tx_mb += ( ( double ) len ) / ( 1024.0 * 1024.0 );
         if ( data_handler ) {
-            data_handler->HandleDeviceData(buffers[i], len);
+            StreamBlockInfo info;
+            info.host_time_ns   = StreamHostTimeNs();
+            info.stream_offset8 = stream_offset8;
+            data_handler->HandleDeviceDataEx(buffers[i], len, info);
         }
+        stream_offset8 += len;
 
         // Re-submit this queue element to keep the queue full
         contexts[i] = Params->EndPt->BeginDataXfer(buffers[i], len, &inOvLap[i]);
@@ -85,6 +85,7 @@ private:
     
     uint32_t last_overflow_count;
     double size_tx_mb;
+    uint64_t stream_offset8;    // bytes received since startRead
     
 
     // DeviceControlIOIfce interface
@@ -4,12 +4,30 @@
 #include "fx3deverr.h"
 #include "fx3devdebuginfo.h"
 #include "fx3commands.h"
+#include "datastreams/datablock.h"
 #include <stddef.h>
 
 // Interface for handling data from FX3 device
 class DeviceDataHandlerIfce {
 public:
+    // Data is valid only while the call is in progress
     virtual void HandleDeviceData( void* data_pointer, size_t size_in_bytes ) = 0;
+
+    // Same with position and receive time of data (StreamBlockInfo::stream_offset8 and host_time_ns)
+    virtual void HandleDeviceDataEx( void* data_pointer, size_t size_in_bytes, const StreamBlockInfo& info ) {
+        HandleDeviceData( data_pointer, size_in_bytes );
+    }
+
+    // Block stays valid as long as handler holds a reference (AddRef/Release)
+    virtual void HandleDeviceBlock( DataBlock* block ) {
+        HandleDeviceDataEx( block->data, block->size8, block->info );
+    }
+
+    // Sleeps until size8 bytes can be taken without overrun, false on timeout.
+    // Only sources which may wait (file replay) call it, device data can't wait.
+    virtual bool WaitForSpace( size_t size8, uint32_t timeout_ms ) {
+        return true;
+    }
 };
 
 
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <thread>
+#include <chrono>
+
+#include "fx3usbtuner.h"
+
+const double FX3UsbTuner::NEAR_MAX_THROUGHPUT = 0.99;
+
+FX3UsbTuner::FX3UsbTuner( const char* firmware_fname, const char* additional_fw_fname, bool read_board_overflows ) :
+    fw_fname( firmware_fname ? firmware_fname : "" ),
+    add_fw_fname( additional_fw_fname ? additional_fw_fname : "" ),
+    have_add_fw( additional_fw_fname != NULL ),
+    read_board_overflows( read_board_overflows )
+{
+    const size_t kb = 1024;
+    block_sizes.push_back( 256 * kb );
+    block_sizes.push_back( 1024 * kb );
+    block_sizes.push_back( 3072 * 1250 );
+    block_sizes.push_back( 8192 * kb );
+
+    buffers_counts.push_back( 2 );
+    buffers_counts.push_back( 4 );
+    buffers_counts.push_back( 8 );
+}
+
+void FX3UsbTuner::SetBlockSizes( const std::vector< size_t >& sizes8 ) {
+    block_sizes = sizes8;
+}
+
+void FX3UsbTuner::SetBuffersCounts( const std::vector< uint32_t >& counts ) {
+    buffers_counts = counts;
+}
+
+const std::vector< fx3_usb_tune_point_t >& FX3UsbTuner::Run( double seconds_per_point, uint32_t spare_count ) {
+    if ( seconds_per_point <= 0.0 ) {
+        seconds_per_point = DEF_SECONDS_PER_POINT;
+    }
+    points.clear();
+    for ( size_t b = 0; b < block_sizes.size(); b++ ) {
+        for ( size_t c = 0; c < buffers_counts.size(); c++ ) {
+            fprintf( stderr, "FX3UsbTuner: block %llu bytes, %u transfers, %.1f s...\n",
+                     ( unsigned long long ) block_sizes[ b ], buffers_counts[ c ], seconds_per_point );
+            points.push_back( runPoint( block_sizes[ b ], buffers_counts[ c ], spare_count, seconds_per_point ) );
+        }
+    }
+    PrintReport();
+    return points;
+}
+
+fx3_usb_tune_point_t FX3UsbTuner::runPoint( size_t block_size8, uint32_t buffers_count, uint32_t spare_count, double seconds ) {
+    fx3_usb_tune_point_t point;
+    point.block_size8   = block_size8;
+    point.buffers_count = buffers_count;
+
+    FX3Dev* dev = new FX3Dev( block_size8, buffers_count, spare_count );
+    fx3_dev_err_t res = dev->init( fw_fname.empty() ? NULL : fw_fname.c_str(),
+                                   have_add_fw ? add_fw_fname.c_str() : NULL );
+    if ( res != FX3_ERR_OK ) {
+        fprintf( stderr, "__error__ FX3UsbTuner: init failed %d %s\n", res, fx3_get_error_string( res ) );
+        delete dev;
+        return point;
+    }
+    point.init_ok = true;
+
+    fx3_dev_debug_info_t info_before = dev->getDebugInfoFromBoard( !read_board_overflows );
+    dev->startRead( this );
+    std::this_thread::sleep_for( std::chrono::milliseconds( ( int64_t ) ( seconds * 1000.0 ) ) );
+    dev->stopRead();
+    fx3_dev_debug_info_t info_after = dev->getDebugInfoFromBoard( !read_board_overflows );
+
+    point.stats = dev->GetStreamStats();
+    if ( read_board_overflows && info_before.status == FX3_ERR_OK && info_after.status == FX3_ERR_OK ) {
+        point.board_overflows = info_after.overflows - info_before.overflows;
+    }
+    delete dev;
+    return point;
+}
+
+const fx3_usb_tune_point_t* FX3UsbTuner::Best() const {
+    double max_mbps = 0.0;
+    for ( size_t i = 0; i < points.size(); i++ ) {
+        if ( points[ i ].init_ok && points[ i ].Drops() == 0 && points[ i ].stats.MBytesPerSec() > max_mbps ) {
+            max_mbps = points[ i ].stats.MBytesPerSec();
+        }
+    }
+    // Device rate is fixed, so every good point has about the same throughput.
+    // Take one with smallest latency among them.
+    const fx3_usb_tune_point_t* best = NULL;
+    for ( size_t i = 0; i < points.size(); i++ ) {
+        const fx3_usb_tune_point_t& p = points[ i ];
+        if ( !p.init_ok || p.Drops() || p.stats.MBytesPerSec() < max_mbps * NEAR_MAX_THROUGHPUT ) {
+            continue;
+        }
+        if ( !best || p.stats.interval_max_ms < best->stats.interval_max_ms ) {
+            best = &p;
+        }
+    }
+    return best;
+}
+
+bool FX3UsbTuner::ApplyBest( FX3Config* cfg ) const {
+    const fx3_usb_tune_point_t* best = Best();
+    if ( !best ) {
+        fprintf( stderr, "__warning__ FX3UsbTuner: every configuration had drops, config is not changed\n" );
+        return false;
+    }
+    cfg->usb_block_size8   = best->block_size8;
+    cfg->usb_buffers_count = best->buffers_count;
+    return true;
+}
+
+void FX3UsbTuner::PrintReport() const {
+    const fx3_usb_tune_point_t* best = Best();
+    fprintf( stderr, "FX3UsbTuner:    block8 xfers    MB/s  avg_ms  max_ms  jit_ms  failed  overfl  copied\n" );
+    for ( size_t i = 0; i < points.size(); i++ ) {
+        const fx3_usb_tune_point_t& p = points[ i ];
+        if ( !p.init_ok ) {
+            fprintf( stderr, "FX3UsbTuner: %9llu %5u  init failed\n", ( unsigned long long ) p.block_size8, p.buffers_count );
+            continue;
+        }
+        fprintf( stderr, "FX3UsbTuner: %9llu %5u %7.2f %7.2f %7.2f %7.3f %7llu %7u %7llu%s\n",
+                 ( unsigned long long ) p.block_size8, p.buffers_count,
+                 p.stats.MBytesPerSec(), p.stats.interval_avg_ms, p.stats.interval_max_ms, p.stats.jitter_ms,
+                 ( unsigned long long ) p.stats.failed_transfers, p.board_overflows,
+                 ( unsigned long long ) p.stats.copied_blocks,
+                 &p == best ? "  <- best" : "" );
+    }
+}
+
+void FX3UsbTuner::HandleDeviceData( void*, size_t ) {
+}
+
+void FX3UsbTuner::HandleDeviceBlock( DataBlock* ) {
+}
@@ -0,0 +1,72 @@
+#ifndef FX3USBTUNER_H
+#define FX3USBTUNER_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "fx3devifce.h"
+#include "FX3Dev.h"
+#include "fx3config.h"
+
+struct fx3_usb_tune_point_t {
+    size_t   block_size8;
+    uint32_t buffers_count;
+    bool     init_ok;
+    fx3_stream_stats_t stats;
+    uint32_t board_overflows;   // overflows counted by FX3 firmware during the run
+
+    fx3_usb_tune_point_t() : block_size8( 0 ), buffers_count( 0 ), init_ok( false ), board_overflows( 0 ) {}
+
+    uint64_t Drops() const {
+        return stats.failed_transfers + board_overflows;
+    }
+};
+
+/*
+ * USB throughput self-test (libusb driver only).
+ * For every block size and transfers-in-flight count opens device, streams for some seconds
+ * and records MB/s, onDataReady interval jitter and drops. Data is discarded, router is not used.
+ * Best point is one without drops and with throughput close to maximal which has smallest worst
+ * interval between transfers. Run it without other streaming, device is reopened for every point.
+ */
+class FX3UsbTuner : public DeviceDataHandlerIfce {
+public:
+    // read_board_overflows: firmware answers full debug request (see HWManager::getDebugInfo)
+    FX3UsbTuner( const char* firmware_fname, const char* additional_fw_fname, bool read_board_overflows );
+
+    void SetBlockSizes( const std::vector< size_t >& sizes8 );
+    void SetBuffersCounts( const std::vector< uint32_t >& counts );
+
+    // Blocks calling thread for about sizes * counts * seconds
+    const std::vector< fx3_usb_tune_point_t >& Run( double seconds_per_point, uint32_t spare_count );
+
+    // Returns NULL if every point had drops
+    const fx3_usb_tune_point_t* Best() const;
+
+    // Puts best point into cfg, returns false if there is no good point
+    bool ApplyBest( FX3Config* cfg ) const;
+
+    void PrintReport() const;
+
+    // DeviceDataHandlerIfce
+    virtual void HandleDeviceData( void* data_pointer, size_t size_in_bytes );
+    virtual void HandleDeviceBlock( DataBlock* block );
+
+private:
+    static const uint32_t DEF_SECONDS_PER_POINT = 5;
+    static const double   NEAR_MAX_THROUGHPUT;
+
+    fx3_usb_tune_point_t runPoint( size_t block_size8, uint32_t buffers_count, uint32_t spare_count, double seconds );
+
+    std::string fw_fname;
+    std::string add_fw_fname;
+    bool have_add_fw;
+    bool read_board_overflows;
+    std::vector< size_t > block_sizes;
+    std::vector< uint32_t > buffers_counts;
+    std::vector< fx3_usb_tune_point_t > points;
+};
+
+#endif // FX3USBTUNER_H
@@ -5,6 +5,7 @@
 #include "hwfx3/FX3Dev.h"
 #include "hwfx3/fx3devcyapi.h"
 #include "hwfx3/FileSimDev.h"
+#include "datastreams/adcformat.h"
 #ifdef WIN32
 #include <windows.h>
 #endif
@@ -40,14 +41,19 @@ void HWManager::initHardware(DriverType_t drvType, const char* imageFileName , c
 
     switch ( drvType ) {
         case DrvTypeLibUsb:
-            dev = new FX3Dev();
+            dev = new FX3Dev( cfg->usb_block_size8, cfg->usb_buffers_count, cfg->usb_spare_count );
             break;
         case DrvTypeCypress:
             dev = new FX3DevCyAPI();
             break;
-        case DrvTypeFileSim:
-            dev = new FileSimDev( imageFileName, cfg->adc_sample_rate_hz, 4 * 1024 * 1024 );
+        case DrvTypeFileSim: {
+            FileSimDev* sim = new FileSimDev( imageFileName, cfg->adc_sample_rate_hz, cfg->filesim_block_size8,
+                                              adc_format_info( cfg->adc_type ).bytes_per_point );
+            sim->SetRate( cfg->filesim_rate );
+            sim->SetLoopSeconds( cfg->filesim_loop_begin_s, cfg->filesim_loop_end_s );
+            dev = sim;
             break;
+        }
         default:
             QString msg( "Device init error " );
             msg += fx3_get_error_string( FX3_ERR_DRV_NOT_IMPLEMENTED );
@@ -119,3 +125,18 @@ void HWManager::HandleDeviceData(void* data_pointer, size_t size_in_bytes) {
     }
 }
 
+void HWManager::HandleDeviceDataEx(void* data_pointer, size_t size_in_bytes, const StreamBlockInfo& info) {
+    if ( router ) {
+        router->HandleADCStreamData(data_pointer, size_in_bytes, info);
+    }
+}
+
+void HWManager::HandleDeviceBlock(DataBlock* block) {
+    if ( router ) {
+        router->HandleADCStreamBlock(block);
+    }
+}
+
+bool HWManager::WaitForSpace(size_t size8, uint32_t timeout_ms) {
+    return router ? router->WaitForSpace( size8, timeout_ms ) : true;
+}
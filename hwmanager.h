@@ -18,6 +18,9 @@ public:
     void SetRouter( StreamRouter* r );
     // DeviceDataHandlerIfce interface
     virtual void HandleDeviceData(void* data_pointer, size_t size_in_bytes);
+    virtual void HandleDeviceDataEx(void* data_pointer, size_t size_in_bytes, const StreamBlockInfo& info);
+    virtual void HandleDeviceBlock(DataBlock* block);
+    virtual bool WaitForSpace(size_t size8, uint32_t timeout_ms);
 private:
     FX3DevIfce* dev;
     StreamRouter* router;
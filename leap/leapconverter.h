@@ -13,17 +13,12 @@ class LEAPConverter
 {
 public:
     LEAPConverter( int32_t SR, double gps_freq );
-    
-    void convertFile( const char* file_name,
-                      uint32_t chunks_count,
-                      uint32_t chunk_len_ms,
-                      uint32_t chunk_gap_ms );
-    
-private:
+
+    // Header of file which is written by stream (StreamLEAPDumper), bit planes follow it
+    void SetChunks( uint32_t chunks_count, uint32_t chunk_len_ms, uint32_t chunk_gap_ms );
+    void SetTimestamp( int64_t ticks );
     void writeHeader( FILE* f );
-    void decode8points( int16_t* src, uint8_t* dest );
-    void decodeNPoints( int16_t* src, uint8_t* dest, int N );
-    
+
 private:
     int32_t signature;
     int32_t version;
@@ -8,15 +8,71 @@
 #include "SpectrumForm.h"
 #include "phaseform.h"
 #include "tuneform.h"
+#include "hwfx3/fx3usbtuner.h"
+#include "util/ThreadConfig.h"
+#include "datahandlers/streamflightrecorder.h"
+#include "gcacorr/fftplans.h"
 
 #include "stdio.h"
+#include <string.h>
+#include <stdlib.h>
 #include <QApplication>
 
+// "--usb-tune [seconds]" measures libusb transfer configurations and saves the best one
+static double usbTuneSeconds( int argc, char *argv[] ) {
+    for ( int i = 1; i < argc; i++ ) {
+        if ( strcmp( argv[ i ], "--usb-tune" ) == 0 ) {
+            double sec = ( i + 1 < argc ) ? atof( argv[ i + 1 ] ) : 0.0;
+            return sec > 0.0 ? sec : 5.0;
+        }
+    }
+    return 0.0;
+}
+
+// "--fft-bench [threads]" measures FFTW threads speedup for transform sizes
+static int fftBenchThreads( int argc, char *argv[] ) {
+    for ( int i = 1; i < argc; i++ ) {
+        if ( strcmp( argv[ i ], "--fft-bench" ) == 0 ) {
+            int thr = ( i + 1 < argc ) ? atoi( argv[ i + 1 ] ) : 0;
+            return thr > 1 ? thr : 4;
+        }
+    }
+    return 0;
+}
+
+// "--fft-threads N" FFTW threads for large transforms, 0 - not given
+static int fftThreadsArg( int argc, char *argv[] ) {
+    for ( int i = 1; i + 1 < argc; i++ ) {
+        if ( strcmp( argv[ i ], "--fft-threads" ) == 0 ) {
+            int thr = atoi( argv[ i + 1 ] );
+            return thr > 0 ? thr : 1;
+        }
+    }
+    return 0;
+}
+
+// "--set key value" overrides FX3Config settings file, may be repeated
+static void applySetArgs( int argc, char *argv[], FX3Config& cfg ) {
+    for ( int i = 1; i < argc; i++ ) {
+        if ( strcmp( argv[ i ], "--set" ) != 0 ) {
+            continue;
+        }
+        if ( i + 2 >= argc ) {
+            fprintf( stderr, "__warning__ --set needs key and value\n" );
+            return;
+        }
+        if ( !cfg.SetValue( argv[ i + 1 ], argv[ i + 2 ] ) ) {
+            fprintf( stderr, "__warning__ --set: unknown key '%s'\n", argv[ i + 1 ] );
+        }
+        i += 2;
+    }
+}
 
 int main(int argc, char *argv[])
 {
     setbuf(stdout, NULL);
     setbuf(stderr, NULL);
+    pipe_thread_load_config();
     QApplication a(argc, argv);
 
     FX3Config cfg;
@@ -27,9 +83,53 @@ int main(int argc, char *argv[])
         return -1;
     }
 
+    cfg.LoadUsbTune();
+    cfg.LoadSettings( FFT_TUNE_FILE_NAME );
+    cfg.LoadSettings();
+    applySetArgs( argc, argv, cfg );
+    int fft_threads = fftThreadsArg( argc, argv );
+    if ( fft_threads > 0 ) {
+        cfg.fft_threads = fft_threads;
+    }
+    double tune_seconds = usbTuneSeconds( argc, argv );
+    if ( tune_seconds > 0.0 ) {
+        if ( cfg.drv_type == DrvTypeLibUsb ) {
+            FX3UsbTuner tuner( cfg.fn_img.c_str(),
+                               cfg.have_submodules ? cfg.fn_hex.c_str() : NULL,
+                               cfg.adc_type == ADC_1ch_16bit );
+            tuner.Run( tune_seconds, cfg.usb_spare_count );
+            if ( tuner.ApplyBest( &cfg ) ) {
+                cfg.SaveUsbTune();
+            }
+        } else {
+            fprintf( stderr, "__warning__ --usb-tune works only with LibUsb driver\n" );
+        }
+    }
 
 
-    StreamRouter router( cfg.adc_type );
+    // before forms, they make their FFT plans in constructors
+    fft_plans_set_effort( ( FFTPlanEffort_t ) cfg.fft_planner_effort );
+    int bench_threads = fftBenchThreads( argc, argv );
+    if ( bench_threads > 0 ) {
+        int crossover = fft_threads_benchmark( bench_threads );
+        if ( crossover > 0 ) {
+            cfg.fft_threads_min_size = crossover;
+            cfg.SaveFftTune();
+        } else {
+            fprintf( stderr, "__warning__ --fft-bench: threads are not faster, fft_threads_min_size is not changed\n" );
+        }
+    }
+    fft_plans_set_threads( cfg.fft_threads, cfg.fft_threads_min_size );
+    fft_wisdom_import( cfg.fft_wisdom_file.c_str() );
+
+    // Destroyed after router, which stops its worker
+    StreamFlightRecorder flightRec;
+
+    StreamRouter router( cfg.adc_type,
+                         cfg.router_queue_depth,
+                         cfg.router_block_size8,
+                         cfg.router_drop_oldest ? Overrun_DropOldest : Overrun_DropNewest,
+                         cfg.router_worker_depth );
     router.SetHackedLen( cfg.hacked_len );
         
     RawSignalForm rawForm( &cfg );
@@ -59,6 +159,14 @@ int main(int argc, char *argv[])
 
     router.AddOutPoint( &gpsForm );
 
+    if ( cfg.flight_pre_seconds > 0.0 &&
+         flightRec.Configure( cfg, cfg.flight_pre_seconds, cfg.flight_post_seconds, cfg.flight_max_ram8 ) ) {
+        flightRec.SetFilePrefix( cfg.flight_file_prefix.c_str() );
+        router.AddOutPoint( &flightRec );
+        rawForm.flight_trigger  = &flightRec;
+        specForm.flight_trigger = &flightRec;
+    }
+
     QObject::connect(&mainWindow, SIGNAL(signalInitHw(DriverType_t, const char*, const char*)), &hwm, SLOT(initHardware(DriverType_t, const char*, const char*)) );
     QObject::connect(&mainWindow, SIGNAL(signalCloseHw()),           &hwm, SLOT(closeHardware()) );
     QObject::connect(&mainWindow, SIGNAL(signalStartHwStreams()),    &hwm, SLOT(startStreams()) );
@@ -81,5 +189,7 @@ int main(int argc, char *argv[])
 
 
 
-    return a.exec();
+    int result = a.exec();
+    fft_wisdom_export( cfg.fft_wisdom_file.c_str() );
+    return result;
 }
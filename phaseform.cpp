@@ -6,6 +6,7 @@
 #include <cstdio>
 #include <cmath>
 #include "gcacorr/dsp_utils.h"
+#include "util/ThreadConfig.h"
 #include "phaseform.h"
 #include "ui_phaseform.h"
 
@@ -61,13 +62,7 @@ PhaseForm::PhaseForm(QWidget *parent) :
         fft_out_averaged.at(i).resize(fft_len);
     }
 
-    tbuf_fft.resize(avg_cnt);
-    for ( size_t iter = 0; iter < tbuf_fft.size(); iter++ ) {
-        tbuf_fft[ iter ].resize( 4 );
-        for ( size_t ch = 0; ch < tbuf_fft[ iter ].size(); ch++ ) {
-            tbuf_fft[ iter ][ ch ].resize( fft_len );
-        }
-    }
+    tbuf_fft.resize( avg_cnt * 4 * fft.BatchBins() );
 
     running = true;
     tick_thr = std::thread( &PhaseForm::Tick, this );
@@ -192,6 +187,16 @@ void PhaseForm::hideEvent(QHideEvent *event)
     ui->checkBoxRun->setChecked(false);
 }
 
+StreamDelivery_t PhaseForm::GetDelivery()
+{
+    return StreamDelivery_LatestOnly;
+}
+
+StreamSubscription PhaseForm::GetSubscription()
+{
+    return StreamSubscription( false, true );
+}
+
 void PhaseForm::HandleAllChansData( std::vector<short*>& new_all_ch_data, size_t pts_cnt )
 {
     if ( pts_cnt < source_len * avg_cnt ) {
@@ -227,15 +232,11 @@ void PhaseForm::MakeFFTs()
 
     } else {
 
-        for ( int iter = 0; iter < avg_cnt; iter++ ) {
-            for ( size_t channel = 0; channel < 4; channel++ ) {
-                fft.TransformShort(
-                            all_ch_data[ channel ].data() + fft_len * iter,
-                            tbuf_fft[ iter ][ channel ].data(),
-                            true
-                            );
-            }
-        }
+        // all windows of all channels in one batch
+        const short* src[ 4 ] = { all_ch_data[ 0 ].data(), all_ch_data[ 1 ].data(),
+                                  all_ch_data[ 2 ].data(), all_ch_data[ 3 ].data() };
+        fft.TransformShortBatch( src, 4, avg_cnt, tbuf_fft.data() );
+        const int bins = fft.BatchBins();
 
         float scale = 1.0f / ((float) avg_cnt * 4.0f);
         float_cpx_t corr[4];
@@ -246,13 +247,10 @@ void PhaseForm::MakeFFTs()
             corr[3] = float_cpx_t( 0.0f, 0.0f );
 
             for ( int iter = 0; iter < avg_cnt; iter++ ) {
+                // spectrum is inverted, as TransformShort( ..., true ) gave
+                const float_cpx_t* win = tbuf_fft.data() + iter * 4 * bins + half_fft_len - pt;
                 for ( int ch = 0; ch < 4; ch++ ) {
-                    corr[ch].add(
-                        calc_correlation(
-                            tbuf_fft[ iter ][ 0  ][ pt ],
-                            tbuf_fft[ iter ][ ch ][ pt ]
-                        )
-                    );
+                    corr[ch].add( calc_correlation( win[ 0 ], win[ ch * bins ] ) );
                 }
             }
 
@@ -280,13 +278,9 @@ void PhaseForm::MakeFFTs()
             corr[3] = float_cpx_t( 0.0f, 0.0f );
             for ( int pt = beg; pt < end; pt++ ) {
                 for ( int iter = 0; iter < avg_cnt; iter++ ) {
+                    const float_cpx_t* win = tbuf_fft.data() + iter * 4 * bins + half_fft_len - pt;
                     for ( int ch = 0; ch < 4; ch++ ) {
-                        corr[ch].add(
-                            calc_correlation(
-                                tbuf_fft[ iter ][ 0  ][ pt ],
-                                tbuf_fft[ iter ][ ch ][ pt ]
-                            )
-                        );
+                        corr[ch].add( calc_correlation( win[ 0 ], win[ ch * bins ] ) );
                     }
                 }
             }
@@ -421,6 +415,7 @@ void PhaseForm::CalcConvolution()
 
 void PhaseForm::Tick()
 {
+    pipe_thread_setup( PipeThread_Phase );
     this_thread::sleep_for(chrono::milliseconds(2000));
     while (running) {
         event_data.WaitAndFlush();
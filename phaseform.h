@@ -36,7 +36,7 @@ private:
     QCamera *camera;
 
     std::vector< std::vector<float_cpx_t> > fft_out_averaged;
-    std::vector<std::vector<std::vector<float_cpx_t>>> tbuf_fft;
+    FFTBuffer<float_cpx_t> tbuf_fft;     // spectrum of window iter, channel ch at ( iter * 4 + ch ) * BatchBins()
     std::vector<float> tbuf_powers;
     std::vector<float> tbuf_phases;
     FFTWrapper fft;
@@ -110,6 +110,8 @@ private slots:
     // StreamDataHandler interface
 public:
     void HandleAllChansData(std::vector<short*>& new_all_ch_data, size_t pts_cnt );
+    StreamSubscription GetSubscription();
+    StreamDelivery_t GetDelivery();
 
     // QWidget interface
 protected:
@@ -4,12 +4,16 @@
 
 RawSignalForm::RawSignalForm(FX3Config *cfg_, QWidget *parent) :
     QWidget(parent),
+    flight_trigger( NULL ),
     ui(new Ui::RawSignalForm),
     cfg(cfg_),
+    uring_recording( false ),
     skipped_packets(0),
     first_run( true ),
     last_axis( 10.0 ),
     axis_blank_percent( 0.3 ),
+    replot_is_in_progress( false ),
+    is_running( false ),
     chan_count( cfg_->chan_count )
 {
     last_shift.resize( chan_count );
@@ -50,6 +54,8 @@ RawSignalForm::RawSignalForm(FX3Config *cfg_, QWidget *parent) :
     QObject::connect(ui->checkFileRecord, SIGNAL(stateChanged(int)), this, SLOT(slotRecOnOff(int)) );
     QObject::connect(ui->pushButtonFile,  SIGNAL(clicked(bool)),     this, SLOT(slotChooseFile(bool)) );
     QObject::connect(ui->buttonDump,      SIGNAL(clicked(bool)),     this, SLOT(slotRecOneShot(bool)) );
+    QObject::connect(ui->buttonFlightDump, SIGNAL(clicked(bool)),     this, SLOT(slotFlightDump(bool)) );
+    QObject::connect(this, SIGNAL(signalDumpOverrun(quint64)),       this, SLOT(slotDumpOverrun(quint64)) );
     
     QObject::connect(ui->checkBoxCountGaps, SIGNAL(stateChanged(int)), this, SLOT(slotGapCountOnOff(int)) );
     QObject::connect(ui->spinBoxGapVal, SIGNAL(valueChanged(int)), this, SLOT(slotGapValChanged(int)) );
@@ -66,17 +72,46 @@ RawSignalForm::RawSignalForm(FX3Config *cfg_, QWidget *parent) :
         checkBoxShowChannels[ i ]->setEnabled( false );
     }
 
+    checkBoxRecChannels.resize( MAX_CHANS );
+    checkBoxRecChannels[ 0 ] = ui->checkBoxRecCh0;
+    checkBoxRecChannels[ 1 ] = ui->checkBoxRecCh1;
+    checkBoxRecChannels[ 2 ] = ui->checkBoxRecCh2;
+    checkBoxRecChannels[ 3 ] = ui->checkBoxRecCh3;
+    for ( int i = chan_count; i < MAX_CHANS; i++ ) {
+        checkBoxRecChannels[ i ]->setChecked( false );
+        checkBoxRecChannels[ i ]->setEnabled( false );
+    }
+
     ui->comboBoxDumpType->clear();
     for ( int i = 0; i < ( int ) StreamDump_TypeCount; i++ ) {
         ui->comboBoxDumpType->insertItem( i, StreamDumpTypeNames[ i ] );
     }
+
+    AsyncWriterOptions wopts;
+    wopts.buffer_size8   = cfg->dump_buffer_size8;
+    wopts.buffers_count  = cfg->dump_buffers_count;
+    wopts.direct_io      = cfg->dump_direct_io;
+    wopts.prealloc_size8 = cfg->dump_prealloc_size8;
+    dumper.SetWriterOptions( wopts );
+    dumper.SetOverrunCallBack( this );
+    dumper.SetCaptureConfig( *cfg );
+    dumper.SetCompressThreads( cfg->dump_compress_threads );
+    DumpSegmentOptions sopts;
+    sopts.max_size8     = cfg->dump_segment_size8;
+    sopts.max_seconds   = cfg->dump_segment_seconds;
+    sopts.keep_segments = cfg->dump_keep_segments;
+    dumper.SetSegmentOptions( sopts );
+    uring_dumper.SetWriterOptions( wopts );
+    uring_dumper.SetOverrunCallBack( this );
 }
 
 RawSignalForm::~RawSignalForm()
 {
     if ( router ) {
+        is_running = false;
         router->DeleteOutPoint( this );
         router->DeleteOutPoint( &dumper );
+        router->DeleteOutPoint( &uring_dumper );
     }
     delete ui;
 }
@@ -99,7 +134,7 @@ void RawSignalForm::HandleStreamDataOneChan(short *one_ch_data, size_t in_pts_cn
 
     if ( replot_is_in_progress && channel == 0 ) {
         if ( ui->checkNoSkipMode->isChecked() ) {
-            while ( replot_is_in_progress ) {
+            while ( replot_is_in_progress && is_running ) {
                 QThread::msleep( 1 );
             }
         } else {
@@ -111,6 +146,9 @@ void RawSignalForm::HandleStreamDataOneChan(short *one_ch_data, size_t in_pts_cn
     if ( points_num < 100 ) {
         points_num = 100;
     }
+    if ( channel == 0 ) {
+        clearHiddenChannels();
+    }
 
     if ( cfg->signal_type == SigTypeIQParts ) {
         std::vector<float> floatvec[ 2 ];
@@ -140,6 +178,35 @@ void RawSignalForm::HandleStreamDataOneChan(short *one_ch_data, size_t in_pts_cn
     }
 }
 
+StreamSubscription RawSignalForm::GetSubscription() {
+    // Channel 0 is always received: replot throttling is done on it
+    StreamSubscription sub;
+    sub.chan_mask = 1;
+    for ( int ch = 1; ch < chan_count && ch < MAX_CHANS; ch++ ) {
+        if ( checkBoxShowChannels[ ch ]->isChecked() ) {
+            sub.chan_mask |= 1 << ch;
+        }
+    }
+    return sub;
+}
+
+// No-skip mode waits for every replot, so it can't drop blocks in router either
+StreamDelivery_t RawSignalForm::GetDelivery() {
+    return ui->checkNoSkipMode->isChecked() ? StreamDelivery_Lossless : StreamDelivery_LatestOnly;
+}
+
+// Channels which are not subscribed are not received, their old data is removed here
+void RawSignalForm::clearHiddenChannels() {
+    for ( int ch = 1; ch < chan_count && ch < MAX_CHANS; ch++ ) {
+        if ( !checkBoxShowChannels[ ch ]->isChecked() ) {
+            rawPlot->graph( ch )->clearData();
+            if ( cfg->signal_type == SigTypeIQParts ) {
+                rawPlot->graph( ch + MAX_CHANS )->clearData();
+            }
+        }
+    }
+}
+
 void RawSignalForm::SetLabels() {
     QString str( "Skipped packets = " );
     str += QString::number(skipped_packets);
@@ -219,8 +286,10 @@ void RawSignalForm::slotRun(int state ) {
         if ( state ) {
             skipped_packets = 0;
             first_run = true;
+            is_running = true;
             router->AddOutPoint(this);
         } else {
+            is_running = false;
             router->DeleteOutPoint(this);
         }
     }
@@ -229,20 +298,50 @@ void RawSignalForm::slotRun(int state ) {
 void RawSignalForm::slotRecOnOff(int state) {
     fprintf( stderr, "RawSignalForm::slotRecOnOff(%d)\n", state );
     if ( state ) {
+        ui->checkFileRecord->setStyleSheet( "" );
+        ui->checkFileRecord->setToolTip( "" );
         ui->lineRecFileName->setEnabled( false );
-        dumper.SetDumpFileName(ui->lineRecFileName->text().toLatin1().data());
-        dumper.StartDump( ( StreamDumpType_t ) ui->comboBoxDumpType->currentIndex(), ui->checkSaveTimeStamp->isChecked() );
-        router->AddOutPoint(&dumper);
+        StreamDumpType_t dump_type = ( StreamDumpType_t ) ui->comboBoxDumpType->currentIndex();
+        // StreamUringDumper writes one file, segmented recording goes to StreamDumper
+        bool segmented = cfg->dump_segment_size8 || cfg->dump_segment_seconds > 0.0;
+        uring_recording = cfg->dump_use_uring && dump_type == StreamDump_AllData &&
+                !ui->checkSaveTimeStamp->isChecked() && !segmented;
+        if ( uring_recording ) {
+            uring_dumper.SetDumpFileName(ui->lineRecFileName->text().toLatin1().data());
+            if ( !uring_dumper.StartDump() ) {
+                // no slotRecOnOff(0) for recording which was not started
+                ui->checkFileRecord->blockSignals( true );
+                ui->checkFileRecord->setChecked( false );
+                ui->checkFileRecord->blockSignals( false );
+                ui->checkFileRecord->setStyleSheet( "color: red" );
+                ui->checkFileRecord->setToolTip( QString( "Can't open '%1' for recording" ).arg( ui->lineRecFileName->text() ) );
+                ui->lineRecFileName->setEnabled( true );
+                return;
+            }
+            router->AddOutPoint(&uring_dumper);
+        } else {
+            dumper.SetDumpFileName(ui->lineRecFileName->text().toLatin1().data());
+            dumper.SetChanMask( RecChanMask() );
+            dumper.StartDump( dump_type, ui->checkSaveTimeStamp->isChecked() );
+            router->AddOutPoint(&dumper);
+        }
     } else {
-        dumper.StopDump();
+        if ( uring_recording ) {
+            uring_dumper.StopDump();
+            router->DeleteOutPoint(&uring_dumper);
+        } else {
+            dumper.StopDump();
+            router->DeleteOutPoint(&dumper);
+        }
         ui->lineRecFileName->setEnabled( true );
-        router->DeleteOutPoint(&dumper);
     }
 }
 
 void RawSignalForm::slotRecOneShot(bool) {
     ui->buttonDump->setEnabled( false );
     ui->lineRecFileName->setEnabled( false );
+    ui->checkFileRecord->setStyleSheet( "" );
+    ui->checkFileRecord->setToolTip( "" );
 
     int seconds = ui->spinBoxDumpSeconds->value();
     int64_t samples = seconds * cfg->adc_sample_rate_hz;
@@ -250,12 +349,47 @@ void RawSignalForm::slotRecOneShot(bool) {
              seconds, samples);
 
     dumper.SetDumpFileName(ui->lineRecFileName->text().toLatin1().data());
+    dumper.SetChanMask( RecChanMask() );
     dumper.StartDump( ( StreamDumpType_t ) ui->comboBoxDumpType->currentIndex(),
                       samples, this );
     router->AddOutPoint(&dumper);
 
 }
 
+void RawSignalForm::slotFlightDump(bool) {
+    if ( !flight_trigger ) {
+        fprintf( stderr, "__warning__ RawSignalForm: flight recorder is off (flight_pre_seconds)\n" );
+        return;
+    }
+    if ( !flight_trigger->TriggerFlightDump( "manual" ) ) {
+        fprintf( stderr, "__warning__ RawSignalForm: flight recorder is busy\n" );
+    }
+}
+
+uint32_t RawSignalForm::RecChanMask() const {
+    uint32_t mask = 0;
+    for ( int i = 0; i < chan_count && i < MAX_CHANS; i++ ) {
+        if ( checkBoxRecChannels[ i ]->isChecked() ) {
+            mask |= ( 1 << i );
+        }
+    }
+    return mask;
+}
+
+// Called from dumper's thread
+void RawSignalForm::onFileDumpOverrun(uint64_t lost_bytes) {
+    emit signalDumpOverrun( lost_bytes );
+}
+
+void RawSignalForm::slotDumpOverrun(quint64) {
+    AsyncWriterStats st = uring_recording ? uring_dumper.GetStats().writer : dumper.GetWriterStats();
+    ui->checkFileRecord->setStyleSheet( "color: red" );
+    ui->checkFileRecord->setToolTip( QString( "Disk is too slow: %1 MBytes lost in %2 overruns, max write %3 ms" )
+                                     .arg( st.dropped8 / ( 1024.0 * 1024.0 ), 0, 'f', 1 )
+                                     .arg( st.overruns )
+                                     .arg( st.write_ms_max, 0, 'f', 1 ) );
+}
+
 void RawSignalForm::onFileDumpComplete() {
     ui->buttonDump->setEnabled( true );
     ui->lineRecFileName->setEnabled( true );
@@ -1,12 +1,15 @@
 #ifndef RAWSIGNALFORM_H
 #define RAWSIGNALFORM_H
 
+#include <atomic>
 #include <QWidget>
 #include <QCheckBox>
 #include "gui/qcustomplot.h"
 #include "datastreams/streamdatahandler.h"
 #include "datastreams/streamrouter.h"
 #include "datahandlers/streamdumper.h"
+#include "datahandlers/streamuringdumper.h"
+#include "datahandlers/flighttriggerifce.h"
 #include "datahandlers/streamgapchecker.h"
 #include "hwfx3/fx3config.h"
 
@@ -25,15 +28,21 @@ public:
     // StreamDataHandler interface
     virtual void HandleADCStreamData(void* data, size_t size8);
     void HandleStreamDataOneChan(short *one_ch_data, size_t pts_cnt, int channel);
+    StreamSubscription GetSubscription();
+    StreamDelivery_t GetDelivery();
 
     StreamRouter* router;
+    FlightTriggerIfce* flight_trigger;
     
 private:
     Ui::RawSignalForm *ui;
     FX3Config* cfg;
     std::vector<QCheckBox*> checkBoxShowChannels;
+    std::vector<QCheckBox*> checkBoxRecChannels;
     QCustomPlot* rawPlot;
     StreamDumper dumper;
+    StreamUringDumper uring_dumper;
+    bool uring_recording;
     StreamGapChecker gap_checker;
     uint32_t points_num;
     uint32_t skipped_packets;
@@ -42,14 +51,18 @@ private:
     double last_axis;
     double axis_blank_percent;
     
-    bool replot_is_in_progress;
+    std::atomic<bool> replot_is_in_progress;
+    std::atomic<bool> is_running;    // cleared before DeleteOutPoint so no-skip wait does not block it
     void SetLabels();
+    uint32_t RecChanMask() const;
     void showRawSignal(const std::vector<float>& data, int channel_num, bool is_second_component = false );
+    void clearHiddenChannels();
     int chan_count;
     std::vector<int> last_shift;
     static const int MAX_CHANS = 4;
 signals:
     void signalNeedReplot();
+    void signalDumpOverrun(quint64);
 private slots:
     void slotReplot();
     void slotReplotComplete();
@@ -63,6 +76,8 @@ private slots:
     void slotGapValChanged(int);
 
     void slotRecOneShot(bool);
+    void slotFlightDump(bool);
+    void slotDumpOverrun(quint64);
     
     // QWidget interface
 protected:
@@ -75,6 +90,7 @@ public:
     // FileDumpCallbackIfce interface
 public:
     void onFileDumpComplete();
+    void onFileDumpOverrun(uint64_t lost_bytes);
 };
 
 #endif // RAWSIGNALFORM_H
@@ -1,2 +1,312 @@
 #include "Chan2bitParser.h"
+#include <atomic>
 
+#if defined( __x86_64__ ) || defined( __i386__ ) || defined( _M_X64 ) || defined( _M_IX86 )
+#define C2B_X86
+#include <immintrin.h>
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+#endif
+
+#if defined( __GNUC__ )
+#define C2B_TARGET( isa ) __attribute__( ( target( isa ) ) )
+#else
+#define C2B_TARGET( isa )
+#endif
+
+/*
+ * Sample codes: 0 -> 1, 1 -> 3, 2 -> -1, 3 -> -3
+ * i.e. bit 0 is magnitude and bit 1 is sign
+ */
+static const int8_t decode_lut_i8[ 16 ] = { 1, 3, -1, -3, 1, 3, -1, -3, 1, 3, -1, -3, 1, 3, -1, -3 };
+
+
+/* --------------------------------------------------------------------------------------------- */
+/* Scalar */
+
+template < typename T >
+static void decode_scalar( const uint8_t* src, size_t pts_cnt, T* const dst[ CHAN2BIT_CHANS ], size_t start ) {
+    for ( int ch = 0; ch < CHAN2BIT_CHANS; ch++ ) {
+        T* d = dst[ ch ];
+        if ( !d ) {
+            continue;
+        }
+        int shift = 2 * ch;
+        for ( size_t i = start; i < pts_cnt; i++ ) {
+            d[ i ] = ( T ) decode_lut_i8[ ( src[ i ] >> shift ) & 0x03 ];
+        }
+    }
+}
+
+
+#ifdef C2B_X86
+/* --------------------------------------------------------------------------------------------- */
+/* SSE2 / SSSE3: 16 samples per iteration */
+
+// Codes of all four channels, each byte in range 0..3
+C2B_TARGET( "sse2" )
+static inline void split_codes_sse2( __m128i x, __m128i c[ CHAN2BIT_CHANS ] ) {
+    const __m128i m3 = _mm_set1_epi8( 0x03 );
+    c[ 0 ] = _mm_and_si128( x, m3 );
+    c[ 1 ] = _mm_and_si128( _mm_srli_epi16( x, 2 ), m3 );
+    c[ 2 ] = _mm_and_si128( _mm_srli_epi16( x, 4 ), m3 );
+    c[ 3 ] = _mm_and_si128( _mm_srli_epi16( x, 6 ), m3 );
+}
+
+// No byte shuffle in SSE2: value = ( 1 + 2 * ( c & 1 ) ) with sign from ( c & 2 )
+C2B_TARGET( "sse2" )
+static inline __m128i codes_to_i8_sse2( __m128i c ) {
+    const __m128i one = _mm_set1_epi8( 1 );
+    const __m128i two = _mm_set1_epi8( 2 );
+    __m128i mag = _mm_and_si128( c, one );
+    mag = _mm_or_si128( _mm_add_epi8( mag, mag ), one );
+    __m128i neg = _mm_cmpeq_epi8( _mm_and_si128( c, two ), two );
+    return _mm_sub_epi8( _mm_xor_si128( mag, neg ), neg );
+}
+
+C2B_TARGET( "ssse3" )
+static inline __m128i codes_to_i8_ssse3( __m128i c ) {
+    return _mm_shuffle_epi8( _mm_loadu_si128( ( const __m128i* ) decode_lut_i8 ), c );
+}
+
+C2B_TARGET( "sse2" )
+static inline void store_i8_sse2( __m128i v, int8_t* d ) {
+    _mm_storeu_si128( ( __m128i* ) d, v );
+}
+
+C2B_TARGET( "sse2" )
+static inline void store_i16_sse2( __m128i v, int16_t* d ) {
+    _mm_storeu_si128( ( __m128i* ) ( d + 0 ), _mm_srai_epi16( _mm_unpacklo_epi8( v, v ), 8 ) );
+    _mm_storeu_si128( ( __m128i* ) ( d + 8 ), _mm_srai_epi16( _mm_unpackhi_epi8( v, v ), 8 ) );
+}
+
+C2B_TARGET( "sse2" )
+static inline void store_f32_sse2( __m128i v, float* d ) {
+    __m128i lo = _mm_srai_epi16( _mm_unpacklo_epi8( v, v ), 8 );
+    __m128i hi = _mm_srai_epi16( _mm_unpackhi_epi8( v, v ), 8 );
+    _mm_storeu_ps( d +  0, _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( lo, lo ), 16 ) ) );
+    _mm_storeu_ps( d +  4, _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( lo, lo ), 16 ) ) );
+    _mm_storeu_ps( d +  8, _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( hi, hi ), 16 ) ) );
+    _mm_storeu_ps( d + 12, _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( hi, hi ), 16 ) ) );
+}
+
+#define C2B_SSE_LOOP( to_i8, store, T )                                                    \
+    size_t i = 0;                                                                          \
+    for ( ; i + 16 <= pts_cnt; i += 16 ) {                                                 \
+        __m128i c[ CHAN2BIT_CHANS ];                                                       \
+        split_codes_sse2( _mm_loadu_si128( ( const __m128i* ) ( src + i ) ), c );          \
+        for ( int ch = 0; ch < CHAN2BIT_CHANS; ch++ ) {                                    \
+            if ( dst[ ch ] ) {                                                             \
+                store( to_i8( c[ ch ] ), dst[ ch ] + i );                                  \
+            }                                                                              \
+        }                                                                                  \
+    }                                                                                      \
+    decode_scalar< T >( src, pts_cnt, dst, i );
+
+C2B_TARGET( "sse2" )
+static void decode_int8_sse2( const uint8_t* src, size_t pts_cnt, int8_t* const dst[ CHAN2BIT_CHANS ] ) {
+    C2B_SSE_LOOP( codes_to_i8_sse2, store_i8_sse2, int8_t )
+}
+
+C2B_TARGET( "sse2" )
+static void decode_int16_sse2( const uint8_t* src, size_t pts_cnt, int16_t* const dst[ CHAN2BIT_CHANS ] ) {
+    C2B_SSE_LOOP( codes_to_i8_sse2, store_i16_sse2, int16_t )
+}
+
+C2B_TARGET( "sse2" )
+static void decode_float_sse2( const uint8_t* src, size_t pts_cnt, float* const dst[ CHAN2BIT_CHANS ] ) {
+    C2B_SSE_LOOP( codes_to_i8_sse2, store_f32_sse2, float )
+}
+
+C2B_TARGET( "ssse3" )
+static void decode_int8_ssse3( const uint8_t* src, size_t pts_cnt, int8_t* const dst[ CHAN2BIT_CHANS ] ) {
+    C2B_SSE_LOOP( codes_to_i8_ssse3, store_i8_sse2, int8_t )
+}
+
+C2B_TARGET( "ssse3" )
+static void decode_int16_ssse3( const uint8_t* src, size_t pts_cnt, int16_t* const dst[ CHAN2BIT_CHANS ] ) {
+    C2B_SSE_LOOP( codes_to_i8_ssse3, store_i16_sse2, int16_t )
+}
+
+C2B_TARGET( "ssse3" )
+static void decode_float_ssse3( const uint8_t* src, size_t pts_cnt, float* const dst[ CHAN2BIT_CHANS ] ) {
+    C2B_SSE_LOOP( codes_to_i8_ssse3, store_f32_sse2, float )
+}
+
+#undef C2B_SSE_LOOP
+
+
+/* --------------------------------------------------------------------------------------------- */
+/* AVX2: 32 samples per iteration */
+
+C2B_TARGET( "avx2" )
+static inline void decode_codes_avx2( __m256i x, __m256i v[ CHAN2BIT_CHANS ] ) {
+    const __m256i m3  = _mm256_set1_epi8( 0x03 );
+    const __m256i lut = _mm256_broadcastsi128_si256( _mm_loadu_si128( ( const __m128i* ) decode_lut_i8 ) );
+    v[ 0 ] = _mm256_shuffle_epi8( lut, _mm256_and_si256( x, m3 ) );
+    v[ 1 ] = _mm256_shuffle_epi8( lut, _mm256_and_si256( _mm256_srli_epi16( x, 2 ), m3 ) );
+    v[ 2 ] = _mm256_shuffle_epi8( lut, _mm256_and_si256( _mm256_srli_epi16( x, 4 ), m3 ) );
+    v[ 3 ] = _mm256_shuffle_epi8( lut, _mm256_and_si256( _mm256_srli_epi16( x, 6 ), m3 ) );
+}
+
+C2B_TARGET( "avx2" )
+static inline void store_i8_avx2( __m256i v, int8_t* d ) {
+    _mm256_storeu_si256( ( __m256i* ) d, v );
+}
+
+C2B_TARGET( "avx2" )
+static inline void store_i16_avx2( __m256i v, int16_t* d ) {
+    _mm256_storeu_si256( ( __m256i* ) ( d +  0 ), _mm256_cvtepi8_epi16( _mm256_castsi256_si128( v ) ) );
+    _mm256_storeu_si256( ( __m256i* ) ( d + 16 ), _mm256_cvtepi8_epi16( _mm256_extracti128_si256( v, 1 ) ) );
+}
+
+C2B_TARGET( "avx2" )
+static inline void store_f32_avx2( __m256i v, float* d ) {
+    __m128i lo = _mm256_castsi256_si128( v );
+    __m128i hi = _mm256_extracti128_si256( v, 1 );
+    _mm256_storeu_ps( d +  0, _mm256_cvtepi32_ps( _mm256_cvtepi8_epi32( lo ) ) );
+    _mm256_storeu_ps( d +  8, _mm256_cvtepi32_ps( _mm256_cvtepi8_epi32( _mm_srli_si128( lo, 8 ) ) ) );
+    _mm256_storeu_ps( d + 16, _mm256_cvtepi32_ps( _mm256_cvtepi8_epi32( hi ) ) );
+    _mm256_storeu_ps( d + 24, _mm256_cvtepi32_ps( _mm256_cvtepi8_epi32( _mm_srli_si128( hi, 8 ) ) ) );
+}
+
+#define C2B_AVX2_LOOP( store, T )                                                          \
+    size_t i = 0;                                                                          \
+    for ( ; i + 32 <= pts_cnt; i += 32 ) {                                                 \
+        __m256i v[ CHAN2BIT_CHANS ];                                                       \
+        decode_codes_avx2( _mm256_loadu_si256( ( const __m256i* ) ( src + i ) ), v );      \
+        for ( int ch = 0; ch < CHAN2BIT_CHANS; ch++ ) {                                    \
+            if ( dst[ ch ] ) {                                                             \
+                store( v[ ch ], dst[ ch ] + i );                                           \
+            }                                                                              \
+        }                                                                                  \
+    }                                                                                      \
+    decode_scalar< T >( src, pts_cnt, dst, i );
+
+C2B_TARGET( "avx2" )
+static void decode_int8_avx2( const uint8_t* src, size_t pts_cnt, int8_t* const dst[ CHAN2BIT_CHANS ] ) {
+    C2B_AVX2_LOOP( store_i8_avx2, int8_t )
+}
+
+C2B_TARGET( "avx2" )
+static void decode_int16_avx2( const uint8_t* src, size_t pts_cnt, int16_t* const dst[ CHAN2BIT_CHANS ] ) {
+    C2B_AVX2_LOOP( store_i16_avx2, int16_t )
+}
+
+C2B_TARGET( "avx2" )
+static void decode_float_avx2( const uint8_t* src, size_t pts_cnt, float* const dst[ CHAN2BIT_CHANS ] ) {
+    C2B_AVX2_LOOP( store_f32_avx2, float )
+}
+
+#undef C2B_AVX2_LOOP
+
+#endif // C2B_X86
+
+
+/* --------------------------------------------------------------------------------------------- */
+/* Runtime dispatch */
+
+Chan2bitIsa_t chan2bit_detect_isa() {
+#if defined( C2B_X86 ) && defined( __GNUC__ )
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports( "avx2" ) ) {
+        return C2B_ISA_AVX2;
+    }
+    if ( __builtin_cpu_supports( "ssse3" ) ) {
+        return C2B_ISA_SSSE3;
+    }
+    if ( __builtin_cpu_supports( "sse2" ) ) {
+        return C2B_ISA_SSE2;
+    }
+    return C2B_ISA_SCALAR;
+#elif defined( C2B_X86 ) && defined( _MSC_VER )
+    int info[ 4 ];
+    __cpuid( info, 0 );
+    int max_leaf = info[ 0 ];
+    __cpuid( info, 1 );
+    bool sse2    = ( info[ 3 ] & ( 1 << 26 ) ) != 0;
+    bool ssse3   = ( info[ 2 ] & ( 1 <<  9 ) ) != 0;
+    bool osxsave = ( info[ 2 ] & ( 1 << 27 ) ) != 0;
+    bool avx     = ( info[ 2 ] & ( 1 << 28 ) ) != 0;
+    bool avx2    = false;
+    if ( max_leaf >= 7 && osxsave && avx && ( _xgetbv( 0 ) & 0x06 ) == 0x06 ) {
+        __cpuidex( info, 7, 0 );
+        avx2 = ( info[ 1 ] & ( 1 << 5 ) ) != 0;
+    }
+    if ( avx2 ) {
+        return C2B_ISA_AVX2;
+    }
+    if ( ssse3 ) {
+        return C2B_ISA_SSSE3;
+    }
+    if ( sse2 ) {
+        return C2B_ISA_SSE2;
+    }
+    return C2B_ISA_SCALAR;
+#else
+    return C2B_ISA_SCALAR;
+#endif
+}
+
+static std::atomic<int> current_isa( -1 );
+
+Chan2bitIsa_t chan2bit_isa() {
+    int isa = current_isa.load( std::memory_order_relaxed );
+    if ( isa < 0 ) {
+        isa = ( int ) chan2bit_detect_isa();
+        current_isa.store( isa, std::memory_order_relaxed );
+    }
+    return ( Chan2bitIsa_t ) isa;
+}
+
+Chan2bitIsa_t chan2bit_set_isa( Chan2bitIsa_t isa ) {
+    Chan2bitIsa_t best = chan2bit_detect_isa();
+    if ( isa > best ) {
+        isa = best;
+    }
+    current_isa.store( ( int ) isa, std::memory_order_relaxed );
+    return isa;
+}
+
+const char* chan2bit_isa_name( Chan2bitIsa_t isa ) {
+    switch ( isa ) {
+        case C2B_ISA_AVX2:  return "avx2";
+        case C2B_ISA_SSSE3: return "ssse3";
+        case C2B_ISA_SSE2:  return "sse2";
+        default:            return "scalar";
+    }
+}
+
+void decode_2bit_4ch_int8( const uint8_t* src, size_t pts_cnt, int8_t* const dst[ CHAN2BIT_CHANS ] ) {
+    switch ( chan2bit_isa() ) {
+#ifdef C2B_X86
+        case C2B_ISA_AVX2:  decode_int8_avx2 ( src, pts_cnt, dst ); break;
+        case C2B_ISA_SSSE3: decode_int8_ssse3( src, pts_cnt, dst ); break;
+        case C2B_ISA_SSE2:  decode_int8_sse2 ( src, pts_cnt, dst ); break;
+#endif
+        default:            decode_scalar< int8_t >( src, pts_cnt, dst, 0 ); break;
+    }
+}
+
+void decode_2bit_4ch_int16( const uint8_t* src, size_t pts_cnt, int16_t* const dst[ CHAN2BIT_CHANS ] ) {
+    switch ( chan2bit_isa() ) {
+#ifdef C2B_X86
+        case C2B_ISA_AVX2:  decode_int16_avx2 ( src, pts_cnt, dst ); break;
+        case C2B_ISA_SSSE3: decode_int16_ssse3( src, pts_cnt, dst ); break;
+        case C2B_ISA_SSE2:  decode_int16_sse2 ( src, pts_cnt, dst ); break;
+#endif
+        default:            decode_scalar< int16_t >( src, pts_cnt, dst, 0 ); break;
+    }
+}
+
+void decode_2bit_4ch_float( const uint8_t* src, size_t pts_cnt, float* const dst[ CHAN2BIT_CHANS ] ) {
+    switch ( chan2bit_isa() ) {
+#ifdef C2B_X86
+        case C2B_ISA_AVX2:  decode_float_avx2 ( src, pts_cnt, dst ); break;
+        case C2B_ISA_SSSE3: decode_float_ssse3( src, pts_cnt, dst ); break;
+        case C2B_ISA_SSE2:  decode_float_sse2 ( src, pts_cnt, dst ); break;
+#endif
+        default:            decode_scalar< float >( src, pts_cnt, dst, 0 ); break;
+    }
+}
@@ -1,6 +1,9 @@
 #ifndef _chan2bit_parser_h_
 #define _chan2bit_parser_h_
 
+#include <cstddef>
+#include <cstdint>
+
 #define CODE_MASK_CH0 ( 0x03 )
 #define CODE_MASK_CH1 ( 0x0C )
 #define CODE_MASK_CH2 ( 0x30 )
@@ -11,6 +14,33 @@
 #define CODE_SHIFT_CH2 ( 4 )
 #define CODE_SHIFT_CH3 ( 6 )
 
+#define CHAN2BIT_CHANS ( 4 )
+
+/*
+ * Block decoders: every byte of src holds one sample of all four channels,
+ * pts_cnt bytes are converted into four planes of pts_cnt samples each in one pass.
+ * dst[ ch ] may be NULL, then this channel is not stored.
+ * Implementation (AVX2, SSSE3, SSE2 or scalar) is selected at first call by CPU features.
+ */
+enum Chan2bitIsa_t {
+    C2B_ISA_SCALAR = 0,
+    C2B_ISA_SSE2,
+    C2B_ISA_SSSE3,
+    C2B_ISA_AVX2
+};
+
+void decode_2bit_4ch_int8 ( const uint8_t* src, size_t pts_cnt, int8_t*  const dst[ CHAN2BIT_CHANS ] );
+void decode_2bit_4ch_int16( const uint8_t* src, size_t pts_cnt, int16_t* const dst[ CHAN2BIT_CHANS ] );
+void decode_2bit_4ch_float( const uint8_t* src, size_t pts_cnt, float*   const dst[ CHAN2BIT_CHANS ] );
+
+// Best instruction set supported by this CPU
+Chan2bitIsa_t chan2bit_detect_isa();
+// Currently used instruction set
+Chan2bitIsa_t chan2bit_isa();
+// Forces lower instruction set (for benchmarks), value is limited by chan2bit_detect_isa()
+Chan2bitIsa_t chan2bit_set_isa( Chan2bitIsa_t isa );
+const char* chan2bit_isa_name( Chan2bitIsa_t isa );
+
 
 inline void decode4bytes_to_4shorts_ch0( unsigned int code4, short* dst ) {
     static short decode_samples_i16[4] = {1, 3, -1, -3};
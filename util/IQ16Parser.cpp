@@ -0,0 +1,34 @@
+#include "IQ16Parser.h"
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define IQ16_SSE2
+#include <emmintrin.h>
+#endif
+
+// One I/Q pair is one 32-bit word, so channels are even and odd words of the source
+void deinterleave_iq16_2ch( const int16_t* src, size_t pts_cnt, int16_t* dst0, int16_t* dst1 ) {
+    size_t i = 0;
+#ifdef IQ16_SSE2
+    for ( ; i + 8 <= pts_cnt; i += 8 ) {
+        // a0 b0 a1 b1 | a2 b2 a3 b3  ->  a0 a1 b0 b1 | a2 a3 b2 b3
+        __m128i x = _mm_shuffle_epi32( _mm_loadu_si128( ( const __m128i* ) ( src + 2 * i + 0 ) ), _MM_SHUFFLE( 3, 1, 2, 0 ) );
+        __m128i y = _mm_shuffle_epi32( _mm_loadu_si128( ( const __m128i* ) ( src + 2 * i + 8 ) ), _MM_SHUFFLE( 3, 1, 2, 0 ) );
+        if ( dst0 ) {
+            _mm_storeu_si128( ( __m128i* ) ( dst0 + i ), _mm_unpacklo_epi64( x, y ) );
+        }
+        if ( dst1 ) {
+            _mm_storeu_si128( ( __m128i* ) ( dst1 + i ), _mm_unpackhi_epi64( x, y ) );
+        }
+    }
+#endif
+    for ( ; i + 2 <= pts_cnt; i += 2 ) {
+        if ( dst0 ) {
+            dst0[ i + 0 ] = src[ 2 * i + 0 ]; // I
+            dst0[ i + 1 ] = src[ 2 * i + 1 ]; // Q
+        }
+        if ( dst1 ) {
+            dst1[ i + 0 ] = src[ 2 * i + 2 ]; // I
+            dst1[ i + 1 ] = src[ 2 * i + 3 ]; // Q
+        }
+    }
+}
@@ -0,0 +1,15 @@
+#ifndef _iq16_parser_h_
+#define _iq16_parser_h_
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Two channels of 16-bit I/Q samples interleaved by pairs:
+ *   ch0 I, ch0 Q, ch1 I, ch1 Q, ch0 I, ch0 Q, ...
+ * pts_cnt is number of int16 values for one channel (I and Q are counted separately, must be even).
+ * dst0 or dst1 may be NULL, then this channel is not stored.
+ */
+void deinterleave_iq16_2ch( const int16_t* src, size_t pts_cnt, int16_t* dst0, int16_t* dst1 );
+
+#endif
@@ -0,0 +1,122 @@
+#include "SamplePack.h"
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define SAMPLE_PACK_SSE2
+#include <emmintrin.h>
+#endif
+
+void narrow_int16_to_int8( const int16_t* src, size_t pts_cnt, int8_t* dst ) {
+    size_t i = 0;
+#ifdef SAMPLE_PACK_SSE2
+    // mask before unsigned pack, so values are truncated like the cast and not saturated
+    const __m128i low = _mm_set1_epi16( 0x00FF );
+    for ( ; i + 16 <= pts_cnt; i += 16 ) {
+        __m128i a = _mm_and_si128( _mm_loadu_si128( ( const __m128i* ) ( src + i + 0 ) ), low );
+        __m128i b = _mm_and_si128( _mm_loadu_si128( ( const __m128i* ) ( src + i + 8 ) ), low );
+        _mm_storeu_si128( ( __m128i* ) ( dst + i ), _mm_packus_epi16( a, b ) );
+    }
+#endif
+    for ( ; i < pts_cnt; i++ ) {
+        dst[ i ] = ( int8_t ) src[ i ];
+    }
+}
+
+void interleave_int8( const int8_t* const src[], uint32_t chans, size_t pts_cnt, int8_t* dst ) {
+    size_t i = 0;
+#ifdef SAMPLE_PACK_SSE2
+    if ( chans == 2 ) {
+        for ( ; i + 16 <= pts_cnt; i += 16 ) {
+            __m128i a = _mm_loadu_si128( ( const __m128i* ) ( src[ 0 ] + i ) );
+            __m128i b = _mm_loadu_si128( ( const __m128i* ) ( src[ 1 ] + i ) );
+            _mm_storeu_si128( ( __m128i* ) ( dst + 2 * i +  0 ), _mm_unpacklo_epi8( a, b ) );
+            _mm_storeu_si128( ( __m128i* ) ( dst + 2 * i + 16 ), _mm_unpackhi_epi8( a, b ) );
+        }
+    } else if ( chans == 4 ) {
+        for ( ; i + 16 <= pts_cnt; i += 16 ) {
+            __m128i a = _mm_loadu_si128( ( const __m128i* ) ( src[ 0 ] + i ) );
+            __m128i b = _mm_loadu_si128( ( const __m128i* ) ( src[ 1 ] + i ) );
+            __m128i c = _mm_loadu_si128( ( const __m128i* ) ( src[ 2 ] + i ) );
+            __m128i d = _mm_loadu_si128( ( const __m128i* ) ( src[ 3 ] + i ) );
+            __m128i ab_lo = _mm_unpacklo_epi8( a, b );
+            __m128i ab_hi = _mm_unpackhi_epi8( a, b );
+            __m128i cd_lo = _mm_unpacklo_epi8( c, d );
+            __m128i cd_hi = _mm_unpackhi_epi8( c, d );
+            _mm_storeu_si128( ( __m128i* ) ( dst + 4 * i +  0 ), _mm_unpacklo_epi16( ab_lo, cd_lo ) );
+            _mm_storeu_si128( ( __m128i* ) ( dst + 4 * i + 16 ), _mm_unpackhi_epi16( ab_lo, cd_lo ) );
+            _mm_storeu_si128( ( __m128i* ) ( dst + 4 * i + 32 ), _mm_unpacklo_epi16( ab_hi, cd_hi ) );
+            _mm_storeu_si128( ( __m128i* ) ( dst + 4 * i + 48 ), _mm_unpackhi_epi16( ab_hi, cd_hi ) );
+        }
+    }
+#endif
+    for ( ; i < pts_cnt; i++ ) {
+        for ( uint32_t ch = 0; ch < chans; ch++ ) {
+            dst[ chans * i + ch ] = src[ ch ][ i ];
+        }
+    }
+}
+
+// 2-bit codes 0, 1, 2, 3 are 1, 3, -1, -3: high bit of code is sign, low bit is magnitude
+void pack_leap_2bit( const uint8_t* src, size_t pts_cnt, int channel, uint8_t* dst ) {
+    int sign_bit = 2 * channel + 1;
+    int mag_bit  = 2 * channel;
+    size_t i = 0;
+#ifdef SAMPLE_PACK_SSE2
+    // bit of every byte is moved to bit 7, movemask gathers 16 samples
+    const __m128i sign_shift = _mm_cvtsi32_si128( 7 - sign_bit );
+    const __m128i mag_shift  = _mm_cvtsi32_si128( 7 - mag_bit );
+    for ( ; i + 16 <= pts_cnt; i += 16 ) {
+        __m128i v = _mm_loadu_si128( ( const __m128i* ) ( src + i ) );
+        int sign = _mm_movemask_epi8( _mm_sll_epi16( v, sign_shift ) );
+        int mag  = _mm_movemask_epi8( _mm_sll_epi16( v, mag_shift ) );
+        dst[ 0 ] = ( uint8_t ) sign;
+        dst[ 1 ] = ( uint8_t ) mag;
+        dst[ 2 ] = ( uint8_t ) ( sign >> 8 );
+        dst[ 3 ] = ( uint8_t ) ( mag >> 8 );
+        dst += 4;
+    }
+#endif
+    for ( ; i + 8 <= pts_cnt; i += 8 ) {
+        uint8_t sign = 0;
+        uint8_t mag  = 0;
+        for ( int k = 0; k < 8; k++ ) {
+            sign |= ( ( src[ i + k ] >> sign_bit ) & 1 ) << k;
+            mag  |= ( ( src[ i + k ] >> mag_bit  ) & 1 ) << k;
+        }
+        dst[ 0 ] = sign;
+        dst[ 1 ] = mag;
+        dst += 2;
+    }
+}
+
+void pack_leap_int16( const int16_t* src, size_t pts_cnt, uint8_t* dst ) {
+    size_t i = 0;
+#ifdef SAMPLE_PACK_SSE2
+    // saturating pack keeps sign and does not make +-3 from other values
+    const __m128i plus3  = _mm_set1_epi8( 3 );
+    const __m128i minus3 = _mm_set1_epi8( -3 );
+    for ( ; i + 16 <= pts_cnt; i += 16 ) {
+        __m128i a = _mm_loadu_si128( ( const __m128i* ) ( src + i + 0 ) );
+        __m128i b = _mm_loadu_si128( ( const __m128i* ) ( src + i + 8 ) );
+        __m128i v = _mm_packs_epi16( a, b );
+        int sign = _mm_movemask_epi8( v );
+        int mag  = _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8( v, plus3 ), _mm_cmpeq_epi8( v, minus3 ) ) );
+        dst[ 0 ] = ( uint8_t ) sign;
+        dst[ 1 ] = ( uint8_t ) mag;
+        dst[ 2 ] = ( uint8_t ) ( sign >> 8 );
+        dst[ 3 ] = ( uint8_t ) ( mag >> 8 );
+        dst += 4;
+    }
+#endif
+    for ( ; i + 8 <= pts_cnt; i += 8 ) {
+        uint8_t sign = 0;
+        uint8_t mag  = 0;
+        for ( int k = 0; k < 8; k++ ) {
+            int16_t v = src[ i + k ];
+            sign |= ( v < 0 ) << k;
+            mag  |= ( v == 3 || v == -3 ) << k;
+        }
+        dst[ 0 ] = sign;
+        dst[ 1 ] = mag;
+        dst += 2;
+    }
+}
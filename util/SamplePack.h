@@ -0,0 +1,23 @@
+#ifndef _sample_pack_h_
+#define _sample_pack_h_
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * int8 sample helpers for recorders.
+ * narrow_int16_to_int8: keeps low byte of every sample, same as ( int8_t ) cast.
+ * interleave_int8: chans planes of pts_cnt samples to one stream ch0, ch1, ..., ch0, ch1, ...
+ */
+void narrow_int16_to_int8( const int16_t* src, size_t pts_cnt, int8_t* dst );
+void interleave_int8( const int8_t* const src[], uint32_t chans, size_t pts_cnt, int8_t* dst );
+
+/*
+ * LEAP bit planes: every 8 samples give 2 bytes, sign byte and magnitude byte, bit i is sample i.
+ * Sign is set for negative sample, magnitude for +-3. pts_cnt is a multiple of 8.
+ * pack_leap_2bit takes one channel of 2-bit 4-channel stream (Chan2bitParser.h codes) directly.
+ */
+void pack_leap_2bit( const uint8_t* src, size_t pts_cnt, int channel, uint8_t* dst );
+void pack_leap_int16( const int16_t* src, size_t pts_cnt, uint8_t* dst );
+
+#endif
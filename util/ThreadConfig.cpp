@@ -0,0 +1,176 @@
+#include "ThreadConfig.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static const char* thread_names[ PipeThread_Count ] = {
+    "usb",
+    "router",
+    "worker",
+    "filesim",
+    "spectrum",
+    "phase",
+    "gpscorr",
+    "writer"
+};
+
+static std::mutex params_mtx;
+static PipeThreadParams thread_params[ PipeThread_Count ];
+
+const char* pipe_thread_name( PipeThread_t role ) {
+    if ( role < 0 || role >= PipeThread_Count ) {
+        return "unknown";
+    }
+    return thread_names[ role ];
+}
+
+PipeThreadParams pipe_thread_params( PipeThread_t role ) {
+    std::lock_guard< std::mutex > lck( params_mtx );
+    return thread_params[ role ];
+}
+
+void pipe_thread_set_params( PipeThread_t role, const PipeThreadParams& params ) {
+    std::lock_guard< std::mutex > lck( params_mtx );
+    thread_params[ role ] = params;
+}
+
+// "2-5,8" -> 2 3 4 5 8
+static bool parse_cpus( const char* str, std::vector< int >& cpus ) {
+    cpus.clear();
+    while ( *str ) {
+        char* end;
+        long first = strtol( str, &end, 10 );
+        if ( end == str || first < 0 ) {
+            return false;
+        }
+        long last = first;
+        str = end;
+        if ( *str == '-' ) {
+            str++;
+            last = strtol( str, &end, 10 );
+            if ( end == str || last < first ) {
+                return false;
+            }
+            str = end;
+        }
+        for ( long c = first; c <= last; c++ ) {
+            cpus.push_back( ( int ) c );
+        }
+        if ( *str == ',' ) {
+            str++;
+        } else if ( *str ) {
+            return false;
+        }
+    }
+    return !cpus.empty();
+}
+
+bool pipe_thread_load_config( const char* fname ) {
+    FILE* f = fopen( fname, "r" );
+    if ( !f ) {
+        return false;
+    }
+    char line[ 256 ];
+    int line_num = 0;
+    while ( fgets( line, sizeof( line ), f ) ) {
+        line_num++;
+        char* comment = strchr( line, '#' );
+        if ( comment ) {
+            *comment = '\0';
+        }
+        char* tok = strtok( line, " \t\r\n" );
+        if ( !tok ) {
+            continue;
+        }
+        int role = 0;
+        while ( role < PipeThread_Count && strcmp( tok, thread_names[ role ] ) != 0 ) {
+            role++;
+        }
+        if ( role == PipeThread_Count ) {
+            fprintf( stderr, "__warning__ %s:%d unknown thread '%s'\n", fname, line_num, tok );
+            continue;
+        }
+        PipeThreadParams params;
+        bool ok = true;
+        while ( ok && ( tok = strtok( NULL, " \t\r\n" ) ) ) {
+            if ( strncmp( tok, "cpus=", 5 ) == 0 ) {
+                ok = parse_cpus( tok + 5, params.cpus );
+            } else if ( strncmp( tok, "fifo=", 5 ) == 0 ) {
+                params.fifo_priority = atoi( tok + 5 );
+                ok = ( params.fifo_priority >= 0 && params.fifo_priority <= 99 );
+            } else {
+                ok = false;
+            }
+        }
+        if ( !ok ) {
+            fprintf( stderr, "__warning__ %s:%d bad value '%s'\n", fname, line_num, tok );
+            continue;
+        }
+        pipe_thread_set_params( ( PipeThread_t ) role, params );
+        fprintf( stderr, "ThreadConfig: %s cpus %u fifo %d\n", thread_names[ role ],
+                 ( unsigned ) params.cpus.size(), params.fifo_priority );
+    }
+    fclose( f );
+    return true;
+}
+
+void pipe_thread_setup( PipeThread_t role ) {
+    if ( role < 0 || role >= PipeThread_Count ) {
+        return;
+    }
+    PipeThreadParams params = pipe_thread_params( role );
+    const char* name = thread_names[ role ];
+
+#ifdef WIN32
+    if ( !params.cpus.empty() ) {
+        DWORD_PTR mask = 0;
+        for ( size_t i = 0; i < params.cpus.size(); i++ ) {
+            if ( params.cpus[ i ] < ( int ) ( 8 * sizeof( DWORD_PTR ) ) ) {
+                mask |= ( ( DWORD_PTR ) 1 ) << params.cpus[ i ];
+            }
+        }
+        if ( !SetThreadAffinityMask( GetCurrentThread(), mask ) ) {
+            fprintf( stderr, "__warning__ pipe_thread_setup(%s) SetThreadAffinityMask failed %lu\n", name, GetLastError() );
+        }
+    }
+    if ( params.fifo_priority > 0 ) {
+        if ( !SetThreadPriority( GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL ) ) {
+            fprintf( stderr, "__warning__ pipe_thread_setup(%s) SetThreadPriority failed %lu\n", name, GetLastError() );
+        }
+    }
+#else
+#ifdef __linux__
+    pthread_setname_np( pthread_self(), name );
+    if ( !params.cpus.empty() ) {
+        cpu_set_t set;
+        CPU_ZERO( &set );
+        for ( size_t i = 0; i < params.cpus.size(); i++ ) {
+            if ( params.cpus[ i ] < CPU_SETSIZE ) {
+                CPU_SET( params.cpus[ i ], &set );
+            }
+        }
+        int res = pthread_setaffinity_np( pthread_self(), sizeof( set ), &set );
+        if ( res != 0 ) {
+            fprintf( stderr, "__warning__ pipe_thread_setup(%s) pthread_setaffinity_np failed: %s\n", name, strerror( res ) );
+        }
+    }
+#endif
+    if ( params.fifo_priority > 0 ) {
+        sched_param sp;
+        memset( &sp, 0, sizeof( sp ) );
+        sp.sched_priority = params.fifo_priority;
+        int res = pthread_setschedparam( pthread_self(), SCHED_FIFO, &sp );
+        if ( res != 0 ) {
+            fprintf( stderr, "__warning__ pipe_thread_setup(%s) SCHED_FIFO %d failed: %s\n", name, params.fifo_priority, strerror( res ) );
+        }
+    }
+#endif
+}
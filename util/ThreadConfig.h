@@ -0,0 +1,51 @@
+#ifndef _thread_config_h_
+#define _thread_config_h_
+
+#include <vector>
+
+#define THREADS_CFG_FILE_NAME "fx3_threads.cfg"
+
+/*
+ * Placement of pipeline threads: CPU affinity, SCHED_FIFO priority and thread name.
+ * Every pipeline thread calls pipe_thread_setup() with its role when it starts,
+ * settings are taken from the table filled by pipe_thread_load_config() or pipe_thread_set_params().
+ *
+ * Config file, one thread per line, '#' starts comment:
+ *   usb      cpus=2      fifo=60
+ *   router   cpus=3
+ *   spectrum cpus=4-7,10
+ * fifo=0 (default) keeps normal scheduling. SCHED_FIFO needs CAP_SYS_NICE or rtprio limit,
+ * on Windows fifo means THREAD_PRIORITY_TIME_CRITICAL.
+ */
+enum PipeThread_t {
+    PipeThread_Usb = 0,     // FX3Dev::event_loop, FX3DevCyAPI::xfer_loop
+    PipeThread_Router,      // StreamRouter::DataHandleLoop
+    PipeThread_Worker,      // StreamWorker::WorkLoop, all handlers
+    PipeThread_FileSim,     // FileSimDev::run
+    PipeThread_Spectrum,    // SpectrumForm::calc_loop
+    PipeThread_Phase,       // PhaseForm::Tick
+    PipeThread_GPSCorr,     // GPSCorrForm::calcLoop
+    PipeThread_Writer,      // AsyncFileWriter::WriteLoop, disk writers of recorders
+    PipeThread_Count
+};
+
+struct PipeThreadParams {
+    std::vector< int > cpus;    // empty - any CPU
+    int fifo_priority;          // 0 - normal scheduling, 1..99 - SCHED_FIFO
+
+    PipeThreadParams() : fifo_priority( 0 ) {}
+};
+
+// Name used in config file and given to thread (visible in top -H, perf, gdb)
+const char* pipe_thread_name( PipeThread_t role );
+
+PipeThreadParams pipe_thread_params( PipeThread_t role );
+void pipe_thread_set_params( PipeThread_t role, const PipeThreadParams& params );
+
+// Returns false if file can't be opened, bad lines are reported and skipped
+bool pipe_thread_load_config( const char* fname = THREADS_CFG_FILE_NAME );
+
+// Applies settings of role to calling thread
+void pipe_thread_setup( PipeThread_t role );
+
+#endif